@@ -0,0 +1,300 @@
+#include <string.h>
+
+#include "acquisition.h"
+
+typedef struct
+{
+    TimerWheelTimer timer;
+    uint8_t index;
+    int32_t fd;
+    uint32_t period_us;
+    size_t length;
+    uint8_t frame[ACQUISITION_MAX_FRAME_BYTES];
+} PlanEntry;
+
+typedef struct
+{
+    AcquisitionRecord_t record;
+    uint8_t data[ACQUISITION_MAX_DATA];
+} RingSlot;
+
+static PlanEntry entries[ACQUISITION_MAX_ENTRIES];
+// A new plan is parsed here so a rejected install leaves the running plan untouched.
+static PlanEntry staged[ACQUISITION_MAX_ENTRIES];
+static AcquisitionStats_t stats;
+
+// Results are stored by sequence number, so slot seq % ACQUISITION_RING_RECORDS holds
+// record seq for as long as it has not been overwritten.
+static RingSlot ring[ACQUISITION_RING_RECORDS];
+static uint32_t next_seq = 1;
+
+// Frames are copied here to run because handlers write their response past the end of
+// the request, up to response_length.
+static uint8_t scratch[1024 * 5];
+
+static void store_result(uint8_t entry, uint64_t timestamp, const CTX_HEADER *header, const void *data, size_t length)
+{
+    RingSlot *slot = &ring[next_seq % ACQUISITION_RING_RECORDS];
+
+    slot->record.seq = next_seq;
+    slot->record.timestampNs = timestamp;
+    slot->record.entry = entry;
+    slot->record.returns = header->returns;
+    slot->record.err_no = header->err_no;
+    slot->record.length = (uint8_t)length;
+    memcpy(slot->data, data, length);
+
+    stats.newestSeq = next_seq++;
+    stats.oldestSeq = stats.newestSeq >= ACQUISITION_RING_RECORDS ? stats.newestSeq - ACQUISITION_RING_RECORDS + 1 : 1;
+}
+
+/// <summary>
+/// Run the entry's frame through the same handler a client request would use and keep
+/// what it read.
+/// </summary>
+static void HandleEntryDue(TimerWheelTimer *timer, void *context)
+{
+    PlanEntry *entry = (PlanEntry *)context;
+    CTX_HEADER *header = (CTX_HEADER *)scratch;
+    uint64_t timestamp = TimerWheel_NowNs();
+    const void *data = NULL;
+    size_t length = 0;
+
+    stats.overruns += timer->overruns;
+    timer->overruns = 0;
+
+    memcpy(scratch, entry->frame, entry->length);
+    errno = 0;
+
+    switch (header->cmd)
+    {
+    case I2CMaster_WriteThenRead_c:
+    {
+        I2CMaster_WriteThenRead_t *request = (I2CMaster_WriteThenRead_t *)scratch;
+        I2CMaster_WriteThenRead_cmd(scratch, (ssize_t)entry->length);
+        data = request->data_block.data;
+        length = request->lenReadData;
+        break;
+    }
+
+    case SPIMaster_WriteThenRead_c:
+    {
+        SPIMaster_WriteThenRead_t *request = (SPIMaster_WriteThenRead_t *)scratch;
+        SPIMaster_WriteThenRead_cmd(scratch, (ssize_t)entry->length);
+        data = request->data_block.data;
+        length = request->lenReadData;
+        break;
+    }
+
+    default:
+    {
+        ADC_Poll_t *request = (ADC_Poll_t *)scratch;
+        ADC_Poll_cmd(scratch, (ssize_t)entry->length);
+        data = &request->outSampleValue;
+        length = sizeof(request->outSampleValue);
+        break;
+    }
+    }
+
+    stats.samples++;
+    if (header->returns == -1)
+    {
+        stats.errors++;
+        length = 0;
+    }
+
+    store_result(entry->index, timestamp, header, data, length);
+}
+
+static int32_t frame_fd(const CTX_HEADER *header)
+{
+    switch (header->cmd)
+    {
+    case I2CMaster_WriteThenRead_c:
+        return ((const I2CMaster_WriteThenRead_t *)header)->fd;
+    case SPIMaster_WriteThenRead_c:
+        return ((const SPIMaster_WriteThenRead_t *)header)->fd;
+    default:
+        return ((const ADC_Poll_t *)header)->fd;
+    }
+}
+
+static bool validate_frame(const CTX_HEADER *header, size_t length)
+{
+    if (length < sizeof(CTX_HEADER) || header->block_length != length || length > ACQUISITION_MAX_FRAME_BYTES)
+    {
+        return false;
+    }
+
+    switch (header->cmd)
+    {
+    case I2CMaster_WriteThenRead_c:
+    {
+        const I2CMaster_WriteThenRead_t *request = (const I2CMaster_WriteThenRead_t *)header;
+        return request->lenWriteData <= ACQUISITION_MAX_FRAME_BYTES &&
+               length >= (size_t)VARIABLE_BLOCK_SIZE(I2CMaster_WriteThenRead, request->lenWriteData) &&
+               request->lenReadData <= ACQUISITION_MAX_DATA;
+    }
+
+    case SPIMaster_WriteThenRead_c:
+    {
+        const SPIMaster_WriteThenRead_t *request = (const SPIMaster_WriteThenRead_t *)header;
+        return request->lenWriteData <= ACQUISITION_MAX_FRAME_BYTES &&
+               length >= (size_t)VARIABLE_BLOCK_SIZE(SPIMaster_WriteThenRead, request->lenWriteData) &&
+               request->lenReadData <= ACQUISITION_MAX_DATA;
+    }
+
+    case ADC_Poll_c:
+        return length >= sizeof(ADC_Poll_t);
+
+    default:
+        return false;
+    }
+}
+
+static bool parse_plan(const uint8_t *plan, size_t length, uint8_t count)
+{
+    size_t offset = 0;
+
+    if (count == 0 || count > ACQUISITION_MAX_ENTRIES)
+    {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        const AcquisitionEntry_t *entry = (const AcquisitionEntry_t *)(plan + offset);
+        const CTX_HEADER *header = (const CTX_HEADER *)(entry + 1);
+
+        if (length - offset < sizeof(AcquisitionEntry_t) + sizeof(CTX_HEADER) ||
+            header->block_length > length - offset - sizeof(AcquisitionEntry_t) ||
+            entry->periodUs < ACQUISITION_MIN_PERIOD_US ||
+            !validate_frame(header, header->block_length) ||
+            !ledger_contains(frame_fd(header)))
+        {
+            return false;
+        }
+
+        staged[i].index = i;
+        staged[i].fd = frame_fd(header);
+        staged[i].length = header->block_length;
+        staged[i].period_us = entry->periodUs;
+        memcpy(staged[i].frame, header, header->block_length);
+
+        offset += sizeof(AcquisitionEntry_t) + header->block_length;
+    }
+
+    return offset == length;
+}
+
+void Acquisition_Stop(void)
+{
+    for (uint8_t i = 0; i < stats.entryCount; i++)
+    {
+        TimerWheel_Cancel(&entries[i].timer);
+        ledger_pin(entries[i].fd, false);
+    }
+
+    stats.running = false;
+    stats.entryCount = 0;
+}
+
+static int install_plan(const RemoteX_Acquisition_t *data, ssize_t nread)
+{
+    if (VARIABLE_BLOCK_SIZE(RemoteX_Acquisition, data->length) > nread ||
+        !parse_plan(data->data_block.data, data->length, data->entryCount))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    Acquisition_Stop();
+    stats.entryCount = data->entryCount;
+
+    for (uint8_t i = 0; i < stats.entryCount; i++)
+    {
+        entries[i] = staged[i];
+        TimerWheel_InitTimer(&entries[i].timer, HandleEntryDue, &entries[i]);
+        ledger_pin(entries[i].fd, true);
+
+        if (TimerWheel_StartPeriodic(TimerWheel_Default(), &entries[i].timer, entries[i].period_us) == -1)
+        {
+            Acquisition_Stop();
+            return -1;
+        }
+    }
+
+    stats.running = true;
+    return 0;
+}
+
+DEFINE_CMD(RemoteX_Acquisition, data, nread)
+{
+    switch (data->op)
+    {
+    case AcquisitionOp_Install:
+        data->header.returns = install_plan(data, nread);
+        break;
+
+    case AcquisitionOp_Stop:
+        Acquisition_Stop();
+        data->header.returns = 0;
+        break;
+
+    case AcquisitionOp_Status:
+        data->header.returns = 0;
+        break;
+
+    default:
+        data->header.returns = -1;
+        errno = EINVAL;
+        break;
+    }
+
+    data->stats = stats;
+}
+END_CMD
+
+DEFINE_CMD(RemoteX_AcquisitionFetch, data, nread)
+{
+    uint32_t seq = data->sinceSeq + 1;
+    size_t space = sizeof(data->data_block.data);
+
+    data->recordCount = 0;
+    data->lostRecords = 0;
+    data->length = 0;
+    data->lastSeq = data->sinceSeq;
+
+    if (stats.oldestSeq != 0 && seq < stats.oldestSeq)
+    {
+        data->lostRecords = stats.oldestSeq - seq;
+        seq = stats.oldestSeq;
+    }
+
+    if (data->header.response_length < sizeof(RemoteX_AcquisitionFetch_t))
+    {
+        space = data->header.response_length > VARIABLE_BLOCK_SIZE(RemoteX_AcquisitionFetch, 0)
+                    ? data->header.response_length - VARIABLE_BLOCK_SIZE(RemoteX_AcquisitionFetch, 0)
+                    : 0;
+    }
+
+    for (; stats.newestSeq != 0 && seq <= stats.newestSeq; seq++)
+    {
+        const RingSlot *slot = &ring[seq % ACQUISITION_RING_RECORDS];
+        size_t record_length = sizeof(AcquisitionRecord_t) + slot->record.length;
+
+        if (data->length + record_length > space)
+        {
+            break;
+        }
+
+        memcpy(data->data_block.data + data->length, slot, record_length);
+        data->length += record_length;
+        data->recordCount++;
+        data->lastSeq = seq;
+    }
+
+    data->more = stats.newestSeq != 0 && seq <= stats.newestSeq;
+    data->header.returns = (int32_t)data->recordCount;
+}
+END_CMD
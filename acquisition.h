@@ -0,0 +1,22 @@
+#pragma once
+
+#include "peripherals.h"
+#include "timer_wheel.h"
+
+#define ACQUISITION_MAX_ENTRIES 16
+#define ACQUISITION_MAX_FRAME_BYTES 128
+#define ACQUISITION_MIN_PERIOD_US 1000
+
+// The ring keeps the newest ACQUISITION_RING_RECORDS results of up to
+// ACQUISITION_MAX_DATA bytes each, overwriting the oldest.
+#define ACQUISITION_RING_RECORDS 512
+#define ACQUISITION_MAX_DATA 32
+
+/// <summary>
+/// Stop the plan and release the handles it pinned. The plan is deliberately left running
+/// when the client disconnects, so sampling carries on through network dropouts.
+/// </summary>
+void Acquisition_Stop(void);
+
+DECLARE_CMD(RemoteX_Acquisition);
+DECLARE_CMD(RemoteX_AcquisitionFetch);
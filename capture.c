@@ -0,0 +1,83 @@
+#include "capture.h"
+
+#include <applibs/log.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "contract.h"
+
+static FILE *capture_file;
+static uint64_t start_ns;
+
+static uint64_t monotonic_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+int Capture_Start(const char *path)
+{
+    CaptureFileHeader header = {.formatVersion = CAPTURE_FORMAT_VERSION, .contractVersion = REMOTEX_CONTRACT_VERSION};
+
+    Capture_Stop();
+
+    if ((capture_file = fopen(path, "wb")) == NULL)
+    {
+        return -1;
+    }
+
+    memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+    if (fwrite(&header, sizeof(header), 1, capture_file) != 1)
+    {
+        int error = errno;
+        fclose(capture_file);
+        capture_file = NULL;
+        errno = error;
+        return -1;
+    }
+
+    start_ns = monotonic_ns();
+    Log_Debug("INFO: Capturing client traffic to %s.\n", path);
+    return 0;
+}
+
+void Capture_Stop(void)
+{
+    if (capture_file != NULL)
+    {
+        fclose(capture_file);
+        capture_file = NULL;
+    }
+}
+
+bool Capture_Active(void)
+{
+    return capture_file != NULL;
+}
+
+void Capture_Record(CaptureEvent event, const void *frame, size_t length)
+{
+    if (capture_file == NULL)
+    {
+        return;
+    }
+
+    CaptureRecord record = {.timeNs = monotonic_ns() - start_ns, .event = event, .length = (uint16_t)length};
+
+    // A failed write stops the capture rather than leaving a truncated record behind later ones.
+    if (fwrite(&record, sizeof(record), 1, capture_file) != 1 ||
+        (length > 0 && fwrite(frame, length, 1, capture_file) != 1))
+    {
+        Log_Debug("ERROR: Capture stopped: %s (%d).\n", strerror(errno), errno);
+        Capture_Stop();
+        return;
+    }
+
+    if (event == Capture_Disconnected)
+    {
+        fflush(capture_file);
+    }
+}
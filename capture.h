@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Traffic capture: every frame received from and sent to the client, with the time since the
+// capture started, for replay against the host build with host/tools/replay.
+//
+// File layout: a CaptureFileHeader, then records, each a CaptureRecord followed by length
+// bytes of frame. Connected and Disconnected records have no frame.
+#define CAPTURE_MAGIC "RXCAP"
+#define CAPTURE_FORMAT_VERSION 1
+
+typedef enum __attribute__((packed))
+{
+    Capture_Received,
+    Capture_Sent,
+    Capture_Connected,
+    Capture_Disconnected
+} CaptureEvent;
+
+typedef struct __attribute__((packed))
+{
+    char magic[5];
+    uint8_t formatVersion;
+    uint8_t contractVersion;
+    uint8_t reserved;
+} CaptureFileHeader;
+
+typedef struct __attribute__((packed))
+{
+    uint64_t timeNs;
+    CaptureEvent event;
+    uint16_t length;
+} CaptureRecord;
+
+/// <summary>
+/// Start writing a capture to path, replacing any existing file. Returns 0, or -1 with errno set.
+/// </summary>
+int Capture_Start(const char *path);
+
+/// <summary>
+/// Flush and close the capture file, if one is open.
+/// </summary>
+void Capture_Stop(void);
+
+bool Capture_Active(void);
+
+/// <summary>
+/// Append a record. Frames are buffered and flushed when the client disconnects. Does nothing
+/// unless a capture is active.
+/// </summary>
+void Capture_Record(CaptureEvent event, const void *frame, size_t length);
@@ -0,0 +1,120 @@
+#include <errno.h>
+
+#include "client_session.h"
+#include "timer_wheel.h"
+
+static uint32_t idle_timeout_ms;
+static uint32_t takeover_idle_ms;
+
+static bool connected;
+static uint64_t connected_ns;
+static uint64_t last_activity_ns;
+static TimerWheelTimer idle_timer;
+
+static void (*expired_callback)(void *context);
+static void *expired_context;
+
+void ClientSession_SetExpired(void (*expired)(void *context), void *context)
+{
+    expired_callback = expired;
+    expired_context = context;
+}
+
+/// <summary>
+/// Arm the idle timer for when the client will have been silent for the idle timeout.
+/// Activity only moves last_activity_ns, so a busy client costs nothing here; the timer
+/// re-arms itself for the remainder when it finds the client was active meanwhile.
+/// </summary>
+static void arm_idle_timer(uint64_t now)
+{
+    TimerWheel *wheel = TimerWheel_Default();
+
+    TimerWheel_Cancel(&idle_timer);
+    if (!connected || idle_timeout_ms == 0 || wheel == NULL)
+    {
+        return;
+    }
+
+    uint64_t due = last_activity_ns + (uint64_t)idle_timeout_ms * 1000000;
+    TimerWheel_StartOneShot(wheel, &idle_timer, due > now ? (due - now + 999) / 1000 : 0);
+}
+
+static void IdleTimerHandler(TimerWheelTimer *timer, void *context)
+{
+    uint64_t now = TimerWheel_NowNs();
+
+    if (now - last_activity_ns < (uint64_t)idle_timeout_ms * 1000000)
+    {
+        arm_idle_timer(now);
+        return;
+    }
+
+    if (expired_callback != NULL)
+    {
+        expired_callback(expired_context);
+    }
+}
+
+void ClientSession_Connected(void)
+{
+    if (idle_timer.handler == NULL)
+    {
+        TimerWheel_InitTimer(&idle_timer, IdleTimerHandler, NULL);
+    }
+
+    connected = true;
+    connected_ns = last_activity_ns = TimerWheel_NowNs();
+    arm_idle_timer(connected_ns);
+}
+
+void ClientSession_Disconnected(void)
+{
+    connected = false;
+    TimerWheel_Cancel(&idle_timer);
+}
+
+void ClientSession_Activity(void)
+{
+    last_activity_ns = TimerWheel_NowNs();
+}
+
+uint32_t ClientSession_IdleMs(void)
+{
+    return connected ? (uint32_t)((TimerWheel_NowNs() - last_activity_ns) / 1000000) : 0;
+}
+
+bool ClientSession_TakeoverAllowed(void)
+{
+    return connected && takeover_idle_ms != 0 &&
+           TimerWheel_NowNs() - last_activity_ns >= (uint64_t)takeover_idle_ms * 1000000;
+}
+
+DEFINE_CMD(RemoteX_Session, data, nread)
+{
+    uint64_t now = TimerWheel_NowNs();
+
+    data->header.returns = 0;
+
+    switch (data->op)
+    {
+    case SessionOp_Ping:
+        break;
+
+    case SessionOp_Configure:
+        idle_timeout_ms = data->idleTimeoutMs;
+        takeover_idle_ms = data->takeoverIdleMs;
+        arm_idle_timer(now);
+        break;
+
+    default:
+        data->header.returns = -1;
+        errno = EINVAL;
+        break;
+    }
+
+    data->idleTimeoutMs = idle_timeout_ms;
+    data->takeoverIdleMs = takeover_idle_ms;
+    data->serverNs = now;
+    data->connectedMs = connected ? (uint32_t)((now - connected_ns) / 1000000) : 0;
+}
+END_CMD
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "peripherals.h"
+
+// TCP keepalive applied to every client socket, so a peer that vanished without closing the
+// connection is dropped after about IDLE + INTERVAL * COUNT seconds. The user timeout bounds
+// how long sent data may stay unacknowledged, which keepalive does not cover.
+#define CLIENT_SESSION_KEEPALIVE_IDLE_S 5
+#define CLIENT_SESSION_KEEPALIVE_INTERVAL_S 1
+#define CLIENT_SESSION_KEEPALIVE_COUNT 3
+#define CLIENT_SESSION_USER_TIMEOUT_MS 10000
+
+/// <summary>
+/// Register the callback invoked on the event loop when the client has been silent for the
+/// idle timeout. The callback is expected to close the connection.
+/// </summary>
+void ClientSession_SetExpired(void (*expired)(void *context), void *context);
+
+/// <summary>
+/// Start tracking a newly accepted client.
+/// </summary>
+void ClientSession_Connected(void);
+
+/// <summary>
+/// Stop tracking the client. Called when the connection closes for any reason.
+/// </summary>
+void ClientSession_Disconnected(void);
+
+/// <summary>
+/// Note that bytes arrived from the client.
+/// </summary>
+void ClientSession_Activity(void);
+
+/// <summary>
+/// Milliseconds since bytes last arrived from the client.
+/// </summary>
+uint32_t ClientSession_IdleMs(void);
+
+/// <summary>
+/// Returns true if the takeover policy lets a new connection replace the current client,
+/// which it does once the client has been silent for takeoverIdleMs.
+/// </summary>
+bool ClientSession_TakeoverAllowed(void);
+
+DECLARE_CMD(RemoteX_Session);
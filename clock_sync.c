@@ -0,0 +1,29 @@
+#include "clock_sync.h"
+#include "timer_wheel.h"
+
+static uint64_t receive_ns;
+
+void ClockSync_MarkReceive(void)
+{
+    receive_ns = TimerWheel_NowNs();
+}
+
+void ClockSync_StampTransmit(uint8_t *frame, size_t length)
+{
+    RemoteX_TimeSync_t *data = (RemoteX_TimeSync_t *)frame;
+
+    if (length >= sizeof(RemoteX_TimeSync_t) && data->header.cmd == RemoteX_TimeSync_c)
+    {
+        data->serverTransmitNs = TimerWheel_NowNs();
+    }
+}
+
+DEFINE_CMD(RemoteX_TimeSync, data, nread)
+{
+    data->serverReceiveNs = receive_ns;
+    // Overwritten at send time; set here too for requests run without a socket, such as
+    // scheduled ones.
+    data->serverTransmitNs = TimerWheel_NowNs();
+    data->header.returns = 0;
+}
+END_CMD
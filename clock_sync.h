@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "peripherals.h"
+
+// Clients estimate offset and round trip delay from four timestamps per exchange:
+//   t1 clientTransmitNs, t2 serverReceiveNs, t3 serverTransmitNs, t4 client receive time
+//   offset = ((t2 - t1) + (t3 - t4)) / 2, delay = (t4 - t1) - (t3 - t2)
+// Keep the exchange with the smallest delay out of several, and fit offset over time for drift.
+
+/// <summary>
+/// Record the device time at which the current request finished arriving.
+/// </summary>
+void ClockSync_MarkReceive(void);
+
+/// <summary>
+/// If the frame about to be sent is a time sync response, write the transmit time into it.
+/// Called immediately before the first send of each response.
+/// </summary>
+void ClockSync_StampTransmit(uint8_t *frame, size_t length);
+
+DECLARE_CMD(RemoteX_TimeSync);
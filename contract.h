@@ -48,7 +48,42 @@ typedef enum __attribute__((packed))
     RemoteX_PlatformInformation_c,
 
     UART_InitConfig_c,
-    UART_Open_c
+    UART_Open_c,
+
+    RemoteX_FlowControl_c,
+
+    RemoteX_ExecuteAt_c,
+    RemoteX_ExecuteStatus_c,
+
+    RemoteX_TimeSync_c,
+
+    GPIO_Waveform_c,
+
+    PWM_Profile_c,
+
+    RemoteX_Rules_c,
+
+    RemoteX_Macro_c,
+    RemoteX_MacroInvoke_c,
+
+    RemoteX_Acquisition_c,
+    RemoteX_AcquisitionFetch_c,
+
+    I2CMaster_Scan_c,
+    I2CMaster_BurstRead_c,
+
+    SPIMaster_StreamWrite_c,
+
+    RemoteX_Kv_c,
+    RemoteX_StorageCache_c,
+
+    GPIO_SetValues_c,
+    GPIO_GetValues_c,
+    GPIO_Measure_c,
+
+    RemoteX_GetStats_c,
+    RemoteX_LoadShed_c,
+    RemoteX_Session_c
 } SOCKET_CMD;
 
 typedef struct __attribute__((packed))
@@ -257,10 +292,11 @@ typedef struct __attribute__((packed))
     CTX_HEADER header;
     int32_t fd;
     uint32_t transferCount;
-    int32_t length;
+    int32_t length; // Bytes of read data returned in data_block
     DATA_BLOCK data_block; // Must be the last element in the struct
 } SPIMaster_TransferSequential_t;
 
+// The last 40 KB of the 64 KB file belong to the key value store, so keep client data below 24 KB
 typedef struct __attribute__((packed))
 {
     CTX_HEADER header;
@@ -295,6 +331,7 @@ typedef struct __attribute__((packed))
     int32_t whence;
 } RemoteX_Lseek_t;
 
+// Fails with EBUSY while a rule or the acquisition plan uses fd
 typedef struct __attribute__((packed))
 {
     CTX_HEADER header;
@@ -320,3 +357,644 @@ typedef struct __attribute__((packed))
     int32_t uartId;
     DATA_BLOCK data_block; // Must be the last element in the struct
 } UART_Open_t;
+
+typedef enum __attribute__((packed))
+{
+    // Hold frames until the client grants credit; refuse new frames once the queue is full
+    FlowControl_Policy_Block,
+    // Drop the oldest queued frame to make room for the newest one
+    FlowControl_Policy_KeepLatest
+} FLOW_CONTROL_POLICY;
+
+typedef struct __attribute__((packed))
+{
+    CTX_HEADER header;
+    uint32_t grantCredits;
+    FLOW_CONTROL_POLICY policy;
+    bool reset;
+    uint32_t credits;
+    uint32_t queuedFrames;
+    uint32_t queuedBytes;
+    uint32_t sentFrames;
+    uint32_t droppedFrames;
+} RemoteX_FlowControl_t;
+
+// Unsolicited frame sent by the server. header.respond is false and header.cmd is the command that produced it.
+typedef struct __attribute__((packed))
+{
+    CTX_HEADER header;
+    uint32_t sequence;
+    uint32_t dropped;
+    int32_t length;
+    DATA_BLOCK data_block; // Must be the last element in the struct
+} RemoteX_Push_t;
+
+typedef enum __attribute__((packed))
+{
+    ExecuteState_Unknown,
+    ExecuteState_Pending,
+    ExecuteState_Done,
+    ExecuteState_Cancelled
+} EXECUTE_STATE;
+
+// Times are the device CLOCK_MONOTONIC in nanoseconds
+typedef struct __attribute__((packed))
+{
+    CTX_HEADER header;
+    uint64_t executeAtNs;
+    uint64_t receivedNs;
+    int32_t length;
+    DATA_BLOCK data_block; // Command frames run back to back, must be the last element in the struct
+} RemoteX_ExecuteAt_t;
+
+typedef struct __attribute__((packed))
+{
+    CTX_HEADER header;
+    uint32_t id;
+    bool cancel;
+    EXECUTE_STATE state;
+    uint64_t executeAtNs;
+    uint64_t executedNs;
+    int64_t latenessNs;
+    int32_t framesExecuted;
+} RemoteX_ExecuteStatus_t;
+
+// Push frame payload sent when a scheduled request runs, followed by the response of each frame
+typedef struct __attribute__((packed))
+{
+    uint32_t id;
+    uint64_t executeAtNs;
+    uint64_t executedNs;
+    int64_t latenessNs;
+    int32_t framesExecuted;
+} ExecuteAt_Report_t;
+
+// NTP style exchange. The client fills clientTransmitNs from its own clock and the server
+// adds its CLOCK_MONOTONIC receive and transmit times.
+typedef struct __attribute__((packed))
+{
+    CTX_HEADER header;
+    uint64_t clientTransmitNs;
+    uint64_t serverReceiveNs;
+    uint64_t serverTransmitNs;
+} RemoteX_TimeSync_t;
+
+// Actions for commands that run a sequence on the device after the request has been answered
+typedef enum __attribute__((packed))
+{
+    Sequence_Start,
+    Sequence_Cancel,
+    Sequence_Status
+} SEQUENCE_ACTION;
+
+typedef enum __attribute__((packed))
+{
+    SequenceState_Idle,
+    SequenceState_Running,
+    SequenceState_Completed,
+    SequenceState_Cancelled,
+    SequenceState_Failed
+} SEQUENCE_STATE;
+
+typedef struct __attribute__((packed))
+{
+    int32_t gpioFd;
+    uint8_t value;
+    uint32_t delayUs; // Time from this edge to the next one
+} GPIO_WaveformStep_t;
+
+// Timing error is how long after its scheduled time each edge was driven
+typedef struct __attribute__((packed))
+{
+    SEQUENCE_STATE state;
+    uint64_t startedNs;
+    uint32_t stepsExecuted;
+    uint32_t loopsCompleted;
+    uint32_t setValueErrors;
+    uint32_t yields;
+    int64_t minErrorNs;
+    int64_t meanErrorNs;
+    int64_t maxErrorNs;
+} GPIO_WaveformStats_t;
+
+typedef struct __attribute__((packed))
+{
+    CTX_HEADER header;
+    SEQUENCE_ACTION action;
+    uint32_t loops; // 0 repeats until cancelled
+    uint32_t stepCount;
+    GPIO_WaveformStats_t stats;
+    DATA_BLOCK data_block; // GPIO_WaveformStep_t array, must be the last element in the struct
+} GPIO_Waveform_t;
+
+typedef enum __attribute__((packed))
+{
+    PwmProfile_Points,      // Apply each point in turn
+    PwmProfile_Linear,      // Interpolate linearly from the first point to the second over pointCount steps
+    PwmProfile_Exponential  // As linear but along an exponential curve, for perceptually even LED fades
+} PWM_PROFILE_KIND;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t period_nsec;
+    uint32_t dutyCycle_nsec;
+    uint8_t polarity;
+    bool enabled;
+    uint32_t holdUs; // Must not be 0
+} PWM_ProfilePoint_t;
+
+// Steps are missed when the device falls so far behind that a later step is already due
+typedef struct __attribute__((packed))
+{
+    int32_t pwmFd;
+    uint32_t pwmChannel;
+    SEQUENCE_STATE state;
+    uint64_t startedNs;
+    uint32_t stepsApplied;
+    uint32_t stepsMissed;
+    uint32_t applyErrors;
+    uint32_t loopsCompleted;
+} PWM_ProfileStats_t;
+
+typedef struct __attribute__((packed))
+{
+    CTX_HEADER header;
+    SEQUENCE_ACTION action;
+    int32_t pwmFd;
+    uint32_t pwmChannel;
+    PWM_PROFILE_KIND kind;
+    uint32_t pointCount; // Points in data_block, or steps in a ramp, at most 4096
+    uint32_t loops;      // 0 repeats until cancelled
+    bool reverseOnLoop;  // Ramps run back and forth to sweep
+    PWM_ProfileStats_t stats;
+    DATA_BLOCK data_block; // PWM_ProfilePoint_t array, must be the last element in the struct
+} PWM_Profile_t;
+
+typedef enum __attribute__((packed))
+{
+    RuleCondition_AdcAbove,   // ADC sample > threshold
+    RuleCondition_AdcBelow,   // ADC sample < threshold
+    RuleCondition_GpioRising, // Input read 1 after reading 0 on the previous evaluation
+    RuleCondition_GpioFalling,
+    RuleCondition_GpioHigh,
+    RuleCondition_GpioLow
+} RULE_CONDITION;
+
+typedef enum __attribute__((packed))
+{
+    RuleAction_None, // Only push the event
+    RuleAction_SetGpio,
+    RuleAction_ApplyPwm
+} RULE_ACTION;
+
+// A rule fires when its condition holds for `samples` consecutive evaluations, then stays
+// latched until the condition fails, or is removed after firing when oneShot is set. Rules
+// stay armed when the client disconnects, until removed or cleared.
+typedef struct __attribute__((packed))
+{
+    RULE_CONDITION condition;
+    int32_t sourceFd;
+    uint32_t sourceChannel; // ADC channel
+    uint32_t threshold;     // Raw ADC sample
+    uint16_t samples;
+    RULE_ACTION action;
+    int32_t actionFd;
+    uint32_t actionChannel; // PWM channel
+    uint8_t gpioValue;
+    uint32_t period_nsec;
+    uint32_t dutyCycle_nsec;
+    uint8_t polarity;
+    bool enabled;
+    bool pushEvent;
+    bool oneShot;
+} RemoteX_Rule_t;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t evaluations;
+    uint32_t matches;
+    uint32_t fires;
+    uint32_t sourceErrors;
+    uint32_t actionErrors;
+    uint64_t lastFiredNs;
+    uint64_t totalCostNs;
+    uint32_t maxCostNs;
+} RemoteX_RuleStats_t;
+
+// A pass stops once it has used budgetUs and carries on from the next rule in the next pass.
+typedef struct __attribute__((packed))
+{
+    uint32_t periodUs;
+    uint32_t budgetUs;
+    uint32_t ruleCount;
+    uint32_t passes;
+    uint32_t passesOverBudget;
+    uint32_t maxPassNs;
+} RemoteX_RuleEngineStats_t;
+
+typedef enum __attribute__((packed))
+{
+    RuleOp_Add,       // Returns the new rule id
+    RuleOp_Remove,
+    RuleOp_Clear,
+    RuleOp_Status,    // Stats of rule id, or only the engine stats for id 0
+    RuleOp_Configure  // Set periodUs and budgetUs, 0 keeps the current value
+} RULE_OP;
+
+typedef struct __attribute__((packed))
+{
+    CTX_HEADER header;
+    RULE_OP op;
+    uint32_t id;
+    uint32_t periodUs;
+    uint32_t budgetUs;
+    RemoteX_Rule_t rule;
+    RemoteX_RuleStats_t stats;
+    RemoteX_RuleEngineStats_t engine;
+} RemoteX_Rules_t;
+
+// Pushed with header.returns set to the rule id when a rule with pushEvent fires
+typedef struct __attribute__((packed))
+{
+    uint32_t id;
+    uint64_t firedNs;
+    uint32_t value; // ADC sample or GPIO value that completed the match
+    int32_t actionResult;
+} RemoteX_RuleEvent_t;
+
+#define MACRO_NAME_LENGTH 32
+
+typedef enum __attribute__((packed))
+{
+    MacroOp_Define, // Store the frames in data_block under name, replacing a macro of the same name. Returns the id
+    MacroOp_Delete,
+    MacroOp_Status, // Name, length and frame count of id
+    MacroOp_Save    // Write every macro to the key value store in mutable storage
+} MACRO_OP;
+
+typedef struct __attribute__((packed))
+{
+    CTX_HEADER header;
+    MACRO_OP op;
+    uint8_t id;
+    char name[MACRO_NAME_LENGTH];
+    uint16_t length; // Bytes of frames in data_block
+    uint16_t frameCount;
+    DATA_BLOCK data_block; // Must be the last element in the struct
+} RemoteX_Macro_t;
+
+// Overwrites length bytes at offset into the macro's frames for one invocation. The bytes
+// follow the patch. Patches cannot touch a frame's CTX_HEADER.
+typedef struct __attribute__((packed))
+{
+    uint16_t offset;
+    uint8_t length;
+} MacroPatch_t;
+
+// data_block holds patchCount patches on the way in, and the responses of the frames
+// with respond set on the way out, truncated to the response_length requested
+typedef struct __attribute__((packed))
+{
+    CTX_HEADER header;
+    uint8_t id;
+    uint8_t patchCount;
+    uint16_t framesExecuted;
+    uint16_t responsesLength;
+    DATA_BLOCK data_block; // Must be the last element in the struct
+} RemoteX_MacroInvoke_t;
+
+typedef enum __attribute__((packed))
+{
+    AcquisitionOp_Install, // Replace the running plan with the entries in data_block. A rejected plan leaves it running
+    AcquisitionOp_Stop,
+    AcquisitionOp_Status
+} ACQUISITION_OP;
+
+// A plan entry is followed by an I2CMaster_WriteThenRead, SPIMaster_WriteThenRead or
+// ADC_Poll request frame, which is run every periodUs
+typedef struct __attribute__((packed))
+{
+    uint32_t periodUs;
+} AcquisitionEntry_t;
+
+typedef struct __attribute__((packed))
+{
+    bool running;
+    uint8_t entryCount;
+    uint32_t samples;
+    uint32_t errors;
+    uint32_t overruns; // Periods skipped because the event loop was busy
+    uint32_t oldestSeq;
+    uint32_t newestSeq;
+} AcquisitionStats_t;
+
+typedef struct __attribute__((packed))
+{
+    CTX_HEADER header;
+    ACQUISITION_OP op;
+    uint8_t entryCount;
+    uint32_t length; // Bytes of entries in data_block
+    AcquisitionStats_t stats;
+    DATA_BLOCK data_block; // Must be the last element in the struct
+} RemoteX_Acquisition_t;
+
+// Records in a fetch response are packed back to back, each followed by length bytes:
+// the data read for I2C and SPI entries, or the 32 bit sample for ADC entries
+typedef struct __attribute__((packed))
+{
+    uint32_t seq;
+    uint64_t timestampNs;
+    uint8_t entry;
+    int32_t returns;
+    int32_t err_no;
+    uint8_t length;
+} AcquisitionRecord_t;
+
+typedef struct __attribute__((packed))
+{
+    CTX_HEADER header;
+    uint32_t sinceSeq;    // Last sequence number the client holds, 0 for none
+    uint32_t recordCount;
+    uint32_t lastSeq;     // Pass as sinceSeq in the next fetch
+    uint32_t lostRecords; // Overwritten in the ring before they were fetched
+    bool more;            // Records remain that did not fit in this response
+    uint32_t length;      // Bytes of records in data_block
+    DATA_BLOCK data_block; // Must be the last element in the struct
+} RemoteX_AcquisitionFetch_t;
+
+// Probes each address from firstAddress to lastAddress with a one byte read. Both 0 scans
+// the unreserved addresses 0x08 to 0x77. A timeoutInMs other than 0 is applied to the bus
+// before the scan and stays in effect after it. Returns the number of devices found.
+typedef struct __attribute__((packed))
+{
+    CTX_HEADER header;
+    int32_t fd;
+    uint8_t firstAddress;
+    uint8_t lastAddress;
+    uint32_t timeoutInMs;
+    uint8_t present[16];  // Bit (address % 8) of byte (address / 8)
+    uint8_t probeErrno[128]; // 0 where a device answered
+} I2CMaster_Scan_t;
+
+// registerLength is 0 for a plain read, or 1 or 2 to write the register (big endian) first
+typedef struct __attribute__((packed))
+{
+    uint8_t address;
+    uint8_t registerLength;
+    uint16_t reg;
+    uint8_t length;
+} I2C_BurstEntry_t;
+
+// One per entry in the response, each followed by the entry's length bytes
+typedef struct __attribute__((packed))
+{
+    int32_t returns;
+    int32_t err_no;
+} I2C_BurstResult_t;
+
+// Runs every entry back to back without returning to the event loop. Returns the number
+// of entries read successfully.
+typedef struct __attribute__((packed))
+{
+    CTX_HEADER header;
+    int32_t fd;
+    uint8_t entryCount;
+    uint32_t spanNs; // From the start of the first transaction to the end of the last
+    DATA_BLOCK data_block; // I2C_BurstEntry_t array in, results out. Must be the last element in the struct
+} I2CMaster_BurstRead_t;
+
+typedef enum __attribute__((packed))
+{
+    SpiStream_Open,  // Start a stream on fd, returns the initial credits
+    SpiStream_Chunk, // Queue length bytes from data_block, clocked out after the response is sent
+    SpiStream_Close, // Clock out anything queued and end the stream
+    SpiStream_Status
+} SPI_STREAM_OP;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t chunks;
+    uint64_t bytes;
+    uint32_t transferErrors;
+    uint32_t stalls;       // Chunks that arrived with both buffers queued and waited for the bus
+    uint64_t busNs;        // Time spent clocking data out
+    uint32_t completedSeq; // Last chunk clocked out
+} SPIMaster_StreamStats_t;
+
+// Chunks carry seq from 1 and responses return the next seq expected. Each response grants
+// credits: the chunks the client may have in flight before it waits for the next response.
+// Set response_length to CORE_BLOCK_SIZE so chunk responses do not echo the data.
+typedef struct __attribute__((packed))
+{
+    CTX_HEADER header;
+    SPI_STREAM_OP op;
+    int32_t fd;
+    uint32_t seq;
+    uint32_t length;
+    uint8_t credits;
+    SPIMaster_StreamStats_t stats;
+    DATA_BLOCK data_block; // Must be the last element in the struct
+} SPIMaster_StreamWrite_t;
+
+#define KV_MAX_KEY_LENGTH 32
+
+typedef enum __attribute__((packed))
+{
+    KvOp_Get,    // Value of key into data_block, returns its length
+    KvOp_Put,    // Store length bytes of data_block under key
+    KvOp_Delete,
+    KvOp_List,   // NUL terminated keys from cursor into data_block, returns the count
+    KvOp_Stats
+} KV_OP;
+
+typedef struct __attribute__((packed))
+{
+    bool formatted; // False until the first put claims the store's region of mutable storage
+    uint32_t keys;
+    uint32_t liveBytes;
+    uint32_t usedBytes;
+    uint32_t capacityBytes;
+    uint32_t generation;
+    uint32_t compactions;
+} KvStats_t;
+
+typedef struct __attribute__((packed))
+{
+    CTX_HEADER header;
+    KV_OP op;
+    char key[KV_MAX_KEY_LENGTH]; // NUL padded, need not be NUL terminated at full length
+    uint16_t length;
+    uint16_t cursor; // List: first key to return in, next cursor out, 0 once every key is listed
+    KvStats_t stats;
+    DATA_BLOCK data_block; // Must be the last element in the struct
+} RemoteX_Kv_t;
+
+typedef enum __attribute__((packed))
+{
+    StorageCache_Enable,  // Cache fd, which must be an open storage file
+    StorageCache_Disable, // Flush and stop caching fd
+    StorageCache_Sync,    // Flush and fsync fd
+    StorageCache_Stats
+} STORAGE_CACHE_OP;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t readHits;
+    uint32_t readMisses;
+    uint32_t readAheads;
+    uint32_t writesCoalesced;
+    uint32_t flushes;
+    uint64_t bytesFlushed;
+} StorageCacheStats_t;
+
+typedef struct __attribute__((packed))
+{
+    CTX_HEADER header;
+    STORAGE_CACHE_OP op;
+    int32_t fd;
+    uint32_t flushDelayMs; // Enable: longest time a write stays in RAM, 0 for the default
+    StorageCacheStats_t stats;
+} RemoteX_StorageCache_t;
+
+#define GPIO_MAX_BULK_PINS 32
+
+// Pin i of gpioFds takes bit i of values. Every fd is checked before any pin is changed.
+// Returns the number of pins set.
+typedef struct __attribute__((packed))
+{
+    CTX_HEADER header;
+    uint8_t count;
+    int32_t gpioFds[GPIO_MAX_BULK_PINS];
+    uint32_t values;
+    uint32_t failedMask; // Pins whose GPIO_SetValue failed
+    uint32_t spanNs;     // From the first pin changing to the last
+} GPIO_SetValues_t;
+
+// Bit i of values is the level of pin i of gpioFds. Returns the number of pins read.
+typedef struct __attribute__((packed))
+{
+    CTX_HEADER header;
+    uint8_t count;
+    int32_t gpioFds[GPIO_MAX_BULK_PINS];
+    uint32_t values;
+    uint32_t failedMask; // Pins whose GPIO_GetValue failed, their bits in values are 0
+    uint32_t spanNs;     // From the first pin read to the last
+} GPIO_GetValues_t;
+
+// The measurement holds the event loop for the whole window.
+#define GPIO_MEASURE_MAX_WINDOW_MS 500
+
+// Durations of complete high or low phases, timed to within one sample interval
+typedef struct __attribute__((packed))
+{
+    uint32_t count;
+    uint32_t minNs;
+    uint32_t maxNs;
+    uint32_t meanNs;
+} GPIO_PhaseStats_t;
+
+// Samples gpioFd with GPIO_GetValue for windowMs and returns 0, or -1 if a read fails.
+typedef struct __attribute__((packed))
+{
+    CTX_HEADER header;
+    int32_t gpioFd;
+    uint16_t windowMs;
+    uint32_t samples;
+    uint32_t sampleRateHz; // Achieved, edges closer together than a couple of samples are missed
+    uint32_t edges;
+    uint32_t frequencyMilliHz; // Rising edge to rising edge, 0 with fewer than two rising edges
+    uint16_t dutyPermille;     // Time high over complete phases, or the level if it never changed
+    GPIO_PhaseStats_t high;
+    GPIO_PhaseStats_t low;
+} GPIO_Measure_t;
+
+// Event loop health since the stats were last reset. Lag is how late timers ran after they
+// were due. Callback times cover timer handlers and client socket events. Percentiles are
+// bucket upper bounds, within 25% of the true value.
+typedef struct __attribute__((packed))
+{
+    uint32_t timerRuns;
+    uint32_t lagP50Us;
+    uint32_t lagP90Us;
+    uint32_t lagP99Us;
+    uint32_t lagMaxUs;
+    uint32_t callbacks;
+    uint32_t callbackP50Us;
+    uint32_t callbackP90Us;
+    uint32_t callbackP99Us;
+    uint32_t callbackMaxUs;
+    uint8_t shedding;           // Load is being shed now
+    uint32_t overloadedWindows; // Windows that went over a load shedding threshold
+    uint32_t shedRequests;      // Requests refused with EBUSY
+} LoopStats_t;
+
+// Connection counters since the server started or the stats were last reset. recvCalls,
+// sendCalls and interestChanges are the socket and epoll_ctl syscalls made for the client;
+// wakeups counts client events delivered by the event loop.
+typedef struct __attribute__((packed))
+{
+    uint32_t windowMs; // Time the counters cover
+    uint32_t requests;
+    uint32_t responses;
+    uint32_t pushFrames;
+    uint32_t recvCalls;
+    uint32_t sendCalls;
+    uint32_t interestChanges;
+    uint32_t wakeups;
+    uint32_t protocolErrors; // Frames with an impossible length, each closes the connection
+    uint64_t bytesReceived;
+    uint64_t bytesSent;
+    LoopStats_t loop;
+    uint32_t refusedClients; // Turned away because another client was connected
+    uint32_t takeovers;      // Stale clients replaced by a new connection
+    uint32_t idleTimeouts;   // Clients closed by the idle timeout
+} ServerStats_t;
+
+typedef struct __attribute__((packed))
+{
+    CTX_HEADER header;
+    uint8_t reset; // Zero the counters after reading them
+    ServerStats_t stats;
+} RemoteX_GetStats_t;
+
+typedef enum __attribute__((packed))
+{
+    LoadShed_Get,
+    LoadShed_Set // 0 keeps the current value of a threshold or the push interval
+} LOAD_SHED_OP;
+
+// The server sheds load for the next window after a window of LOOP_MONITOR_WINDOW_MS where the
+// 99th percentile timer lag or the longest callback went over its threshold. While shedding,
+// slow diagnostics and requests that start push producing work fail with EBUSY, and push frames are
+// spaced at least pushIntervalMs apart.
+typedef struct __attribute__((packed))
+{
+    CTX_HEADER header;
+    LOAD_SHED_OP op;
+    bool enabled; // Set: false only measures
+    uint32_t lagThresholdUs;
+    uint32_t callbackThresholdUs;
+    uint16_t pushIntervalMs;
+    bool shedding;
+} RemoteX_LoadShed_t;
+
+typedef enum __attribute__((packed))
+{
+    SessionOp_Ping,     // Only counts as activity and reports the session
+    SessionOp_Configure // Set idleTimeoutMs and takeoverIdleMs, 0 disables either
+} SESSION_OP;
+
+// Any bytes from the client count as activity. With idleTimeoutMs set, the server closes a
+// connection that has been silent that long, so a client that is otherwise quiet should ping
+// more often. With takeoverIdleMs set, a new connection replaces a client that has been silent
+// that long instead of being turned away. A client whose TCP keepalive probes go unanswered
+// is replaced regardless. The settings outlast the connection that made them.
+typedef struct __attribute__((packed))
+{
+    CTX_HEADER header;
+    SESSION_OP op;
+    uint32_t idleTimeoutMs;
+    uint32_t takeoverIdleMs;
+    uint64_t serverNs;    // Device CLOCK_MONOTONIC when the request ran
+    uint32_t connectedMs; // How long this client has been connected
+} RemoteX_Session_t;
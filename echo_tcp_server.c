@@ -11,6 +11,7 @@
 #include <stddef.h>
 
 #include <sys/socket.h>
+#include <netinet/tcp.h>
 #include <applibs/log.h>
 #include "echo_tcp_server.h"
 
@@ -18,14 +19,20 @@ static uint8_t buffer[1024 * 5];
 
 // Support functions.
 static void HandleListenEvent(EventLoop *el, int fd, EventLoop_IoEvents events, void *context);
-static void LaunchRead(EchoServer_ServerState *serverState);
 static void HandleClientEvent(EventLoop *el, int fd, EventLoop_IoEvents events, void *context);
 static void HandleClientReadEvent(EchoServer_ServerState *serverState);
+static void ProcessReceivedFrames(EchoServer_ServerState *serverState);
 static void LaunchWrite(EchoServer_ServerState *serverState);
 static void HandleClientWriteEvent(EchoServer_ServerState *serverState);
+static void SetClientInterest(EchoServer_ServerState *serverState, EventLoop_IoEvents events);
+static void CloseClient(EchoServer_ServerState *serverState);
+static void ConfigureKeepalive(int fd);
+static bool ClientUnresponsive(int fd);
+static void HandleSessionExpired(void *context);
+static bool LoadPushFrame(EchoServer_ServerState *serverState);
+static void HandlePushReady(void *context);
 static int OpenIpV4Socket(in_addr_t ipAddr, uint16_t port, int sockType);
 static void ReportError(const char *desc);
-static void StopServer(EchoServer_ServerState *serverState, EchoServer_StopReason reason);
 
 static int (*cmd_functions[])(uint8_t *buf, ssize_t nread) = {
     ADD_CMD(GPIO_OpenAsOutput),
@@ -67,7 +74,43 @@ static int (*cmd_functions[])(uint8_t *buf, ssize_t nread) = {
     ADD_CMD(RemoteX_PlatformInformation),
 
     ADD_CMD(UART_InitConfig),
-    ADD_CMD(UART_Open)
+    ADD_CMD(UART_Open),
+
+    ADD_CMD(RemoteX_FlowControl),
+
+    ADD_CMD(RemoteX_ExecuteAt),
+    ADD_CMD(RemoteX_ExecuteStatus),
+
+    ADD_CMD(RemoteX_TimeSync),
+
+    ADD_CMD(GPIO_Waveform),
+
+    ADD_CMD(PWM_Profile),
+
+    ADD_CMD(RemoteX_Rules),
+
+    ADD_CMD(RemoteX_Macro),
+    ADD_CMD(RemoteX_MacroInvoke),
+
+    ADD_CMD(RemoteX_Acquisition),
+    ADD_CMD(RemoteX_AcquisitionFetch),
+
+    ADD_CMD(I2CMaster_Scan),
+    ADD_CMD(I2CMaster_BurstRead),
+
+    ADD_CMD(SPIMaster_StreamWrite),
+
+    ADD_CMD(RemoteX_Kv),
+
+    ADD_CMD(RemoteX_StorageCache),
+
+    ADD_CMD(GPIO_SetValues),
+    ADD_CMD(GPIO_GetValues),
+    ADD_CMD(GPIO_Measure),
+
+    ADD_CMD(RemoteX_GetStats),
+    ADD_CMD(RemoteX_LoadShed),
+    ADD_CMD(RemoteX_Session)
 
 };
 
@@ -82,6 +125,9 @@ EchoServer_ServerState *EchoServer_Start(EventLoop *eventLoopInstance, in_addr_t
     }
 
     ledger_initialize();
+    FlowControl_Reset();
+    ServerStats_Reset();
+    LoopMonitor_Initialize();
 
     // Set EchoServer_ServerState state to unused values so it can be safely cleaned up if only a
     // subset of the resources are successfully allocated.
@@ -90,9 +136,16 @@ EchoServer_ServerState *EchoServer_Start(EventLoop *eventLoopInstance, in_addr_t
     serverState->listenEventReg = NULL;
     serverState->clientFd = -1;
     serverState->clientEventReg = NULL;
+    serverState->rxLength = 0;
     serverState->txPayload = NULL;
+    serverState->txBusy = false;
+    serverState->outputArmed = false;
+    serverState->processing = false;
     serverState->shutdownCallback = shutdownCallback;
 
+    FlowControl_SetNotify(HandlePushReady, serverState);
+    ClientSession_SetExpired(HandleSessionExpired, serverState);
+
     int sockType = SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK;
     serverState->listenFd = OpenIpV4Socket(ipAddr, port, sockType);
     if (serverState->listenFd == -1)
@@ -152,6 +205,9 @@ void EchoServer_ShutDown(EchoServer_ServerState *serverState)
     EventLoop_UnregisterIo(serverState->eventLoop, serverState->listenEventReg);
     CloseFdAndPrintError(serverState->listenFd, "listenFd");
 
+    FlowControl_SetNotify(NULL, NULL);
+    ClientSession_SetExpired(NULL, NULL);
+
     // free(serverState->txPayload);
 
     free(serverState);
@@ -177,16 +233,28 @@ static void HandleListenEvent(EventLoop *el, int fd, EventLoop_IoEvents events,
 
         Log_Debug("INFO: TCP server: Accepted client connection (fd %d).\n", localFd);
 
-        // If already have a client, then close the newly-accepted socket.
+        // If already have a client, then close the newly-accepted socket, unless the current
+        // client is stale and the newcomer can take its place.
         if (serverState->clientFd >= 0)
         {
-            Log_Debug(
-                "INFO: TCP server: Closing incoming client connection: only one client supported "
-                "at a time.\n");
-            break;
+            if (!ClientSession_TakeoverAllowed() && !ClientUnresponsive(serverState->clientFd))
+            {
+                Log_Debug(
+                    "INFO: TCP server: Closing incoming client connection: only one client supported "
+                    "at a time.\n");
+                server_stats.refusedClients++;
+                break;
+            }
+
+            Log_Debug("INFO: TCP server: Replacing stale client connection (fd %d).\n", serverState->clientFd);
+            server_stats.takeovers++;
+            CloseClient(serverState);
         }
 
-        serverState->clientEventReg = EventLoop_RegisterIo(serverState->eventLoop, localFd, 0x0,
+        ConfigureKeepalive(localFd);
+
+        // Input stays the only interest for the life of the connection, unless a send blocks.
+        serverState->clientEventReg = EventLoop_RegisterIo(serverState->eventLoop, localFd, EventLoop_Input,
                                                            HandleClientEvent, serverState);
         if (serverState->clientEventReg == NULL)
         {
@@ -196,135 +264,321 @@ static void HandleListenEvent(EventLoop *el, int fd, EventLoop_IoEvents events,
 
         // Socket opened successfully, so transfer ownership to EchoServer_ServerState object.
         serverState->clientFd = localFd;
+        serverState->rxLength = 0;
+        serverState->txBusy = false;
+        serverState->outputArmed = false;
         localFd = -1;
 
-        LaunchRead(serverState);
+        // A new client starts with no credit, so nothing is pushed until it asks for it.
+        FlowControl_Reset();
+        ClientSession_Connected();
+        Capture_Record(Capture_Connected, NULL, 0);
     } while (0);
 
     CloseFdAndPrintError(localFd, "localClientFd");
 }
 
-static void LaunchRead(EchoServer_ServerState *serverState)
+/// <summary>
+///     Load the next push frame into the transmit buffer if the client has credit for it.
+///     Returns true if there is a frame to send.
+/// </summary>
+static bool LoadPushFrame(EchoServer_ServerState *serverState)
 {
-    serverState->inLineSize = 0;
+    size_t length = FlowControl_Dequeue((uint8_t *)serverState->input, sizeof(serverState->input));
+    if (length == 0)
+    {
+        return false;
+    }
+
+    serverState->txPayload = (uint8_t *)serverState->input;
+    serverState->txPayloadSize = length;
+    serverState->txBytesSent = 0;
+    server_stats.pushFrames++;
+    Capture_Record(Capture_Sent, serverState->txPayload, length);
+    return true;
+}
 
-    EventLoop_ModifyIoEvents(serverState->eventLoop, serverState->clientEventReg, EventLoop_Input);
+/// <summary>
+///     Invoked by flow control when a frame becomes sendable. Frames queued while a request
+///     is in progress are picked up when that request's response has been written.
+/// </summary>
+static void HandlePushReady(void *context)
+{
+    EchoServer_ServerState *serverState = context;
+
+    if (serverState->clientFd >= 0 && !serverState->txBusy && LoadPushFrame(serverState))
+    {
+        serverState->txBusy = true;
+        HandleClientWriteEvent(serverState);
+    }
 }
 
 static void HandleClientEvent(EventLoop *el, int fd, EventLoop_IoEvents events, void *context)
 {
     EchoServer_ServerState *serverState = context;
+    uint64_t startNs = TimerWheel_NowNs();
+
+    server_stats.wakeups++;
 
     if (events & EventLoop_Input)
     {
         HandleClientReadEvent(serverState);
     }
 
-    if (events & EventLoop_Output)
+    if ((events & EventLoop_Output) && serverState->clientFd >= 0)
     {
         HandleClientWriteEvent(serverState);
     }
+
+    LoopMonitor_Callback(TimerWheel_NowNs() - startNs);
 }
 
-void process_command(EchoServer_ServerState *serverState, const uint8_t *buf, ssize_t nread)
+/// <summary>
+///     Requests refused while load is shed: diagnostics that hold the event loop for a long
+///     time, and requests that start work producing push frames. Every sequence, rule and
+///     acquisition request has its action right after the header. Requests that stop work or
+///     read status still run so the client can back off.
+/// </summary>
+static bool Sheddable(const uint8_t *buf, ssize_t nread)
+{
+    const CTX_HEADER *header = (const CTX_HEADER *)buf;
+    bool hasAction = nread > (ssize_t)sizeof(CTX_HEADER);
+    uint8_t action = hasAction ? buf[sizeof(CTX_HEADER)] : 0;
+
+    switch (header->cmd)
+    {
+    case GPIO_Measure_c:
+    case I2CMaster_Scan_c:
+    case RemoteX_ExecuteAt_c:
+        return true;
+
+    case GPIO_Waveform_c:
+    case PWM_Profile_c:
+        return hasAction && action == Sequence_Start;
+
+    case RemoteX_Rules_c:
+        return hasAction && action == RuleOp_Add;
+
+    case RemoteX_Acquisition_c:
+        return hasAction && action == AcquisitionOp_Install;
+
+    default:
+        return false;
+    }
+}
+
+bool dispatch_command(uint8_t *buf, ssize_t nread)
 {
     CTX_HEADER *header = (CTX_HEADER *)buf;
 
     // Validate incoming command and contract version
     if (header->cmd < NELEMS(cmd_functions) && header->contract_version <= REMOTEX_CONTRACT_VERSION)
     {
-        cmd_functions[header->cmd]((uint8_t *)buf, nread);
-    }
-    else
-    {
-        Log_Debug("Error: Request uses newer contract version. Rebuild RemoteX service with latest contact.\n");
-        header->contract_version = REMOTEX_CONTRACT_VERSION;
+        if (LoopMonitor_Shedding() && Sheddable(buf, nread))
+        {
+            header->returns = -1;
+            header->err_no = EBUSY;
+            LoopMonitor_Rejected();
+            return true;
+        }
+
+        cmd_functions[header->cmd](buf, nread);
+        return true;
     }
 
+    Log_Debug("Error: Request uses newer contract version. Rebuild RemoteX service with latest contact.\n");
+    header->contract_version = REMOTEX_CONTRACT_VERSION;
+    return false;
+}
+
+void process_command(EchoServer_ServerState *serverState, const uint8_t *buf, ssize_t nread)
+{
+    CTX_HEADER *header = (CTX_HEADER *)buf;
+
+    dispatch_command((uint8_t *)buf, nread);
+
     if (!header->respond)
     {
-        LaunchRead(serverState);
+        // Send any push frames the client has credit for before the next request.
+        serverState->txBusy = false;
+        HandlePushReady(serverState);
     }
     else
     {
         memcpy(serverState->input, buf, (size_t)header->response_length);
         serverState->inLineSize = (size_t)header->response_length;
+        server_stats.responses++;
         LaunchWrite(serverState);
     }
 }
 
-static void HandleClientReadEvent(EchoServer_ServerState *serverState)
+/// <summary>
+///     Release everything the departed client owned: its open peripherals, queued push
+///     frames and any work scheduled on its behalf. Rules and acquisition plans keep
+///     running on the handles they pinned.
+/// </summary>
+static void ClientDisconnected(void)
 {
-    int state_machine = 0;
-    ssize_t bytes_returned;
-    uint16_t block_length;
-    uint8_t byte_0;
-    uint8_t byte_1;
+    Capture_Record(Capture_Disconnected, NULL, 0);
+    Scheduler_CancelAll();
+    GpioWaveform_Cancel();
+    PwmProfile_CancelAll();
+    SpiStream_Cancel();
+    StorageCache_ReleaseAll();
+    ledger_close();
+    FlowControl_Reset();
+    ClientSession_Disconnected();
+}
 
-    EventLoop_ModifyIoEvents(serverState->eventLoop, serverState->clientEventReg, EventLoop_None);
+/// <summary>
+///     Close the client connection after it closed or failed, and release what it owned.
+/// </summary>
+static void CloseClient(EchoServer_ServerState *serverState)
+{
+    EventLoop_UnregisterIo(serverState->eventLoop, serverState->clientEventReg);
+    serverState->clientEventReg = NULL;
+
+    CloseFdAndPrintError(serverState->clientFd, "clientFd");
+    serverState->clientFd = -1;
+    serverState->rxLength = 0;
+    serverState->txBusy = false;
+    serverState->outputArmed = false;
+
+    ClientDisconnected();
+}
 
-    while (state_machine < 3)
+/// <summary>
+///     Turn on TCP keepalive with short timings so a client that disappeared without closing
+///     its connection is noticed in seconds. Failure only loses the early detection.
+/// </summary>
+static void ConfigureKeepalive(int fd)
+{
+    int enable = 1;
+    int idle = CLIENT_SESSION_KEEPALIVE_IDLE_S;
+    int interval = CLIENT_SESSION_KEEPALIVE_INTERVAL_S;
+    int count = CLIENT_SESSION_KEEPALIVE_COUNT;
+    unsigned int userTimeout = CLIENT_SESSION_USER_TIMEOUT_MS;
+
+    if (setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &enable, sizeof(enable)) != 0 ||
+        setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle)) != 0 ||
+        setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval)) != 0 ||
+        setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count)) != 0 ||
+        setsockopt(fd, IPPROTO_TCP, TCP_USER_TIMEOUT, &userTimeout, sizeof(userTimeout)) != 0)
     {
-        switch (state_machine)
-        {
-        case 0:
-            bytes_returned = recv(serverState->clientFd, &byte_0, 1, 0);
-            break;
-        case 1:
-            bytes_returned = recv(serverState->clientFd, &byte_1, 1, 0);
-            break;
-        case 2:
-            // subtract 2 as already read in two bytes
-            block_length = (uint16_t)((byte_1 << 8 | byte_0) - 2);
-            buffer[0] = byte_0;
-            buffer[1] = byte_1;
-
-            ssize_t bytes_read = 0;
-            while (bytes_read < block_length)
-            {
-                ssize_t byte_count = recv(serverState->clientFd, buffer + 2 + bytes_read, (size_t)(block_length - bytes_read), 0);
-                if (byte_count > 0)
-                {
-                    bytes_read += byte_count;
-                }
+        ReportError("set keepalive");
+    }
+}
 
-                if (byte_count < 0 && errno != 11)
-                {
-                    bytes_read = byte_count;
-                    Log_Debug("Read error number: %d\n", errno);
-                    break;
-                }
-            }
+/// <summary>
+///     Returns true if the client has stopped answering: it has sent nothing for the keepalive
+///     idle time and keepalive probes have gone unacknowledged. Retransmission backoff is not
+///     enough on its own, as a live client on a lossy Wi-Fi link routinely has some.
+/// </summary>
+static bool ClientUnresponsive(int fd)
+{
+    struct tcp_info info;
+    socklen_t length = sizeof(info);
 
-            bytes_returned = bytes_read;
+    if (ClientSession_IdleMs() < CLIENT_SESSION_KEEPALIVE_IDLE_S * 1000 ||
+        getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &length) != 0)
+    {
+        return false;
+    }
 
-            if (bytes_returned != block_length)
-            {
-                Log_Debug("Block length not returned\n");
-            }
-            bytes_returned += 2; // add the first two bytes to bytes returned
-            break;
-        default:
-            break;
-        }
+    return info.tcpi_probes >= 2;
+}
+
+static void HandleSessionExpired(void *context)
+{
+    EchoServer_ServerState *serverState = context;
+
+    if (serverState->clientFd >= 0)
+    {
+        Log_Debug("INFO: TCP server: Closing idle client connection (fd %d).\n", serverState->clientFd);
+        server_stats.idleTimeouts++;
+        CloseClient(serverState);
+    }
+}
+
+/// <summary>
+///     Take whatever the client has sent with a single recv and process every complete frame.
+///     A partial frame stays buffered until the rest of it arrives.
+/// </summary>
+static void HandleClientReadEvent(EchoServer_ServerState *serverState)
+{
+    size_t space = sizeof(serverState->rxBuffer) - serverState->rxLength;
+
+    if (space > 0)
+    {
+        ssize_t received = recv(serverState->clientFd, serverState->rxBuffer + serverState->rxLength, space, 0);
+        server_stats.recvCalls++;
 
-        if (bytes_returned == -1 || bytes_returned == 0)
+        if (received > 0)
+        {
+            serverState->rxLength += (size_t)received;
+            server_stats.bytesReceived += (uint64_t)received;
+            ClientSession_Activity();
+        }
+        else if (received == 0 || (errno != EAGAIN && errno != EINTR))
         {
             Log_Debug("Connection closed\n");
+            CloseClient(serverState);
+            return;
+        }
+    }
 
-            close(serverState->clientFd);
-            serverState->clientFd = -1;
+    ProcessReceivedFrames(serverState);
+}
+
+/// <summary>
+///     Run the buffered frames in order. Stops early while a response is waiting for room in
+///     the socket, and the write path picks up where it left off once the response is out.
+/// </summary>
+static void ProcessReceivedFrames(EchoServer_ServerState *serverState)
+{
+    size_t offset = 0;
+
+    serverState->processing = true;
+
+    while (serverState->clientFd >= 0 && !serverState->txBusy &&
+           serverState->rxLength - offset >= sizeof(CTX_HEADER))
+    {
+        const CTX_HEADER *header = (const CTX_HEADER *)(serverState->rxBuffer + offset);
+        size_t block_length = header->block_length;
+
+        if (block_length < sizeof(CTX_HEADER) || block_length > sizeof(buffer) ||
+            header->response_length > sizeof(serverState->input))
+        {
+            Log_Debug("ERROR: TCP server: Frame length %zu is not valid, closing the connection.\n", block_length);
+            server_stats.protocolErrors++;
+            CloseClient(serverState);
+            break;
+        }
 
-            ledger_close();
+        if (serverState->rxLength - offset < block_length)
+        {
             break;
         }
 
-        state_machine++;
+        // Handlers write their response past the end of the request, so each frame runs
+        // in its own buffer rather than over the frames queued behind it.
+        memcpy(buffer, serverState->rxBuffer + offset, block_length);
+        offset += block_length;
+
+        server_stats.requests++;
+        serverState->txBusy = true;
+        ClockSync_MarkReceive();
+        Capture_Record(Capture_Received, buffer, block_length);
+        process_command(serverState, buffer, (ssize_t)block_length);
     }
-    if (serverState->clientFd != -1)
+
+    if (serverState->clientFd >= 0 && offset > 0)
     {
-        process_command(serverState, buffer, bytes_returned);
+        serverState->rxLength -= offset;
+        memmove(serverState->rxBuffer, serverState->rxBuffer + offset, serverState->rxLength);
     }
+
+    serverState->processing = false;
 }
 
 static void LaunchWrite(EchoServer_ServerState *serverState)
@@ -333,6 +587,9 @@ static void LaunchWrite(EchoServer_ServerState *serverState)
     serverState->txPayloadSize = serverState->inLineSize;
     serverState->txPayload = serverState->input;
     serverState->txBytesSent = 0;
+    serverState->txBusy = true;
+    ClockSync_StampTransmit(serverState->txPayload, serverState->txPayloadSize);
+    Capture_Record(Capture_Sent, serverState->txPayload, serverState->txPayloadSize);
     HandleClientWriteEvent(serverState);
 }
 
@@ -347,39 +604,75 @@ static void LaunchWrite(EchoServer_ServerState *serverState)
 /// </summary>
 static void HandleClientWriteEvent(EchoServer_ServerState *serverState)
 {
-    EventLoop_ModifyIoEvents(serverState->eventLoop, serverState->clientEventReg, EventLoop_None);
-
-    // Continue until have written entire response, error occurs, or OS TX buffer is full.
-    while (serverState->txBytesSent < serverState->txPayloadSize)
+    do
     {
-        size_t remainingBytes = serverState->txPayloadSize - serverState->txBytesSent;
-        const uint8_t *data = &serverState->txPayload[serverState->txBytesSent];
-        ssize_t bytesSentOneSysCall =
-            send(serverState->clientFd, data, remainingBytes, /* flags */ 0);
-
-        // If successfully sent data then stay in loop and try to send more data.
-        if (bytesSentOneSysCall > 0)
+        // Continue until have written entire response, error occurs, or OS TX buffer is full.
+        while (serverState->txBytesSent < serverState->txPayloadSize)
         {
-            serverState->txBytesSent += (size_t)bytesSentOneSysCall;
-        }
+            size_t remainingBytes = serverState->txPayloadSize - serverState->txBytesSent;
+            const uint8_t *data = &serverState->txPayload[serverState->txBytesSent];
+            // A peer that reset the connection must not raise SIGPIPE, which nothing handles.
+            ssize_t bytesSentOneSysCall =
+                send(serverState->clientFd, data, remainingBytes, MSG_NOSIGNAL);
+            server_stats.sendCalls++;
+
+            // If successfully sent data then stay in loop and try to send more data.
+            if (bytesSentOneSysCall > 0)
+            {
+                serverState->txBytesSent += (size_t)bytesSentOneSysCall;
+                server_stats.bytesSent += (uint64_t)bytesSentOneSysCall;
+            }
 
-        // If OS TX buffer is full then wait for next EventLoop_Output.
-        else if (bytesSentOneSysCall < 0 && errno == EAGAIN)
-        {
-            EventLoop_ModifyIoEvents(serverState->eventLoop, serverState->clientEventReg,
-                                     EventLoop_Output);
-            return;
-        }
+            // If OS TX buffer is full then wait for next EventLoop_Output. Reading pauses
+            // meanwhile so responses go out in order, and push frames queue up behind it
+            // within the flow control bound.
+            else if (bytesSentOneSysCall < 0 && errno == EAGAIN)
+            {
+                if (!serverState->outputArmed)
+                {
+                    serverState->outputArmed = true;
+                    SetClientInterest(serverState, EventLoop_Output);
+                }
+                return;
+            }
 
-        // Another error occurred so terminate the program.
-        else
-        {
-            ReportError("send");
-            StopServer(serverState, EchoServer_StopReason_Error);
-            return;
+            else if (bytesSentOneSysCall < 0 && errno == EINTR)
+            {
+                continue;
+            }
+
+            // The connection failed, for example reset by the peer or timed out by keepalive
+            // or TCP_USER_TIMEOUT. Drop the client like the read path does and keep serving.
+            else
+            {
+                ReportError("send");
+                CloseClient(serverState);
+                return;
+            }
         }
+
+        // Follow the response with any push frames the client has credit for.
+    } while (LoadPushFrame(serverState));
+
+    serverState->txBusy = false;
+
+    if (serverState->outputArmed)
+    {
+        serverState->outputArmed = false;
+        SetClientInterest(serverState, EventLoop_Input);
     }
-    LaunchRead(serverState);
+
+    // A write that finished on an output event resumes the frames that arrived behind it.
+    if (!serverState->processing)
+    {
+        ProcessReceivedFrames(serverState);
+    }
+}
+
+static void SetClientInterest(EchoServer_ServerState *serverState, EventLoop_IoEvents events)
+{
+    EventLoop_ModifyIoEvents(serverState->eventLoop, serverState->clientEventReg, events);
+    server_stats.interestChanges++;
 }
 
 static int OpenIpV4Socket(in_addr_t ipAddr, uint16_t port, int sockType)
@@ -438,20 +731,3 @@ static void ReportError(const char *desc)
 {
     Log_Debug("ERROR: TCP server: \"%s\", errno=%d (%s)\n", desc, errno, strerror(errno));
 }
-
-static void StopServer(EchoServer_ServerState *serverState, EchoServer_StopReason reason)
-{
-    if (serverState->clientEventReg != NULL)
-    {
-        EventLoop_ModifyIoEvents(serverState->eventLoop, serverState->clientEventReg,
-                                 EventLoop_None);
-    }
-
-    if (serverState->listenEventReg != NULL)
-    {
-        EventLoop_ModifyIoEvents(serverState->eventLoop, serverState->listenEventReg,
-                                 EventLoop_None);
-    }
-
-    serverState->shutdownCallback(reason);
-}
@@ -6,12 +6,30 @@
 #include "netinet/in.h"
 
 #include "dx_terminate.h"
+#include "acquisition.h"
+#include "capture.h"
+#include "client_session.h"
+#include "clock_sync.h"
 #include "dx_timer.h"
 #include "exitcode_privnetserv.h"
+#include "flow_control.h"
+#include "gpio_waveform.h"
+#include "kv_store.h"
+#include "loop_monitor.h"
+#include "macros.h"
 #include "peripherals.h"
+#include "pwm_profile.h"
+#include "rule_engine.h"
+#include "scheduler.h"
+#include "server_stats.h"
+#include "spi_stream.h"
+#include "storage_cache.h"
 #include <errno.h>
 #include <assert.h>
 
+// Room for one frame of the largest size the server accepts plus pipelined frames behind it.
+#define ECHO_SERVER_RX_BUFFER_SIZE (8 * 1024)
+
 /// <summary>Reason why the TCP server stopped.</summary>
 typedef enum {
     /// <summary>The echo server stopped because the client closed the connection.</summary>
@@ -38,6 +56,13 @@ typedef struct {
     ///     Invoked when server receives data from or sends data to the client.
     /// </summary>
     EventRegistration *clientEventReg;
+    /// <summary>
+    ///     Bytes received from the client and not yet processed. Holds any number of whole
+    ///     frames and at most one partial frame.
+    /// </summary>
+    uint8_t rxBuffer[ECHO_SERVER_RX_BUFFER_SIZE];
+    /// <summary>Number of bytes in rxBuffer.</summary>
+    size_t rxLength;
     /// <summary>Number of characters received from client.</summary>
     size_t inLineSize;
     /// <summary>Data received from client.</summary>
@@ -50,6 +75,18 @@ typedef struct {
     /// far.</summary>
     size_t txBytesSent;
     /// <summary>
+    ///     True while a request is being processed or a response or push frame is being
+    ///     written. Push frames are only started when the connection is idle.
+    /// </summary>
+    bool txBusy;
+    /// <summary>
+    ///     True while the client registration waits for output instead of input, after a send
+    ///     hit EAGAIN. Otherwise the interest set stays at input for the whole connection.
+    /// </summary>
+    bool outputArmed;
+    /// <summary>True while buffered frames are being processed.</summary>
+    bool processing;
+    /// <summary>
     ///     <para>Callback to invoke when the server stops processing connections.</para>
     ///     <para>
     ///         When this callback is invoked, the owner should clean up the server with
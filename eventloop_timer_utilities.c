@@ -14,37 +14,80 @@
 
 #include "eventloop_timer_utilities.h"
 
-static int SetTimerPeriod(int timerFd, const struct timespec *initial,
+struct EventLoopTimer {
+    EventLoop *eventLoop;
+    EventLoopTimerHandler handler;
+    int fd;
+    EventRegistration *registration;
+    // Expected expiry and period, kept for the observer. dueNs is 0 while disarmed.
+    uint64_t dueNs;
+    uint64_t periodNs;
+};
+
+static EventLoopTimerObserver timerObserver;
+
+static uint64_t MonotonicNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+static uint64_t TimespecNs(const struct timespec *value)
+{
+    return value ? (uint64_t)value->tv_sec * 1000000000 + (uint64_t)value->tv_nsec : 0;
+}
+
+static int SetTimerPeriod(EventLoopTimer *timer, const struct timespec *initial,
                           const struct timespec *repeat);
 
-static int SetTimerPeriod(int timerFd, const struct timespec *initial,
+static int SetTimerPeriod(EventLoopTimer *timer, const struct timespec *initial,
                           const struct timespec *repeat)
 {
     static const struct timespec nullTimeSpec = {.tv_sec = 0, .tv_nsec = 0};
     struct itimerspec newValue = {.it_value = initial ? *initial : nullTimeSpec,
                                   .it_interval = repeat ? *repeat : nullTimeSpec};
 
-    if (timerfd_settime(timerFd, /* flags */ 0, &newValue, /* old_value */ NULL) == -1) {
+    if (timerfd_settime(timer->fd, /* flags */ 0, &newValue, /* old_value */ NULL) == -1) {
         Log_Debug("ERROR: Could not set timer period: %s (%d).\n", strerror(errno), errno);
         return -1;
     }
 
+    uint64_t initialNs = TimespecNs(initial);
+    timer->dueNs = initialNs == 0 ? 0 : MonotonicNs() + initialNs;
+    timer->periodNs = TimespecNs(repeat);
+
     return 0;
 }
 
-struct EventLoopTimer {
-    EventLoop *eventLoop;
-    EventLoopTimerHandler handler;
-    int fd;
-    EventRegistration *registration;
-};
-
 // This satisfies the EventLoopIoCallback signature.
 static void TimerCallback(EventLoop *el, int fd, EventLoop_IoEvents events, void *context)
 {
     EventLoopTimer *timer = (EventLoopTimer *)context;
+    EventLoopTimerObserver observer = timerObserver;
+
+    if (observer == NULL || timer->dueNs == 0) {
+        timer->handler(timer);
+        return;
+    }
+
+    uint64_t startNs = MonotonicNs();
+    uint64_t lateNs = startNs > timer->dueNs ? startNs - timer->dueNs : 0;
+
+    // Work out the next expiry before the handler runs, as it may re-arm or dispose of the timer.
+    if (timer->periodNs == 0) {
+        timer->dueNs = 0;
+    } else if (startNs >= timer->dueNs) {
+        timer->dueNs += ((startNs - timer->dueNs) / timer->periodNs + 1) * timer->periodNs;
+    }
 
     timer->handler(timer);
+    observer(lateNs, MonotonicNs() - startNs);
+}
+
+void SetEventLoopTimerObserver(EventLoopTimerObserver observer)
+{
+    timerObserver = observer;
 }
 
 EventLoopTimer *CreateEventLoopPeriodicTimer(EventLoop *eventLoop, EventLoopTimerHandler handler,
@@ -66,6 +109,8 @@ EventLoopTimer *CreateEventLoopPeriodicTimer(EventLoop *eventLoop, EventLoopTime
     // Initialize to unused values in case have to clean up partially initialized object.
     timer->fd = -1;
     timer->registration = NULL;
+    timer->dueNs = 0;
+    timer->periodNs = 0;
 
     timer->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
     if (timer->fd == -1) {
@@ -73,7 +118,7 @@ EventLoopTimer *CreateEventLoopPeriodicTimer(EventLoop *eventLoop, EventLoopTime
         goto failed;
     }
 
-    if (SetTimerPeriod(timer->fd, /* initial */ period, /* repeat */ period) == -1) {
+    if (SetTimerPeriod(timer, /* initial */ period, /* repeat */ period) == -1) {
         goto failed;
     }
 
@@ -125,15 +170,15 @@ int ConsumeEventLoopTimerEvent(EventLoopTimer *timer)
 
 int SetEventLoopTimerPeriod(EventLoopTimer *timer, const struct timespec *period)
 {
-    return SetTimerPeriod(timer->fd, /* initial */ period, /* repeat */ period);
+    return SetTimerPeriod(timer, /* initial */ period, /* repeat */ period);
 }
 
 int SetEventLoopTimerOneShot(EventLoopTimer *timer, const struct timespec *delay)
 {
-    return SetTimerPeriod(timer->fd, /* initial */ delay, /* repeat */ NULL);
+    return SetTimerPeriod(timer, /* initial */ delay, /* repeat */ NULL);
 }
 
 int DisarmEventLoopTimer(EventLoopTimer *timer)
 {
-    return SetTimerPeriod(timer->fd, /* initial */ NULL, /* repeat */ NULL);
+    return SetTimerPeriod(timer, /* initial */ NULL, /* repeat */ NULL);
 }
@@ -2,6 +2,7 @@
    Licensed under the MIT License. */
 
 #pragma once
+#include <stdint.h>
 #include <time.h>
 
 #include <unistd.h>
@@ -100,3 +101,16 @@ int SetEventLoopTimerOneShot(EventLoopTimer *timer, const struct timespec *delay
 /// <seealso cref="SetEventLoopTimerOneShot" />
 /// <seealso cref="SetEventLoopTimerPeriod" />
 int DisarmEventLoopTimer(EventLoopTimer *timer);
+
+/// <summary>
+/// Applications implement a function with this signature to observe timer handlers.
+/// </summary>
+/// <param name="lateNs">How long after its expiry the timer's handler started.</param>
+/// <param name="runNs">How long the handler took.</param>
+typedef void (*EventLoopTimerObserver)(uint64_t lateNs, uint64_t runNs);
+
+/// <summary>
+/// Set the observer called after every timer handler, or NULL to stop observing.
+/// </summary>
+/// <param name="observer">Observer, or NULL.</param>
+void SetEventLoopTimerObserver(EventLoopTimerObserver observer);
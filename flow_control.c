@@ -0,0 +1,283 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "flow_control.h"
+#include "timer_wheel.h"
+
+typedef struct
+{
+    uint16_t offset;
+    uint16_t length;
+} QueuedFrame;
+
+static uint8_t queue[FLOW_CONTROL_QUEUE_SIZE];
+static QueuedFrame frames[FLOW_CONTROL_MAX_FRAMES];
+static size_t oldest_frame;
+static size_t frame_count;
+
+static bool enabled;
+static FLOW_CONTROL_POLICY policy = FlowControl_Policy_Block;
+static uint32_t credits;
+static uint32_t next_sequence;
+static uint32_t dropped_since_sent;
+static uint32_t sent_frames;
+static uint32_t dropped_frames;
+
+static void (*notify_callback)(void *context);
+static void *notify_context;
+
+static uint32_t push_interval_ms;
+static uint64_t last_push_ns;
+static TimerWheelTimer pace_timer;
+
+void FlowControl_Reset(void)
+{
+    oldest_frame = 0;
+    frame_count = 0;
+    enabled = false;
+    policy = FlowControl_Policy_Block;
+    credits = 0;
+    next_sequence = 0;
+    dropped_since_sent = 0;
+    sent_frames = 0;
+    dropped_frames = 0;
+
+    TimerWheel_Cancel(&pace_timer);
+}
+
+void FlowControl_SetNotify(void (*notify)(void *context), void *context)
+{
+    notify_callback = notify;
+    notify_context = context;
+}
+
+static size_t queued_bytes(void)
+{
+    size_t total = 0;
+
+    for (size_t i = 0; i < frame_count; i++)
+    {
+        total += frames[(oldest_frame + i) % FLOW_CONTROL_MAX_FRAMES].length;
+    }
+    return total;
+}
+
+/// <summary>
+/// Find room for a frame in the ring. Frames are stored contiguously so the
+/// writer wraps to the start of the buffer rather than splitting a frame.
+/// Returns the offset, or -1 if there is no room.
+/// </summary>
+static int find_space(size_t length)
+{
+    if (frame_count == FLOW_CONTROL_MAX_FRAMES)
+    {
+        return -1;
+    }
+
+    if (frame_count == 0)
+    {
+        return 0;
+    }
+
+    const QueuedFrame *first = &frames[oldest_frame];
+    const QueuedFrame *last = &frames[(oldest_frame + frame_count - 1) % FLOW_CONTROL_MAX_FRAMES];
+    size_t tail = first->offset;
+    size_t head = (size_t)last->offset + last->length;
+
+    if (last->offset >= first->offset)
+    {
+        if (head + length <= FLOW_CONTROL_QUEUE_SIZE)
+        {
+            return (int)head;
+        }
+        return length <= tail ? 0 : -1;
+    }
+
+    return head + length <= tail ? (int)head : -1;
+}
+
+static void drop_oldest(void)
+{
+    oldest_frame = (oldest_frame + 1) % FLOW_CONTROL_MAX_FRAMES;
+    frame_count--;
+    dropped_since_sent++;
+    dropped_frames++;
+}
+
+bool FlowControl_Writable(void)
+{
+    if (!enabled)
+    {
+        return false;
+    }
+
+    return find_space(sizeof(RemoteX_Push_t)) != -1;
+}
+
+int FlowControl_Push(SOCKET_CMD cmd, int32_t returns, const void *payload, size_t length)
+{
+    size_t frame_length = (size_t)VARIABLE_BLOCK_SIZE(RemoteX_Push, length);
+
+    if (!enabled)
+    {
+        errno = ENOTCONN;
+        return -1;
+    }
+
+    if (length > sizeof(DATA_BLOCK))
+    {
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    int offset;
+    while ((offset = find_space(frame_length)) == -1)
+    {
+        if (policy != FlowControl_Policy_KeepLatest)
+        {
+            dropped_since_sent++;
+            dropped_frames++;
+            errno = EAGAIN;
+            return -1;
+        }
+        drop_oldest();
+    }
+
+    RemoteX_Push_t *push = (RemoteX_Push_t *)(queue + offset);
+    push->header.block_length = (uint16_t)frame_length;
+    push->header.response_length = (uint16_t)frame_length;
+    push->header.cmd = cmd;
+    push->header.respond = false;
+    push->header.contract_version = REMOTEX_CONTRACT_VERSION;
+    push->header.err_no = 0;
+    push->header.returns = returns;
+    push->sequence = next_sequence++;
+    push->dropped = 0;
+    push->length = (int32_t)length;
+    memcpy(push->data_block.data, payload, length);
+
+    QueuedFrame *frame = &frames[(oldest_frame + frame_count) % FLOW_CONTROL_MAX_FRAMES];
+    frame->offset = (uint16_t)offset;
+    frame->length = (uint16_t)frame_length;
+    frame_count++;
+
+    if (credits > 0 && notify_callback != NULL)
+    {
+        notify_callback(notify_context);
+    }
+
+    return 0;
+}
+
+static void PaceTimerHandler(TimerWheelTimer *timer, void *context)
+{
+    if (credits > 0 && frame_count > 0 && notify_callback != NULL)
+    {
+        notify_callback(notify_context);
+    }
+}
+
+void FlowControl_SetPushInterval(uint32_t intervalMs)
+{
+    if (pace_timer.handler == NULL)
+    {
+        TimerWheel_InitTimer(&pace_timer, PaceTimerHandler, NULL);
+    }
+
+    push_interval_ms = intervalMs;
+
+    // Pushing resumes at full rate, so a frame held back by the old interval can go now.
+    if (intervalMs == 0 && TimerWheel_IsActive(&pace_timer))
+    {
+        TimerWheel_Cancel(&pace_timer);
+        PaceTimerHandler(&pace_timer, NULL);
+    }
+}
+
+/// <summary>
+/// Returns true if the push interval allows a frame now, otherwise arms the pace timer to
+/// notify when it does. Without a default wheel frames are not held back.
+/// </summary>
+static bool push_interval_elapsed(void)
+{
+    TimerWheel *wheel = TimerWheel_Default();
+
+    if (push_interval_ms == 0 || wheel == NULL)
+    {
+        return true;
+    }
+
+    uint64_t now = TimerWheel_NowNs();
+    uint64_t next = last_push_ns + (uint64_t)push_interval_ms * 1000000;
+
+    if (now >= next)
+    {
+        return true;
+    }
+
+    if (!TimerWheel_IsActive(&pace_timer))
+    {
+        TimerWheel_StartOneShot(wheel, &pace_timer, (next - now + 999) / 1000);
+    }
+    return false;
+}
+
+size_t FlowControl_Dequeue(uint8_t *dest, size_t destSize)
+{
+    if (credits == 0 || frame_count == 0 || !push_interval_elapsed())
+    {
+        return 0;
+    }
+
+    const QueuedFrame *frame = &frames[oldest_frame];
+    if (frame->length > destSize)
+    {
+        return 0;
+    }
+
+    memcpy(dest, queue + frame->offset, frame->length);
+    size_t length = frame->length;
+
+    // Tell the client how many frames it missed since the previous delivered frame.
+    ((RemoteX_Push_t *)dest)->dropped = dropped_since_sent;
+    dropped_since_sent = 0;
+
+    oldest_frame = (oldest_frame + 1) % FLOW_CONTROL_MAX_FRAMES;
+    frame_count--;
+    credits--;
+    sent_frames++;
+    last_push_ns = TimerWheel_NowNs();
+
+    return length;
+}
+
+DEFINE_CMD(RemoteX_FlowControl, data, nread)
+{
+    if (data->reset)
+    {
+        FlowControl_Reset();
+    }
+
+    if (data->policy <= FlowControl_Policy_KeepLatest)
+    {
+        policy = data->policy;
+    }
+
+    uint64_t granted = (uint64_t)credits + data->grantCredits;
+
+    enabled = true;
+    credits = granted > FLOW_CONTROL_MAX_CREDITS ? FLOW_CONTROL_MAX_CREDITS : (uint32_t)granted;
+
+    data->credits = credits;
+    data->queuedFrames = (uint32_t)frame_count;
+    data->queuedBytes = (uint32_t)queued_bytes();
+    data->sentFrames = sent_frames;
+    data->droppedFrames = dropped_frames;
+    data->header.returns = 0;
+
+    if (credits > 0 && frame_count > 0 && notify_callback != NULL)
+    {
+        notify_callback(notify_context);
+    }
+}
+END_CMD
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "peripherals.h"
+
+// Bounded queue of frames waiting for client credit. Memory use is fixed regardless of how
+// far the client falls behind.
+#define FLOW_CONTROL_QUEUE_SIZE (8 * 1024)
+#define FLOW_CONTROL_MAX_FRAMES 32
+#define FLOW_CONTROL_MAX_CREDITS 0xFFFF
+
+/// <summary>
+/// Discards queued frames and credits and disables pushing until the client
+/// sends <see cref="RemoteX_FlowControl_c" />. Called when a client connects or disconnects.
+/// </summary>
+void FlowControl_Reset(void);
+
+/// <summary>
+/// Register the callback invoked when a frame becomes sendable, either because a frame was
+/// queued while credit was available or because the client granted more credit.
+/// </summary>
+void FlowControl_SetNotify(void (*notify)(void *context), void *context);
+
+/// <summary>
+/// Returns true if a full size frame pushed now would be queued without being refused or
+/// displacing an older frame. Producers should skip work while this returns false.
+/// </summary>
+bool FlowControl_Writable(void);
+
+/// <summary>
+///     <para>Queue an unsolicited frame for the client. Each frame sent consumes one credit.</para>
+///     <param name="cmd">Command that produced the frame, copied to header.cmd.</param>
+///     <param name="returns">Copied to header.returns.</param>
+///     <param name="payload">Frame payload, copied into the queue.</param>
+///     <param name="length">Payload length, at most sizeof(DATA_BLOCK).</param>
+///     <returns>0 if queued, -1 on failure with errno set to ENOTCONN if the client has not
+///     enabled pushing, EAGAIN if the queue is full under the block policy or EMSGSIZE.</returns>
+/// </summary>
+int FlowControl_Push(SOCKET_CMD cmd, int32_t returns, const void *payload, size_t length);
+
+/// <summary>
+/// Send push frames at most once per intervalMs, or without spacing when 0. Frames wait in the
+/// queue meanwhile under the usual policy. Used to lower push rates while load is shed.
+/// </summary>
+void FlowControl_SetPushInterval(uint32_t intervalMs);
+
+/// <summary>
+/// Copy the oldest queued frame into dest and consume one credit.
+/// Returns the frame length, or 0 if nothing may be sent.
+/// </summary>
+size_t FlowControl_Dequeue(uint8_t *dest, size_t destSize);
+
+DECLARE_CMD(RemoteX_FlowControl);
@@ -0,0 +1,190 @@
+#include <string.h>
+
+#include "flow_control.h"
+#include "gpio_waveform.h"
+
+static GPIO_WaveformStep_t steps[WAVEFORM_MAX_STEPS];
+static size_t step_count;
+static uint32_t loops_requested;
+static size_t next_step;
+static uint64_t next_edge_ns;
+static int64_t error_sum_ns;
+static GPIO_WaveformStats_t stats;
+static TimerWheelTimer timer;
+
+static void finish(SEQUENCE_STATE state)
+{
+    TimerWheel_Cancel(&timer);
+    stats.state = state;
+
+    if (stats.stepsExecuted > 0)
+    {
+        stats.meanErrorNs = error_sum_ns / (int64_t)stats.stepsExecuted;
+    }
+
+    FlowControl_Push(GPIO_Waveform_c, (int32_t)state, &stats, sizeof(stats));
+}
+
+static void record_error(int64_t error_ns)
+{
+    if (stats.stepsExecuted == 0 || error_ns < stats.minErrorNs)
+    {
+        stats.minErrorNs = error_ns;
+    }
+    if (stats.stepsExecuted == 0 || error_ns > stats.maxErrorNs)
+    {
+        stats.maxErrorNs = error_ns;
+    }
+    error_sum_ns += error_ns;
+}
+
+/// <summary>
+/// Drive edges until the next one is far enough away to hand control back to the event
+/// loop. Edge times are absolute, so a late edge does not push back the ones after it.
+/// </summary>
+static void run(void)
+{
+    uint64_t burst_start = TimerWheel_NowNs();
+
+    while (stats.state == SequenceState_Running)
+    {
+        uint64_t now = TimerWheel_NowNs();
+
+        if (next_edge_ns > now + WAVEFORM_YIELD_NS)
+        {
+            TimerWheel_StartAt(TimerWheel_Default(), &timer, next_edge_ns - WAVEFORM_SPIN_NS);
+            return;
+        }
+
+        if (now - burst_start > WAVEFORM_MAX_BURST_NS)
+        {
+            stats.yields++;
+            TimerWheel_StartAt(TimerWheel_Default(), &timer, now);
+            return;
+        }
+
+        const GPIO_WaveformStep_t *step = &steps[next_step];
+        GPIO_SetValue_t request = {.gpioFd = step->gpioFd, .value = step->value};
+
+        now = TimerWheel_SpinUntil(next_edge_ns);
+        GPIO_SetValue_cmd((uint8_t *)&request, sizeof(request));
+
+        if (request.header.returns == -1)
+        {
+            stats.setValueErrors++;
+        }
+
+        record_error((int64_t)(now - next_edge_ns));
+        stats.stepsExecuted++;
+        next_edge_ns += (uint64_t)step->delayUs * 1000;
+
+        if (++next_step == step_count)
+        {
+            next_step = 0;
+            stats.loopsCompleted++;
+
+            if (loops_requested != 0 && stats.loopsCompleted == loops_requested)
+            {
+                finish(SequenceState_Completed);
+            }
+        }
+    }
+}
+
+static void HandleEdgeDue(TimerWheelTimer *t, void *context)
+{
+    run();
+}
+
+void GpioWaveform_Cancel(void)
+{
+    if (stats.state == SequenceState_Running)
+    {
+        finish(SequenceState_Cancelled);
+    }
+}
+
+static bool validate_steps(const GPIO_WaveformStep_t *requested, uint32_t count, uint32_t loops)
+{
+    uint64_t total_delay_us = 0;
+
+    if (count == 0 || count > WAVEFORM_MAX_STEPS)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        // Only drive pins this client opened.
+        if (!ledger_contains(requested[i].gpioFd))
+        {
+            return false;
+        }
+        total_delay_us += requested[i].delayUs;
+    }
+
+    // A waveform repeated forever must take some time per pass.
+    return loops != 0 || total_delay_us > 0;
+}
+
+DEFINE_CMD(GPIO_Waveform, data, nread)
+{
+    data->header.returns = -1;
+
+    switch (data->action)
+    {
+    case Sequence_Start:
+        if (stats.state == SequenceState_Running)
+        {
+            errno = EBUSY;
+        }
+        else if (VARIABLE_BLOCK_SIZE(GPIO_Waveform, data->stepCount * sizeof(GPIO_WaveformStep_t)) > nread ||
+                 !validate_steps((const GPIO_WaveformStep_t *)data->data_block.data, data->stepCount, data->loops))
+        {
+            errno = EINVAL;
+        }
+        else
+        {
+            memcpy(steps, data->data_block.data, data->stepCount * sizeof(GPIO_WaveformStep_t));
+            step_count = data->stepCount;
+            loops_requested = data->loops;
+            next_step = 0;
+            error_sum_ns = 0;
+            memset(&stats, 0, sizeof(stats));
+            stats.state = SequenceState_Running;
+            stats.startedNs = TimerWheel_NowNs() + WAVEFORM_START_DELAY_NS;
+            next_edge_ns = stats.startedNs;
+
+            TimerWheel_InitTimer(&timer, HandleEdgeDue, NULL);
+            if (TimerWheel_StartAt(TimerWheel_Default(), &timer, next_edge_ns - WAVEFORM_SPIN_NS) == -1)
+            {
+                stats.state = SequenceState_Failed;
+            }
+            else
+            {
+                data->header.returns = 0;
+            }
+        }
+        break;
+
+    case Sequence_Cancel:
+        GpioWaveform_Cancel();
+        data->header.returns = 0;
+        break;
+
+    case Sequence_Status:
+        data->header.returns = 0;
+        break;
+
+    default:
+        errno = EINVAL;
+        break;
+    }
+
+    data->stats = stats;
+    if (stats.state == SequenceState_Running && stats.stepsExecuted > 0)
+    {
+        data->stats.meanErrorNs = error_sum_ns / (int64_t)stats.stepsExecuted;
+    }
+}
+END_CMD
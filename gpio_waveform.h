@@ -0,0 +1,25 @@
+#pragma once
+
+#include "peripherals.h"
+#include "timer_wheel.h"
+
+#define WAVEFORM_MAX_STEPS (sizeof(DATA_BLOCK) / sizeof(GPIO_WaveformStep_t))
+
+// First edge is driven this long after the start request so its response goes out first.
+#define WAVEFORM_START_DELAY_NS 1000000
+
+// Gaps longer than this go back to the event loop; shorter ones are spun on the clock.
+#define WAVEFORM_YIELD_NS 2000000
+#define WAVEFORM_SPIN_NS 200000
+
+// Longest stretch spent spinning before yielding for a tick, so a waveform of short
+// delays cannot starve the socket. The edge after a forced yield is late by about a
+// tick and is counted in the stats.
+#define WAVEFORM_MAX_BURST_NS 50000000
+
+/// <summary>
+/// Stop the running waveform. Called when the client disconnects.
+/// </summary>
+void GpioWaveform_Cancel(void);
+
+DECLARE_CMD(GPIO_Waveform);
@@ -0,0 +1,70 @@
+/* Host stand-in for the ADC API. Channels are simulated waveforms; see host/sim. A channel with
+   no waveform configured reads 0. */
+
+#include <errno.h>
+
+#include <applibs/adc.h>
+
+#include "descriptor.h"
+#include "simulator.h"
+
+#define HOST_ADC_SAMPLE_BITS 12
+
+int ADC_Open(ADC_ControllerId id)
+{
+    if (id >= SIM_ADC_CONTROLLERS)
+    {
+        errno = ENODEV;
+        return -1;
+    }
+
+    Sim_Load();
+    return HostDescriptor_Open(HostDescriptor_Adc, (int)id, 0);
+}
+
+static bool valid_channel(int fd, ADC_ChannelId channel)
+{
+    if (HostDescriptor_Get(fd, HostDescriptor_Adc) == NULL)
+    {
+        return false;
+    }
+
+    if (channel >= SIM_ADC_CHANNELS)
+    {
+        errno = EINVAL;
+        return false;
+    }
+    return true;
+}
+
+int ADC_GetSampleBitCount(int fd, ADC_ChannelId channel)
+{
+    return valid_channel(fd, channel) ? HOST_ADC_SAMPLE_BITS : -1;
+}
+
+int ADC_SetReferenceVoltage(int fd, ADC_ChannelId channel, float referenceVoltage)
+{
+    if (!valid_channel(fd, channel))
+    {
+        return -1;
+    }
+
+    if (referenceVoltage <= 0.0f)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+int ADC_Poll(int fd, ADC_ChannelId channel, uint32_t *outSampleValue)
+{
+    if (!valid_channel(fd, channel))
+    {
+        return -1;
+    }
+
+    SimDevice *input = Sim_Find(SimBus_Adc, HostDescriptor_Get(fd, HostDescriptor_Adc)->id, (int)channel);
+    *outSampleValue = input != NULL ? Sim_AdcSample(input, (1u << HOST_ADC_SAMPLE_BITS) - 1) : 0;
+    return 0;
+}
@@ -0,0 +1,41 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "descriptor.h"
+
+static HostDescriptor descriptors[HOST_MAX_DESCRIPTORS];
+
+int HostDescriptor_Open(HostDescriptorKind kind, int id, int sub_id)
+{
+    int fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (fd == -1)
+    {
+        return -1;
+    }
+
+    if (fd >= HOST_MAX_DESCRIPTORS)
+    {
+        close(fd);
+        errno = EMFILE;
+        return -1;
+    }
+
+    // A closed descriptor's state is left behind, the next open of the same fd replaces it.
+    memset(&descriptors[fd], 0, sizeof(descriptors[fd]));
+    descriptors[fd].kind = kind;
+    descriptors[fd].id = id;
+    descriptors[fd].sub_id = sub_id;
+    return fd;
+}
+
+HostDescriptor *HostDescriptor_Get(int fd, HostDescriptorKind kind)
+{
+    if (fd < 0 || fd >= HOST_MAX_DESCRIPTORS || descriptors[fd].kind != kind)
+    {
+        errno = EBADF;
+        return NULL;
+    }
+    return &descriptors[fd];
+}
@@ -0,0 +1,41 @@
+/* Descriptors handed out by the host applibs stand-ins. Each is a real fd, an eventfd, so the
+   server can close it, poll it and keep it in its ledger like a device fd. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define HOST_MAX_DESCRIPTORS 1024
+
+typedef enum
+{
+    HostDescriptor_None,
+    HostDescriptor_Gpio,
+    HostDescriptor_I2c,
+    HostDescriptor_Spi,
+    HostDescriptor_Pwm,
+    HostDescriptor_Adc
+} HostDescriptorKind;
+
+typedef struct
+{
+    HostDescriptorKind kind;
+    int id;     // GPIO, interface or controller id
+    int sub_id; // SPI chip select
+    bool output;
+    uint32_t speed_hz;
+    uint32_t timeout_ms;
+    uint32_t address; // I2C default target
+} HostDescriptor;
+
+/// <summary>
+/// Open a descriptor of kind for device id. Returns the fd, or -1 with errno set.
+/// </summary>
+int HostDescriptor_Open(HostDescriptorKind kind, int id, int sub_id);
+
+/// <summary>
+/// The state behind fd, or NULL with errno set to EBADF if fd was not opened as kind.
+/// </summary>
+HostDescriptor *HostDescriptor_Get(int fd, HostDescriptorKind kind);
@@ -0,0 +1,192 @@
+/* Host stand-in for the Azure Sphere applibs event loop, implemented on epoll. */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include <applibs/eventloop.h>
+
+#define MAX_EVENTS_PER_WAIT 32
+
+struct EventRegistration
+{
+    int fd;
+    EventLoopIoCallback *callback;
+    void *context;
+    bool unregistered;
+    EventRegistration *next_free;
+};
+
+struct EventLoop
+{
+    int epollFd;
+    bool stop;
+    bool dispatching;
+    // Registrations removed while dispatching are freed once the batch completes, because
+    // later events in the same batch may still refer to them.
+    EventRegistration *pending_free;
+};
+
+EventLoop *EventLoop_Create(void)
+{
+    EventLoop *el = calloc(1, sizeof(EventLoop));
+    if (el == NULL)
+    {
+        return NULL;
+    }
+
+    el->epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (el->epollFd == -1)
+    {
+        free(el);
+        return NULL;
+    }
+
+    return el;
+}
+
+void EventLoop_Close(EventLoop *el)
+{
+    if (el == NULL)
+    {
+        return;
+    }
+
+    close(el->epollFd);
+    free(el);
+}
+
+static void FreePending(EventLoop *el)
+{
+    while (el->pending_free != NULL)
+    {
+        EventRegistration *reg = el->pending_free;
+        el->pending_free = reg->next_free;
+        free(reg);
+    }
+}
+
+static int64_t NowMs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+EventLoop_Run_Result EventLoop_Run(EventLoop *el, int duration_in_milliseconds, bool process_one_event)
+{
+    struct epoll_event events[MAX_EVENTS_PER_WAIT];
+    int64_t deadline = NowMs() + duration_in_milliseconds;
+
+    el->stop = false;
+
+    for (;;)
+    {
+        int timeout = -1;
+        if (duration_in_milliseconds >= 0)
+        {
+            int64_t remaining = deadline - NowMs();
+            timeout = remaining > 0 ? (int)remaining : 0;
+        }
+
+        int count = epoll_wait(el->epollFd, events, process_one_event ? 1 : MAX_EVENTS_PER_WAIT, timeout);
+        if (count == -1)
+        {
+            return EventLoop_Run_Failed;
+        }
+
+        if (count == 0)
+        {
+            return EventLoop_Run_TimedOut;
+        }
+
+        el->dispatching = true;
+        for (int i = 0; i < count; i++)
+        {
+            EventRegistration *reg = events[i].data.ptr;
+            if (!reg->unregistered)
+            {
+                reg->callback(el, reg->fd, events[i].events & (EventLoop_Input | EventLoop_Output | EventLoop_Error), reg->context);
+            }
+        }
+        el->dispatching = false;
+        FreePending(el);
+
+        if (process_one_event || el->stop)
+        {
+            return EventLoop_Run_Finished;
+        }
+    }
+}
+
+int EventLoop_Stop(EventLoop *el)
+{
+    el->stop = true;
+    return 0;
+}
+
+int EventLoop_GetWaitDescriptor(EventLoop *el)
+{
+    return el->epollFd;
+}
+
+EventRegistration *EventLoop_RegisterIo(EventLoop *el, int fd, EventLoop_IoEvents eventBitmask,
+                                        EventLoopIoCallback *callback, void *context)
+{
+    EventRegistration *reg = calloc(1, sizeof(EventRegistration));
+    if (reg == NULL)
+    {
+        return NULL;
+    }
+
+    reg->fd = fd;
+    reg->callback = callback;
+    reg->context = context;
+
+    struct epoll_event event = {.events = eventBitmask, .data.ptr = reg};
+    if (epoll_ctl(el->epollFd, EPOLL_CTL_ADD, fd, &event) == -1)
+    {
+        free(reg);
+        return NULL;
+    }
+
+    return reg;
+}
+
+int EventLoop_ModifyIoEvents(EventLoop *el, EventRegistration *reg, EventLoop_IoEvents eventBitmask)
+{
+    if (reg == NULL)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    struct epoll_event event = {.events = eventBitmask, .data.ptr = reg};
+    return epoll_ctl(el->epollFd, EPOLL_CTL_MOD, reg->fd, &event);
+}
+
+int EventLoop_UnregisterIo(EventLoop *el, EventRegistration *reg)
+{
+    if (reg == NULL)
+    {
+        return 0;
+    }
+
+    // The fd may already be closed, in which case the kernel has dropped it from the set.
+    epoll_ctl(el->epollFd, EPOLL_CTL_DEL, reg->fd, NULL);
+
+    if (el->dispatching)
+    {
+        reg->unregistered = true;
+        reg->next_free = el->pending_free;
+        el->pending_free = reg;
+    }
+    else
+    {
+        free(reg);
+    }
+
+    return 0;
+}
@@ -0,0 +1,70 @@
+#include <errno.h>
+
+#include <applibs/gpio.h>
+
+#include "descriptor.h"
+
+#define HOST_GPIO_COUNT 256
+
+static GPIO_Value_Type levels[HOST_GPIO_COUNT];
+
+static int open_gpio(GPIO_Id gpioId, bool output)
+{
+    if (gpioId < 0 || gpioId >= HOST_GPIO_COUNT)
+    {
+        errno = ENODEV;
+        return -1;
+    }
+
+    int fd = HostDescriptor_Open(HostDescriptor_Gpio, gpioId, 0);
+    if (fd != -1)
+    {
+        HostDescriptor_Get(fd, HostDescriptor_Gpio)->output = output;
+    }
+    return fd;
+}
+
+int GPIO_OpenAsOutput(GPIO_Id gpioId, GPIO_OutputMode_Type outputMode, GPIO_Value_Type initialValue)
+{
+    int fd = open_gpio(gpioId, true);
+    if (fd != -1)
+    {
+        levels[gpioId] = initialValue != GPIO_Value_Low;
+    }
+    return fd;
+}
+
+int GPIO_OpenAsInput(GPIO_Id gpioId)
+{
+    return open_gpio(gpioId, false);
+}
+
+int GPIO_SetValue(int gpioFd, GPIO_Value_Type value)
+{
+    HostDescriptor *gpio = HostDescriptor_Get(gpioFd, HostDescriptor_Gpio);
+    if (gpio == NULL)
+    {
+        return -1;
+    }
+
+    if (!gpio->output)
+    {
+        errno = EPERM;
+        return -1;
+    }
+
+    levels[gpio->id] = value != GPIO_Value_Low;
+    return 0;
+}
+
+int GPIO_GetValue(int gpioFd, GPIO_Value_Type *outValue)
+{
+    HostDescriptor *gpio = HostDescriptor_Get(gpioFd, HostDescriptor_Gpio);
+    if (gpio == NULL)
+    {
+        return -1;
+    }
+
+    *outValue = levels[gpio->id];
+    return 0;
+}
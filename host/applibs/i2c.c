@@ -0,0 +1,151 @@
+/* Host stand-in for the I2C master API. Targets are simulated devices; see host/sim. A register
+   target has an auto-incrementing register pointer: the first byte of a write sets the pointer,
+   further bytes are stored from it, and reads return bytes from it. */
+
+#include <errno.h>
+
+#include <applibs/i2c.h>
+
+#include "descriptor.h"
+#include "simulator.h"
+
+int I2CMaster_Open(I2C_InterfaceId id)
+{
+    if (id < 0 || id >= SIM_I2C_INTERFACES)
+    {
+        errno = ENODEV;
+        return -1;
+    }
+
+    Sim_Load();
+
+    int fd = HostDescriptor_Open(HostDescriptor_I2c, id, 0);
+    if (fd != -1)
+    {
+        HostDescriptor *i2c = HostDescriptor_Get(fd, HostDescriptor_I2c);
+        i2c->speed_hz = I2C_BUS_SPEED_STANDARD;
+        i2c->timeout_ms = 10000;
+    }
+    return fd;
+}
+
+int I2CMaster_SetBusSpeed(int fd, uint32_t speedInHz)
+{
+    HostDescriptor *i2c = HostDescriptor_Get(fd, HostDescriptor_I2c);
+    if (i2c == NULL)
+    {
+        return -1;
+    }
+
+    if (speedInHz == 0 || speedInHz > I2C_BUS_SPEED_FAST_PLUS)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    i2c->speed_hz = speedInHz;
+    return 0;
+}
+
+int I2CMaster_SetTimeout(int fd, uint32_t timeoutInMs)
+{
+    HostDescriptor *i2c = HostDescriptor_Get(fd, HostDescriptor_I2c);
+    if (i2c == NULL)
+    {
+        return -1;
+    }
+
+    i2c->timeout_ms = timeoutInMs;
+    return 0;
+}
+
+int I2CMaster_SetDefaultTargetAddress(int fd, I2C_DeviceAddress address)
+{
+    HostDescriptor *i2c = HostDescriptor_Get(fd, HostDescriptor_I2c);
+    if (i2c == NULL)
+    {
+        return -1;
+    }
+
+    i2c->address = address;
+    return 0;
+}
+
+/// <summary>
+/// Run a transaction's bus timing and faults. Returns the addressed device, or NULL with errno
+/// set if the transaction fails.
+/// </summary>
+static SimDevice *begin_transfer(int fd, I2C_DeviceAddress address, size_t segments, size_t bytes)
+{
+    HostDescriptor *i2c = HostDescriptor_Get(fd, HostDescriptor_I2c);
+    if (i2c == NULL)
+    {
+        return NULL;
+    }
+
+    SimDevice *target = address < SIM_I2C_ADDRESSES ? Sim_Find(SimBus_I2c, i2c->id, (int)address) : NULL;
+    if (Sim_I2cTransfer(target, i2c->speed_hz, i2c->timeout_ms, segments, bytes) == -1)
+    {
+        return NULL;
+    }
+    return target;
+}
+
+static void write_registers(SimDevice *target, const uint8_t *buffer, size_t length)
+{
+    if (length > 0)
+    {
+        target->pointer = buffer[0];
+    }
+
+    for (size_t i = 1; i < length; i++)
+    {
+        Sim_WriteRegister(target, target->pointer++, buffer[i]);
+    }
+}
+
+static void read_registers(SimDevice *target, uint8_t *buffer, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        buffer[i] = Sim_ReadRegister(target, target->pointer++);
+    }
+}
+
+ssize_t I2CMaster_Write(int fd, I2C_DeviceAddress address, const uint8_t *buffer, size_t length)
+{
+    SimDevice *target = begin_transfer(fd, address, 1, length);
+    if (target == NULL)
+    {
+        return -1;
+    }
+
+    write_registers(target, buffer, length);
+    return (ssize_t)length;
+}
+
+ssize_t I2CMaster_WriteThenRead(int fd, I2C_DeviceAddress address, const uint8_t *writeData, size_t lenWriteData,
+                                uint8_t *readData, size_t lenReadData)
+{
+    SimDevice *target = begin_transfer(fd, address, 2, lenWriteData + lenReadData);
+    if (target == NULL)
+    {
+        return -1;
+    }
+
+    write_registers(target, writeData, lenWriteData);
+    read_registers(target, readData, lenReadData);
+    return (ssize_t)(lenWriteData + lenReadData);
+}
+
+ssize_t I2CMaster_Read(int fd, I2C_DeviceAddress address, uint8_t *buffer, size_t maxLength)
+{
+    SimDevice *target = begin_transfer(fd, address, 1, maxLength);
+    if (target == NULL)
+    {
+        return -1;
+    }
+
+    read_registers(target, buffer, maxLength);
+    return (ssize_t)maxLength;
+}
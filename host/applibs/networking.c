@@ -0,0 +1,17 @@
+#include <string.h>
+
+#include <applibs/networking.h>
+
+void Networking_IpConfig_Init(Networking_IpConfig *ipConfig)
+{
+    memset(ipConfig, 0, sizeof(*ipConfig));
+}
+
+void Networking_IpConfig_EnableDynamicIp(Networking_IpConfig *ipConfig) {}
+
+int Networking_IpConfig_Apply(const char *networkInterfaceName, const Networking_IpConfig *ipConfig)
+{
+    return 0;
+}
+
+void Networking_IpConfig_Destroy(Networking_IpConfig *ipConfig) {}
@@ -0,0 +1,13 @@
+#include <errno.h>
+
+#include <applibs/powermanagement.h>
+
+int PowerManagement_SetSystemPowerProfile(PowerManagement_System_PowerProfile desiredProfile)
+{
+    if (desiredProfile > PowerManagement_HighPerformance)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
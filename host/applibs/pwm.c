@@ -0,0 +1,34 @@
+#include <errno.h>
+
+#include <applibs/pwm.h>
+
+#include "descriptor.h"
+
+#define HOST_PWM_CONTROLLERS 4
+#define HOST_PWM_CHANNELS 4
+
+int PWM_Open(PWM_ControllerId pwm)
+{
+    if (pwm >= HOST_PWM_CONTROLLERS)
+    {
+        errno = ENODEV;
+        return -1;
+    }
+    return HostDescriptor_Open(HostDescriptor_Pwm, (int)pwm, 0);
+}
+
+int PWM_Apply(int pwmFd, PWM_ChannelId pwmChannel, const PwmState *newState)
+{
+    if (HostDescriptor_Get(pwmFd, HostDescriptor_Pwm) == NULL)
+    {
+        return -1;
+    }
+
+    if (pwmChannel >= HOST_PWM_CHANNELS || newState->dutyCycle_nsec > newState->period_nsec ||
+        newState->polarity > PWM_Polarity_Inversed)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,228 @@
+/* Host stand-in for the SPI master API. Chip selects lead to simulated devices; see host/sim.
+   The first byte clocked out while chip select is asserted is a register address, with bit 7
+   set for a read; the bytes after it are written to, or read from, consecutive registers. Chip
+   select is asserted for the length of one WriteThenRead or TransferSequential call. An empty
+   chip select reads 0xFF. */
+
+#include <errno.h>
+#include <string.h>
+
+#include <applibs/spi.h>
+
+#include "descriptor.h"
+#include "simulator.h"
+
+#define HOST_SPI_MAX_SPEED_HZ 40000000
+
+#define SPI_CONFIG_MAGIC 0x2C6D0000
+#define SPI_TRANSFER_MAGIC 0x7F2D0000
+
+typedef struct
+{
+    SimDevice *target;
+    bool addressed;
+    bool reading;
+    uint8_t pointer;
+} Transaction;
+
+int SPIMaster_InitConfig(SPIMaster_Config *config)
+{
+    config->z__magicAndVersion = SPI_CONFIG_MAGIC | 1;
+    config->csPolarity = SPI_ChipSelectPolarity_ActiveLow;
+    return 0;
+}
+
+int SPIMaster_InitTransfers(SPIMaster_Transfer *transfers, size_t transferCount)
+{
+    for (size_t i = 0; i < transferCount; i++)
+    {
+        memset(&transfers[i], 0, sizeof(transfers[i]));
+        transfers[i].z__magicAndVersion = SPI_TRANSFER_MAGIC | 1;
+    }
+    return 0;
+}
+
+int SPIMaster_Open(SPI_InterfaceId interfaceId, SPI_ChipSelectId chipSelectId, const SPIMaster_Config *config)
+{
+    if (interfaceId < 0 || interfaceId >= SIM_SPI_INTERFACES || chipSelectId < 0 || chipSelectId >= SIM_SPI_CHIP_SELECTS)
+    {
+        errno = ENODEV;
+        return -1;
+    }
+
+    if (config == NULL || config->csPolarity == SPI_ChipSelectPolarity_Invalid)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    Sim_Load();
+
+    int fd = HostDescriptor_Open(HostDescriptor_Spi, interfaceId, chipSelectId);
+    if (fd != -1)
+    {
+        HostDescriptor_Get(fd, HostDescriptor_Spi)->speed_hz = 1000000;
+    }
+    return fd;
+}
+
+int SPIMaster_SetBusSpeed(int fd, uint32_t speedInHz)
+{
+    HostDescriptor *spi = HostDescriptor_Get(fd, HostDescriptor_Spi);
+    if (spi == NULL)
+    {
+        return -1;
+    }
+
+    if (speedInHz == 0 || speedInHz > HOST_SPI_MAX_SPEED_HZ)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    spi->speed_hz = speedInHz;
+    return 0;
+}
+
+int SPIMaster_SetMode(int fd, SPI_Mode mode)
+{
+    if (HostDescriptor_Get(fd, HostDescriptor_Spi) == NULL)
+    {
+        return -1;
+    }
+
+    if (mode < SPI_Mode_0 || mode > SPI_Mode_3)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+int SPIMaster_SetBitOrder(int fd, SPI_BitOrder order)
+{
+    if (HostDescriptor_Get(fd, HostDescriptor_Spi) == NULL)
+    {
+        return -1;
+    }
+
+    if (order != SPI_BitOrder_LsbFirst && order != SPI_BitOrder_MsbFirst)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+/// <summary>
+/// Assert chip select for a transaction of bytes bytes, running its bus timing and faults.
+/// </summary>
+static bool begin_transaction(int fd, size_t bytes, Transaction *transaction)
+{
+    HostDescriptor *spi = HostDescriptor_Get(fd, HostDescriptor_Spi);
+    if (spi == NULL)
+    {
+        return false;
+    }
+
+    memset(transaction, 0, sizeof(*transaction));
+    transaction->target = Sim_Find(SimBus_Spi, spi->id, spi->sub_id);
+    return Sim_SpiTransfer(transaction->target, spi->speed_hz, bytes) == 0;
+}
+
+/// <summary>
+/// Clock one byte out to the target and return the byte clocked in.
+/// </summary>
+static uint8_t clock_byte(Transaction *transaction, uint8_t out)
+{
+    SimDevice *target = transaction->target;
+    uint8_t in = 0;
+
+    if (target == NULL)
+    {
+        return 0xFF;
+    }
+
+    if (!transaction->addressed)
+    {
+        transaction->addressed = true;
+        transaction->reading = (out & 0x80) != 0;
+        transaction->pointer = (uint8_t)((out & 0x7F) + target->model->spi_register_base);
+    }
+    else if (transaction->reading)
+    {
+        in = Sim_ReadRegister(target, transaction->pointer++);
+    }
+    else
+    {
+        Sim_WriteRegister(target, transaction->pointer++, out);
+    }
+
+    return in;
+}
+
+ssize_t SPIMaster_TransferSequential(int fd, const SPIMaster_Transfer *transfers, size_t transferCount)
+{
+    Transaction transaction;
+    size_t total = 0;
+
+    if (transferCount == 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (size_t i = 0; i < transferCount; i++)
+    {
+        if ((transfers[i].flags & (SPI_TransferFlags_Read | SPI_TransferFlags_Write)) == 0 || transfers[i].length == 0)
+        {
+            errno = EINVAL;
+            return -1;
+        }
+        total += transfers[i].length;
+    }
+
+    if (!begin_transaction(fd, total, &transaction))
+    {
+        return -1;
+    }
+
+    for (size_t i = 0; i < transferCount; i++)
+    {
+        const SPIMaster_Transfer *transfer = &transfers[i];
+
+        for (size_t b = 0; b < transfer->length; b++)
+        {
+            uint8_t in = clock_byte(&transaction, transfer->flags & SPI_TransferFlags_Write ? transfer->writeData[b] : 0);
+            if (transfer->flags & SPI_TransferFlags_Read)
+            {
+                transfer->readData[b] = in;
+            }
+        }
+    }
+
+    return (ssize_t)total;
+}
+
+ssize_t SPIMaster_WriteThenRead(int fd, const uint8_t *writeData, size_t lenWriteData, uint8_t *readData,
+                                size_t lenReadData)
+{
+    Transaction transaction;
+
+    if (!begin_transaction(fd, lenWriteData + lenReadData, &transaction))
+    {
+        return -1;
+    }
+
+    for (size_t b = 0; b < lenWriteData; b++)
+    {
+        clock_byte(&transaction, writeData[b]);
+    }
+
+    for (size_t b = 0; b < lenReadData; b++)
+    {
+        readData[b] = clock_byte(&transaction, 0);
+    }
+
+    return (ssize_t)(lenWriteData + lenReadData);
+}
@@ -0,0 +1,21 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <applibs/storage.h>
+
+static const char *storage_path(void)
+{
+    const char *path = getenv("REMOTEX_HOST_STORAGE");
+    return path != NULL ? path : "mutable_storage.bin";
+}
+
+int Storage_OpenMutableFile(void)
+{
+    return open(storage_path(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+}
+
+int Storage_DeleteMutableFile(void)
+{
+    return unlink(storage_path());
+}
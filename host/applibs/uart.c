@@ -0,0 +1,153 @@
+/* Host stand-in for the UART API. A UART is one end of a socket pair. A thread on the other end
+   loops every character back after the time it would take on the wire at the configured baud
+   rate, plus the latency_us of a simulated "uart" line, and drops characters at its error_rate. */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <applibs/uart.h>
+
+#include "simulator.h"
+
+#define UART_CONFIG_MAGIC 0xD2B60000
+
+// Characters are looped back in groups of at most this many.
+#define UART_CHUNK 16
+
+typedef struct
+{
+    int fd;
+    uint64_t character_ns;
+    uint64_t latency_ns;
+    double error_rate;
+    unsigned seed;
+} UartLine;
+
+void UART_InitConfig(UART_Config *uartConfig)
+{
+    memset(uartConfig, 0, sizeof(*uartConfig));
+    uartConfig->z__magicAndVersion = UART_CONFIG_MAGIC | 1;
+    uartConfig->baudRate = 115200;
+    uartConfig->dataBits = UART_DataBits_Eight;
+    uartConfig->parity = UART_Parity_None;
+    uartConfig->stopBits = UART_StopBits_One;
+    uartConfig->flowControl = UART_FlowControl_None;
+}
+
+static void sleep_until(uint64_t ns)
+{
+    struct timespec until = {.tv_sec = (time_t)(ns / 1000000000), .tv_nsec = (long)(ns % 1000000000)};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) == EINTR)
+    {
+    }
+}
+
+/// <summary>
+/// Loop characters back until the application closes its end.
+/// </summary>
+static void *RunLine(void *context)
+{
+    UartLine *line = context;
+    uint8_t chunk[UART_CHUNK];
+    uint64_t line_free_ns = 0;
+    ssize_t count;
+
+    while ((count = read(line->fd, chunk, sizeof(chunk))) > 0)
+    {
+        uint64_t now = Sim_NowNs();
+        size_t kept = 0;
+
+        // Characters queue behind any still on the wire.
+        line_free_ns = (line_free_ns > now ? line_free_ns : now) + (uint64_t)count * line->character_ns;
+        sleep_until(line_free_ns + line->latency_ns);
+
+        for (ssize_t i = 0; i < count; i++)
+        {
+            if (line->error_rate <= 0 || (double)rand_r(&line->seed) / RAND_MAX >= line->error_rate)
+            {
+                chunk[kept++] = chunk[i];
+            }
+        }
+
+        if (kept > 0 && write(line->fd, chunk, kept) == -1)
+        {
+            break;
+        }
+    }
+
+    close(line->fd);
+    free(line);
+    return NULL;
+}
+
+int UART_Open(UART_Id uartId, const UART_Config *uartConfig)
+{
+    int ends[2];
+    pthread_t thread;
+    pthread_attr_t attributes;
+
+    if (uartId < 0 || uartId >= SIM_UARTS)
+    {
+        errno = ENODEV;
+        return -1;
+    }
+
+    if (uartConfig->baudRate == 0 || uartConfig->dataBits < UART_DataBits_Five ||
+        uartConfig->dataBits > UART_DataBits_Eight || uartConfig->parity > UART_Parity_Odd ||
+        uartConfig->stopBits < UART_StopBits_One || uartConfig->stopBits > UART_StopBits_Two)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    Sim_Load();
+
+    UartLine *line = calloc(1, sizeof(*line));
+    if (line == NULL)
+    {
+        return -1;
+    }
+
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, ends) == -1)
+    {
+        free(line);
+        return -1;
+    }
+
+    // Only the application's end follows the blocking mode; the line thread always blocks.
+    if (uartConfig->blockingMode == UART_BlockingMode_NonBlocking)
+    {
+        fcntl(ends[0], F_SETFL, fcntl(ends[0], F_GETFL) | O_NONBLOCK);
+    }
+
+    SimDevice *device = Sim_Find(SimBus_Uart, uartId, 0);
+    unsigned bits = 1u + uartConfig->dataBits + (uartConfig->parity != UART_Parity_None) + uartConfig->stopBits;
+
+    line->fd = ends[1];
+    line->character_ns = Sim_UartCharacterNs(uartConfig->baudRate, bits);
+    line->latency_ns = device != NULL ? (uint64_t)device->latency_us * 1000 : 0;
+    line->error_rate = device != NULL ? device->error_rate : 0;
+    line->seed = (unsigned)uartId + 1;
+
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+    int result = pthread_create(&thread, &attributes, RunLine, line);
+    pthread_attr_destroy(&attributes);
+
+    if (result != 0)
+    {
+        close(ends[0]);
+        close(ends[1]);
+        free(line);
+        errno = result;
+        return -1;
+    }
+
+    return ends[0];
+}
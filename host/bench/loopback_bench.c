@@ -0,0 +1,641 @@
+/* End-to-end benchmark: a load generator speaking the RemoteX contract to the host-built server
+   over loopback TCP.
+
+   Every combination of command, payload size, pipeline depth and client count runs for a fixed
+   time. Each case reports throughput and latency percentiles, printed as a table and written as
+   JSON for comparing runs. The server serves one client at a time, so extra clients are counted
+   as rejected rather than measured.
+
+       loopback_bench --spawn ./remotex_server --out results.json */
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "contract.h"
+
+#define CORE_SIZE(type) (sizeof(type) - sizeof(DATA_BLOCK))
+#define MAX_FRAME sizeof(RemoteX_Write_t)
+#define MAX_LIST 16
+#define MAX_PIPELINE 256
+#define NELEMS(x) (sizeof(x) / sizeof((x)[0]))
+
+typedef struct
+{
+    int fd;
+    int gpio_out[8];
+    int i2c;
+    int spi;
+    int adc;
+} Connection;
+
+typedef struct
+{
+    const char *name;
+    bool has_payload;
+    // Build the request into frame; returns its length and sets the expected response length.
+    size_t (*build)(const Connection *connection, uint8_t *frame, size_t payload, size_t *response_length);
+} Workload;
+
+typedef struct
+{
+    const Workload *workload;
+    size_t payload;
+    int pipeline;
+    pthread_barrier_t *start;
+
+    bool rejected;
+    uint64_t ops;
+    uint64_t errors;
+    uint64_t *latencies;
+    size_t latency_count;
+    size_t latency_capacity;
+} ClientRun;
+
+static const char *server_host = "127.0.0.1";
+static int server_port = 8888;
+static double case_seconds = 0.5;
+
+static uint64_t NowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+static void InitHeader(CTX_HEADER *header, SOCKET_CMD cmd, size_t block_length, size_t response_length)
+{
+    memset(header, 0, sizeof(*header));
+    header->block_length = (uint16_t)block_length;
+    header->response_length = (uint16_t)response_length;
+    header->cmd = cmd;
+    header->respond = true;
+    header->contract_version = REMOTEX_CONTRACT_VERSION;
+}
+
+static bool SendAll(int fd, const uint8_t *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t sent = send(fd, data, length, 0);
+        if (sent <= 0)
+        {
+            return false;
+        }
+        data += sent;
+        length -= (size_t)sent;
+    }
+    return true;
+}
+
+static bool ReceiveAll(int fd, uint8_t *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t received = recv(fd, data, length, 0);
+        if (received <= 0)
+        {
+            return false;
+        }
+        data += received;
+        length -= (size_t)received;
+    }
+    return true;
+}
+
+/// <summary>
+/// Send one request and wait for its response, which replaces the request in frame. Returns
+/// the command's return value, or -1 if the connection failed.
+/// </summary>
+static int Call(int fd, uint8_t *frame)
+{
+    CTX_HEADER *header = (CTX_HEADER *)frame;
+
+    if (!SendAll(fd, frame, header->block_length) || !ReceiveAll(fd, frame, header->response_length))
+    {
+        return -1;
+    }
+    return header->returns;
+}
+
+static int Connect(void)
+{
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons((uint16_t)server_port)};
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int on = 1;
+
+    inet_pton(AF_INET, server_host, &address.sin_addr);
+    if (fd == -1 || connect(fd, (struct sockaddr *)&address, sizeof(address)) == -1)
+    {
+        if (fd != -1)
+        {
+            close(fd);
+        }
+        return -1;
+    }
+
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    return fd;
+}
+
+/// <summary>
+/// Open the peripherals the workloads use. Returns false if the server closed the connection,
+/// which it does to a second client.
+/// </summary>
+static bool Setup(Connection *connection, int index)
+{
+    static __thread uint8_t frame[MAX_FRAME];
+
+    for (size_t i = 0; i < NELEMS(connection->gpio_out); i++)
+    {
+        GPIO_OpenAsOutput_t *open = (GPIO_OpenAsOutput_t *)frame;
+        InitHeader(&open->header, GPIO_OpenAsOutput_c, sizeof(*open), sizeof(*open));
+        open->gpioId = 16 + index * (int)NELEMS(connection->gpio_out) + (int)i;
+        if ((connection->gpio_out[i] = Call(connection->fd, frame)) == -1)
+        {
+            return false;
+        }
+    }
+
+    I2CMaster_Open_t *i2c_open = (I2CMaster_Open_t *)frame;
+    InitHeader(&i2c_open->header, I2CMaster_Open_c, sizeof(*i2c_open), sizeof(*i2c_open));
+    i2c_open->I2C_InterfaceId = 0;
+    if ((connection->i2c = Call(connection->fd, frame)) == -1)
+    {
+        return false;
+    }
+
+    I2CMaster_SetBusSpeed_t *i2c_speed = (I2CMaster_SetBusSpeed_t *)frame;
+    InitHeader(&i2c_speed->header, I2CMaster_SetBusSpeed_c, sizeof(*i2c_speed), sizeof(*i2c_speed));
+    i2c_speed->fd = connection->i2c;
+    i2c_speed->speedInHz = 1000000;
+    Call(connection->fd, frame);
+
+    // The server fills in an SPIMaster_Config for the open.
+    SPIMaster_InitConfig_t *spi_config = (SPIMaster_InitConfig_t *)frame;
+    InitHeader(&spi_config->header, SPIMaster_InitConfig_c, CORE_SIZE(SPIMaster_InitConfig_t) + 64,
+               CORE_SIZE(SPIMaster_InitConfig_t) + 64);
+    if (Call(connection->fd, frame) == -1)
+    {
+        return false;
+    }
+
+    uint8_t config[64];
+    memcpy(config, spi_config->data_block.data, sizeof(config));
+
+    SPIMaster_Open_t *spi_open = (SPIMaster_Open_t *)frame;
+    InitHeader(&spi_open->header, SPIMaster_Open_c, CORE_SIZE(SPIMaster_Open_t) + sizeof(config),
+               CORE_SIZE(SPIMaster_Open_t));
+    spi_open->interfaceId = 0;
+    spi_open->chipSelectId = 0;
+    memcpy(spi_open->data_block.data, config, sizeof(config));
+    if ((connection->spi = Call(connection->fd, frame)) == -1)
+    {
+        return false;
+    }
+
+    SPIMaster_SetBusSpeed_t *spi_speed = (SPIMaster_SetBusSpeed_t *)frame;
+    InitHeader(&spi_speed->header, SPIMaster_SetBusSpeed_c, sizeof(*spi_speed), sizeof(*spi_speed));
+    spi_speed->fd = connection->spi;
+    spi_speed->speedInHz = 20000000;
+    Call(connection->fd, frame);
+
+    ADC_Open_t *adc_open = (ADC_Open_t *)frame;
+    InitHeader(&adc_open->header, ADC_Open_c, sizeof(*adc_open), sizeof(*adc_open));
+    adc_open->id = 0;
+    return (connection->adc = Call(connection->fd, frame)) != -1;
+}
+
+static size_t BuildPlatformInformation(const Connection *connection, uint8_t *frame, size_t payload, size_t *response_length)
+{
+    RemoteX_PlatformInformation_t *request = (RemoteX_PlatformInformation_t *)frame;
+    InitHeader(&request->header, RemoteX_PlatformInformation_c, CORE_SIZE(RemoteX_PlatformInformation_t),
+               CORE_SIZE(RemoteX_PlatformInformation_t) + 128);
+    request->length = 128;
+    *response_length = request->header.response_length;
+    return request->header.block_length;
+}
+
+static size_t BuildGpioSetValue(const Connection *connection, uint8_t *frame, size_t payload, size_t *response_length)
+{
+    GPIO_SetValue_t *request = (GPIO_SetValue_t *)frame;
+    InitHeader(&request->header, GPIO_SetValue_c, sizeof(*request), sizeof(*request));
+    request->gpioFd = connection->gpio_out[0];
+    request->value = 1;
+    *response_length = sizeof(*request);
+    return sizeof(*request);
+}
+
+static size_t BuildGpioGetValue(const Connection *connection, uint8_t *frame, size_t payload, size_t *response_length)
+{
+    GPIO_GetValue_t *request = (GPIO_GetValue_t *)frame;
+    InitHeader(&request->header, GPIO_GetValue_c, sizeof(*request), sizeof(*request));
+    request->gpioFd = connection->gpio_out[0];
+    *response_length = sizeof(*request);
+    return sizeof(*request);
+}
+
+static size_t BuildGpioSetValues(const Connection *connection, uint8_t *frame, size_t payload, size_t *response_length)
+{
+    GPIO_SetValues_t *request = (GPIO_SetValues_t *)frame;
+    InitHeader(&request->header, GPIO_SetValues_c, sizeof(*request), sizeof(*request));
+    request->count = NELEMS(connection->gpio_out);
+    for (size_t i = 0; i < NELEMS(connection->gpio_out); i++)
+    {
+        request->gpioFds[i] = connection->gpio_out[i];
+    }
+    request->values = 0xA5;
+    *response_length = sizeof(*request);
+    return sizeof(*request);
+}
+
+static size_t BuildAdcPoll(const Connection *connection, uint8_t *frame, size_t payload, size_t *response_length)
+{
+    ADC_Poll_t *request = (ADC_Poll_t *)frame;
+    InitHeader(&request->header, ADC_Poll_c, sizeof(*request), sizeof(*request));
+    request->fd = connection->adc;
+    request->channel = 0;
+    *response_length = sizeof(*request);
+    return sizeof(*request);
+}
+
+static size_t BuildI2cWrite(const Connection *connection, uint8_t *frame, size_t payload, size_t *response_length)
+{
+    I2CMaster_Write_t *request = (I2CMaster_Write_t *)frame;
+    InitHeader(&request->header, I2CMaster_Write_c, CORE_SIZE(I2CMaster_Write_t) + payload, CORE_SIZE(I2CMaster_Write_t));
+    request->fd = connection->i2c;
+    request->address = 0x76;
+    request->length = (int32_t)payload;
+    memset(request->data_block.data, 0x5A, payload);
+    *response_length = request->header.response_length;
+    return request->header.block_length;
+}
+
+static size_t BuildI2cWriteThenRead(const Connection *connection, uint8_t *frame, size_t payload, size_t *response_length)
+{
+    I2CMaster_WriteThenRead_t *request = (I2CMaster_WriteThenRead_t *)frame;
+    InitHeader(&request->header, I2CMaster_WriteThenRead_c, CORE_SIZE(I2CMaster_WriteThenRead_t) + 1,
+               CORE_SIZE(I2CMaster_WriteThenRead_t) + payload);
+    request->fd = connection->i2c;
+    request->address = 0x76;
+    request->lenWriteData = 1;
+    request->lenReadData = (uint32_t)payload;
+    request->data_block.data[0] = 0;
+    *response_length = request->header.response_length;
+    return request->header.block_length;
+}
+
+static size_t BuildSpiWriteThenRead(const Connection *connection, uint8_t *frame, size_t payload, size_t *response_length)
+{
+    SPIMaster_WriteThenRead_t *request = (SPIMaster_WriteThenRead_t *)frame;
+    InitHeader(&request->header, SPIMaster_WriteThenRead_c, CORE_SIZE(SPIMaster_WriteThenRead_t) + 1,
+               CORE_SIZE(SPIMaster_WriteThenRead_t) + payload);
+    request->fd = connection->spi;
+    request->lenWriteData = 1;
+    request->lenReadData = (uint32_t)payload;
+    request->data_block.data[0] = 0x80;
+    *response_length = request->header.response_length;
+    return request->header.block_length;
+}
+
+// Commands that run against the default simulated devices without lasting side effects.
+static const Workload workloads[] = {
+    {"RemoteX_PlatformInformation", false, BuildPlatformInformation},
+    {"GPIO_SetValue", false, BuildGpioSetValue},
+    {"GPIO_GetValue", false, BuildGpioGetValue},
+    {"GPIO_SetValues", false, BuildGpioSetValues},
+    {"ADC_Poll", false, BuildAdcPoll},
+    {"I2CMaster_Write", true, BuildI2cWrite},
+    {"I2CMaster_WriteThenRead", true, BuildI2cWriteThenRead},
+    {"SPIMaster_WriteThenRead", true, BuildSpiWriteThenRead},
+};
+
+static void RecordLatency(ClientRun *run, uint64_t ns)
+{
+    if (run->latency_count == run->latency_capacity)
+    {
+        run->latency_capacity = run->latency_capacity ? run->latency_capacity * 2 : 4096;
+        run->latencies = realloc(run->latencies, run->latency_capacity * sizeof(*run->latencies));
+    }
+    run->latencies[run->latency_count++] = ns;
+}
+
+/// <summary>
+/// One client: connect, open its peripherals, then keep pipeline requests in flight until the
+/// case's time is up.
+/// </summary>
+static void *RunClient(void *context)
+{
+    ClientRun *run = context;
+    Connection connection = {.fd = Connect()};
+    uint8_t request[MAX_FRAME], response[MAX_FRAME];
+    uint64_t sent_at[MAX_PIPELINE];
+    size_t request_length, response_length, head = 0, tail = 0;
+
+    run->rejected = connection.fd == -1 || !Setup(&connection, 0);
+    pthread_barrier_wait(run->start);
+
+    if (run->rejected)
+    {
+        if (connection.fd != -1)
+        {
+            close(connection.fd);
+        }
+        return NULL;
+    }
+
+    request_length = run->workload->build(&connection, request, run->payload, &response_length);
+
+    uint64_t deadline = NowNs() + (uint64_t)(case_seconds * 1e9);
+    for (;;)
+    {
+        while (head - tail < (size_t)run->pipeline && NowNs() < deadline)
+        {
+            sent_at[head++ % MAX_PIPELINE] = NowNs();
+            if (!SendAll(connection.fd, request, request_length))
+            {
+                run->errors++;
+                goto done;
+            }
+        }
+
+        if (head == tail)
+        {
+            break;
+        }
+
+        if (!ReceiveAll(connection.fd, response, response_length))
+        {
+            run->errors++;
+            break;
+        }
+
+        RecordLatency(run, NowNs() - sent_at[tail++ % MAX_PIPELINE]);
+        run->ops++;
+        run->errors += ((CTX_HEADER *)response)->returns == -1;
+    }
+
+done:
+    close(connection.fd);
+    return NULL;
+}
+
+static int CompareU64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static double PercentileUs(const uint64_t *sorted, size_t count, double quantile)
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    size_t index = (size_t)(quantile * (double)count);
+    return (double)sorted[index < count ? index : count - 1] / 1000.0;
+}
+
+/// <summary>
+/// Wait for the server to drop the previous case's client, so the next case is not rejected.
+/// </summary>
+static bool WaitForServer(double seconds)
+{
+    uint64_t deadline = NowNs() + (uint64_t)(seconds * 1e9);
+
+    while (NowNs() < deadline)
+    {
+        int fd = Connect();
+        if (fd != -1)
+        {
+            uint8_t frame[MAX_FRAME];
+            size_t response_length;
+            BuildPlatformInformation(NULL, frame, 0, &response_length);
+            bool served = Call(fd, frame) != -1;
+            close(fd);
+            if (served)
+            {
+                return true;
+            }
+        }
+        usleep(20000);
+    }
+    return false;
+}
+
+static void RunCase(FILE *json, bool *first, const Workload *workload, size_t payload, int pipeline, int clients)
+{
+    ClientRun runs[MAX_LIST] = {0};
+    pthread_t threads[MAX_LIST];
+    pthread_barrier_t start;
+    uint64_t ops = 0, errors = 0;
+    size_t latency_count = 0, rejected = 0;
+
+    WaitForServer(5);
+    pthread_barrier_init(&start, NULL, (unsigned)clients);
+
+    for (int i = 0; i < clients; i++)
+    {
+        runs[i] = (ClientRun){.workload = workload, .payload = payload, .pipeline = pipeline, .start = &start};
+        pthread_create(&threads[i], NULL, RunClient, &runs[i]);
+    }
+
+    for (int i = 0; i < clients; i++)
+    {
+        pthread_join(threads[i], NULL);
+        ops += runs[i].ops;
+        errors += runs[i].errors;
+        rejected += runs[i].rejected;
+        latency_count += runs[i].latency_count;
+    }
+    pthread_barrier_destroy(&start);
+
+    uint64_t *latencies = malloc((latency_count ? latency_count : 1) * sizeof(*latencies));
+    size_t filled = 0;
+    for (int i = 0; i < clients; i++)
+    {
+        memcpy(latencies + filled, runs[i].latencies, runs[i].latency_count * sizeof(*latencies));
+        filled += runs[i].latency_count;
+        free(runs[i].latencies);
+    }
+    qsort(latencies, latency_count, sizeof(*latencies), CompareU64);
+
+    double rate = (double)ops / case_seconds;
+    double p50 = PercentileUs(latencies, latency_count, 0.5);
+    double p99 = PercentileUs(latencies, latency_count, 0.99);
+    double p999 = PercentileUs(latencies, latency_count, 0.999);
+
+    printf("%-28s %6zu %4d %3d %10.0f %9.1f %9.1f %9.1f %6llu %4zu\n", workload->name, payload, pipeline, clients, rate,
+           p50, p99, p999, (unsigned long long)errors, rejected);
+    fflush(stdout);
+
+    if (json != NULL)
+    {
+        fprintf(json,
+                "%s\n    {\"command\": \"%s\", \"payload\": %zu, \"pipeline\": %d, \"clients\": %d, \"ops\": %llu, "
+                "\"ops_per_sec\": %.1f, \"p50_us\": %.2f, \"p99_us\": %.2f, \"p999_us\": %.2f, \"errors\": %llu, "
+                "\"rejected_clients\": %zu}",
+                *first ? "" : ",", workload->name, payload, pipeline, clients, (unsigned long long)ops, rate, p50, p99,
+                p999, (unsigned long long)errors, rejected);
+        *first = false;
+    }
+
+    free(latencies);
+}
+
+static size_t ParseList(const char *text, long *values, long max)
+{
+    size_t count = 0;
+    char *end;
+
+    while (*text != '\0' && count < MAX_LIST)
+    {
+        long value = strtol(text, &end, 0);
+        if (end == text)
+        {
+            break;
+        }
+        values[count++] = value < 0 ? 0 : value > max ? max : value;
+        text = *end == ',' ? end + 1 : end;
+    }
+    return count;
+}
+
+static pid_t SpawnServer(const char *path)
+{
+    pid_t pid = fork();
+
+    if (pid == 0)
+    {
+        // Keep the server's log out of the results table.
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        execl(path, path, (char *)NULL);
+        perror(path);
+        _exit(127);
+    }
+
+    // The server starts listening once its network check timer has run.
+    if (pid > 0 && !WaitForServer(10))
+    {
+        fprintf(stderr, "server did not start listening on port %d\n", server_port);
+        kill(pid, SIGTERM);
+        waitpid(pid, NULL, 0);
+        return -1;
+    }
+    return pid;
+}
+
+int main(int argc, char *argv[])
+{
+    long payloads[MAX_LIST] = {0, 64, 512, 4096}, pipelines[MAX_LIST] = {1, 8}, clients[MAX_LIST] = {1, 2};
+    size_t payload_count = 4, pipeline_count = 2, client_count = 2;
+    const char *commands = NULL, *out = NULL, *spawn = NULL;
+    pid_t server = 0;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--host") == 0)
+        {
+            server_host = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--port") == 0)
+        {
+            server_port = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--seconds") == 0)
+        {
+            case_seconds = atof(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--commands") == 0)
+        {
+            commands = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--payloads") == 0)
+        {
+            payload_count = ParseList(argv[i + 1], payloads, sizeof(DATA_BLOCK));
+        }
+        else if (strcmp(argv[i], "--pipeline") == 0)
+        {
+            pipeline_count = ParseList(argv[i + 1], pipelines, MAX_PIPELINE);
+        }
+        else if (strcmp(argv[i], "--clients") == 0)
+        {
+            client_count = ParseList(argv[i + 1], clients, MAX_LIST);
+        }
+        else if (strcmp(argv[i], "--out") == 0)
+        {
+            out = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--spawn") == 0)
+        {
+            spawn = argv[i + 1];
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    if (spawn != NULL && (server = SpawnServer(spawn)) == -1)
+    {
+        return 1;
+    }
+
+    FILE *json = out != NULL ? fopen(out, "w") : NULL;
+    bool first = true;
+
+    if (json != NULL)
+    {
+        fprintf(json, "{\n  \"contract_version\": %d,\n  \"seconds_per_case\": %.3f,\n  \"results\": [", REMOTEX_CONTRACT_VERSION,
+                case_seconds);
+    }
+
+    printf("%-28s %6s %4s %3s %10s %9s %9s %9s %6s %4s\n", "command", "bytes", "pipe", "cli", "ops/s", "p50 us", "p99 us",
+           "p999 us", "errors", "rej");
+
+    for (size_t w = 0; w < NELEMS(workloads); w++)
+    {
+        if (commands != NULL && strstr(commands, workloads[w].name) == NULL)
+        {
+            continue;
+        }
+
+        for (size_t p = 0; p < (workloads[w].has_payload ? payload_count : 1); p++)
+        {
+            for (size_t d = 0; d < pipeline_count; d++)
+            {
+                for (size_t c = 0; c < client_count; c++)
+                {
+                    if (pipelines[d] > 0 && clients[c] > 0)
+                    {
+                        RunCase(json, &first, &workloads[w], workloads[w].has_payload ? (size_t)payloads[p] : 0,
+                                (int)pipelines[d], (int)clients[c]);
+                    }
+                }
+            }
+        }
+    }
+
+    if (json != NULL)
+    {
+        fprintf(json, "\n  ]\n}\n");
+        fclose(json);
+    }
+
+    if (server > 0)
+    {
+        kill(server, SIGTERM);
+        waitpid(server, NULL, 0);
+    }
+    return 0;
+}
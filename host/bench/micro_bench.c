@@ -0,0 +1,434 @@
+/* Microbenchmarks for the per-request path: framing, dispatch through cmd_functions[], the fd
+   ledger at its full 128 entries, response copy and send, and the timer utilities.
+
+   Each benchmark reports ns/op and heap allocations/op. Allocations are counted by wrapping
+   the glibc allocator, which a sanitizer build replaces, so they read n/a there. The frame
+   benchmarks drive a real server instance over loopback TCP, so they include the bench's own
+   send and recv.
+
+       micro_bench [--seconds 0.2] [--filter ledger] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <applibs/eventloop.h>
+
+#include "echo_tcp_server.h"
+#include "eventloop_timer_utilities.h"
+#include "timer_wheel.h"
+
+#if defined(__SANITIZE_ADDRESS__)
+#define COUNT_ALLOCATIONS 0
+#else
+#define COUNT_ALLOCATIONS 1
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *pointer, size_t size);
+#endif
+
+typedef struct
+{
+    const char *name;
+    void (*run)(uint64_t iterations);
+} Benchmark;
+
+static uint64_t allocations;
+static double target_seconds = 0.2;
+
+static EventLoop *event_loop;
+static EchoServer_ServerState *server;
+static int client_fd = -1;
+static int gpio_fd = -1;
+static EventLoopTimer *event_loop_timer;
+static TimerWheelTimer wheel_timer;
+
+#if COUNT_ALLOCATIONS
+void *malloc(size_t size)
+{
+    allocations++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    allocations++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size)
+{
+    allocations++;
+    return __libc_realloc(pointer, size);
+}
+#endif
+
+static void InitHeader(CTX_HEADER *header, SOCKET_CMD cmd, size_t length, bool respond)
+{
+    memset(header, 0, sizeof(*header));
+    header->block_length = (uint16_t)length;
+    header->response_length = (uint16_t)length;
+    header->cmd = cmd;
+    header->respond = respond;
+    header->contract_version = REMOTEX_CONTRACT_VERSION;
+}
+
+static void ServerStopped(EchoServer_StopReason reason)
+{
+    fprintf(stderr, "server stopped (%d)\n", reason);
+    exit(1);
+}
+
+static void TimerHandler(EventLoopTimer *timer)
+{
+    ConsumeEventLoopTimerEvent(timer);
+}
+
+static void WheelHandler(TimerWheelTimer *timer, void *context)
+{
+}
+
+/// <summary>
+/// Start a server on an ephemeral loopback port, connect to it and open a GPIO through the
+/// command path so its fd is in the ledger.
+/// </summary>
+static void Setup(void)
+{
+    struct sockaddr_in address;
+    socklen_t length = sizeof(address);
+
+    event_loop = EventLoop_Create();
+    TimerWheel_SetDefault(TimerWheel_Create(event_loop, TIMER_WHEEL_DEFAULT_TICK_US));
+
+    server = EchoServer_Start(event_loop, htonl(INADDR_LOOPBACK), 0, 1, ServerStopped);
+    if (server == NULL || getsockname(server->listenFd, (struct sockaddr *)&address, &length) == -1)
+    {
+        fprintf(stderr, "could not start the server\n");
+        exit(1);
+    }
+
+    client_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (connect(client_fd, (struct sockaddr *)&address, length) == -1)
+    {
+        perror("connect");
+        exit(1);
+    }
+
+    while (server->clientFd < 0)
+    {
+        EventLoop_Run(event_loop, 100, true);
+    }
+
+    // Back to back frames with no response, and sends with no request between them, would
+    // otherwise wait on delayed ACKs.
+    int on = 1;
+    setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    setsockopt(server->clientFd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    GPIO_OpenAsOutput_t open;
+    InitHeader(&open.header, GPIO_OpenAsOutput_c, sizeof(open), true);
+    open.gpioId = 8;
+    open.outputMode = GPIO_OutputMode_PushPull;
+    open.initialValue = GPIO_Value_Low;
+    dispatch_command((uint8_t *)&open, sizeof(open));
+    gpio_fd = open.header.returns;
+
+    event_loop_timer = CreateEventLoopDisarmedTimer(event_loop, TimerHandler);
+    TimerWheel_InitTimer(&wheel_timer, WheelHandler, NULL);
+}
+
+static void BenchFrameRoundTrip(uint64_t iterations)
+{
+    GPIO_GetValue_t request, response;
+
+    InitHeader(&request.header, GPIO_GetValue_c, sizeof(request), true);
+    request.gpioFd = gpio_fd;
+
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        send(client_fd, &request, sizeof(request), 0);
+        EventLoop_Run(event_loop, -1, true);
+        recv(client_fd, &response, sizeof(response), MSG_WAITALL);
+    }
+}
+
+static void BenchFrameNoResponse(uint64_t iterations)
+{
+    GPIO_SetValue_t request;
+
+    InitHeader(&request.header, GPIO_SetValue_c, sizeof(request), false);
+    request.gpioFd = gpio_fd;
+    request.value = 1;
+
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        send(client_fd, &request, sizeof(request), 0);
+        EventLoop_Run(event_loop, -1, true);
+    }
+}
+
+static void BenchDispatchGetValue(uint64_t iterations)
+{
+    GPIO_GetValue_t request;
+
+    InitHeader(&request.header, GPIO_GetValue_c, sizeof(request), true);
+    request.gpioFd = gpio_fd;
+
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        dispatch_command((uint8_t *)&request, sizeof(request));
+    }
+}
+
+static void BenchDispatchSetValue(uint64_t iterations)
+{
+    GPIO_SetValue_t request;
+
+    InitHeader(&request.header, GPIO_SetValue_c, sizeof(request), true);
+    request.gpioFd = gpio_fd;
+
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        request.value = (uint8_t)(i & 1);
+        dispatch_command((uint8_t *)&request, sizeof(request));
+    }
+}
+
+// The ledger benchmarks use fd numbers that are never opened, and put the real ledger back.
+#define LEDGER_BENCH_FD 100000
+
+static int saved_ledger[LEDGE_SIZE];
+
+static void FillLedger(size_t count)
+{
+    memcpy(saved_ledger, file_descriptor_ledger, sizeof(saved_ledger));
+    ledger_initialize();
+    for (size_t i = 0; i < count; i++)
+    {
+        ledger_add_file_descriptor(LEDGER_BENCH_FD + (int)i);
+    }
+}
+
+static void RestoreLedger(void)
+{
+    memcpy(file_descriptor_ledger, saved_ledger, sizeof(saved_ledger));
+}
+
+static volatile bool sink;
+
+static void BenchLedgerContainsHit(uint64_t iterations)
+{
+    FillLedger(LEDGE_SIZE);
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        sink = ledger_contains(LEDGER_BENCH_FD + LEDGE_SIZE - 1);
+    }
+    RestoreLedger();
+}
+
+static void BenchLedgerContainsMiss(uint64_t iterations)
+{
+    FillLedger(LEDGE_SIZE);
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        sink = ledger_contains(-2);
+    }
+    RestoreLedger();
+}
+
+static void BenchLedgerAddRemove(uint64_t iterations)
+{
+    FillLedger(LEDGE_SIZE - 1);
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        ledger_add_file_descriptor(LEDGER_BENCH_FD + LEDGE_SIZE);
+        ledger_remove_file_descriptor(LEDGER_BENCH_FD + LEDGE_SIZE);
+    }
+    RestoreLedger();
+}
+
+static void BenchLedgerPin(uint64_t iterations)
+{
+    FillLedger(LEDGE_SIZE);
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        ledger_pin(LEDGER_BENCH_FD + LEDGE_SIZE - 1, (i & 1) != 0);
+    }
+    ledger_pin(LEDGER_BENCH_FD + LEDGE_SIZE - 1, false);
+    RestoreLedger();
+}
+
+// process_command copies each response into the server's input buffer before sending it.
+static void CopyResponse(uint64_t iterations, size_t length)
+{
+    static uint8_t response[sizeof(server->input)];
+
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        response[0] = (uint8_t)i;
+        memcpy(server->input, response, length);
+    }
+}
+
+static void BenchCopySmall(uint64_t iterations)
+{
+    CopyResponse(iterations, sizeof(GPIO_GetValue_t));
+}
+
+static void BenchCopyLarge(uint64_t iterations)
+{
+    CopyResponse(iterations, 4096);
+}
+
+// A send on the server's client socket as the write path makes it, drained by the bench.
+static void SendResponse(uint64_t iterations, size_t length)
+{
+    static uint8_t response[sizeof(server->input)];
+
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        send(server->clientFd, response, length, 0);
+        recv(client_fd, response, length, MSG_WAITALL);
+    }
+}
+
+static void BenchSendSmall(uint64_t iterations)
+{
+    SendResponse(iterations, sizeof(GPIO_GetValue_t));
+}
+
+static void BenchSendLarge(uint64_t iterations)
+{
+    SendResponse(iterations, 4096);
+}
+
+static void BenchEventLoopTimerOneShot(uint64_t iterations)
+{
+    struct timespec delay = {.tv_sec = 10};
+
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        SetEventLoopTimerOneShot(event_loop_timer, &delay);
+        DisarmEventLoopTimer(event_loop_timer);
+    }
+}
+
+static void BenchTimerWheelStartCancel(uint64_t iterations)
+{
+    TimerWheel *wheel = TimerWheel_Default();
+
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        TimerWheel_StartOneShot(wheel, &wheel_timer, 10000 + (i & 1023) * 1000);
+        TimerWheel_Cancel(&wheel_timer);
+    }
+}
+
+static void BenchTimerWheelNow(uint64_t iterations)
+{
+    uint64_t total = 0;
+
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        total += TimerWheel_NowNs();
+    }
+    sink = total == 0;
+}
+
+static const Benchmark benchmarks[] = {
+    {"frame/GPIO_GetValue round trip", BenchFrameRoundTrip},
+    {"frame/GPIO_SetValue no response", BenchFrameNoResponse},
+    {"dispatch/GPIO_GetValue", BenchDispatchGetValue},
+    {"dispatch/GPIO_SetValue", BenchDispatchSetValue},
+    {"ledger/contains hit at 128", BenchLedgerContainsHit},
+    {"ledger/contains miss at 128", BenchLedgerContainsMiss},
+    {"ledger/add and remove at 127", BenchLedgerAddRemove},
+    {"ledger/pin at 128", BenchLedgerPin},
+    {"response/copy 23 B", BenchCopySmall},
+    {"response/copy 4096 B", BenchCopyLarge},
+    {"response/send 23 B", BenchSendSmall},
+    {"response/send 4096 B", BenchSendLarge},
+    {"timer/event loop one-shot and disarm", BenchEventLoopTimerOneShot},
+    {"timer/wheel start and cancel", BenchTimerWheelStartCancel},
+    {"timer/wheel now", BenchTimerWheelNow},
+};
+
+/// <summary>
+/// Grow the iteration count until a run takes a tenth of the target, then time one run sized to
+/// the target.
+/// </summary>
+static void Measure(const Benchmark *benchmark)
+{
+    uint64_t iterations = 1;
+    uint64_t target_ns = (uint64_t)(target_seconds * 1e9);
+    uint64_t elapsed;
+
+    for (;;)
+    {
+        uint64_t start = TimerWheel_NowNs();
+        benchmark->run(iterations);
+        elapsed = TimerWheel_NowNs() - start;
+
+        if (elapsed >= target_ns / 10 || iterations >= (1ull << 32))
+        {
+            break;
+        }
+        iterations *= 4;
+    }
+
+    iterations = elapsed > 0 ? (uint64_t)((double)iterations * (double)target_ns / (double)elapsed) : iterations;
+    iterations = iterations > 0 ? iterations : 1;
+
+    uint64_t allocations_before = allocations;
+    uint64_t start = TimerWheel_NowNs();
+    benchmark->run(iterations);
+    elapsed = TimerWheel_NowNs() - start;
+    uint64_t allocated = allocations - allocations_before;
+
+    if (COUNT_ALLOCATIONS)
+    {
+        printf("%-40s %12.1f %12.3f %12llu\n", benchmark->name, (double)elapsed / (double)iterations,
+               (double)allocated / (double)iterations, (unsigned long long)iterations);
+    }
+    else
+    {
+        printf("%-40s %12.1f %12s %12llu\n", benchmark->name, (double)elapsed / (double)iterations, "n/a",
+               (unsigned long long)iterations);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const char *filter = NULL;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--seconds") == 0)
+        {
+            target_seconds = atof(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--filter") == 0)
+        {
+            filter = argv[i + 1];
+        }
+    }
+
+    Setup();
+
+    printf("%-40s %12s %12s %12s\n", "benchmark", "ns/op", "allocs/op", "iterations");
+    for (size_t i = 0; i < NELEMS(benchmarks); i++)
+    {
+        if (filter == NULL || strstr(benchmarks[i].name, filter) != NULL)
+        {
+            Measure(&benchmarks[i]);
+        }
+    }
+
+    DisposeEventLoopTimer(event_loop_timer);
+    EchoServer_ShutDown(server);
+    return 0;
+}
@@ -0,0 +1,187 @@
+/* Timer wheel benchmark: 10k active timers on one timerfd.
+
+   Part one drives a manual wheel with simulated time to measure the cost of start,
+   cancel and expiry and to check every timer fires on its due tick. Part two runs the
+   timers on a real event loop and reports how late handlers run. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <applibs/eventloop.h>
+
+#include "timer_wheel.h"
+
+typedef struct
+{
+    TimerWheelTimer timer;
+    uint64_t fires;
+} BenchTimer;
+
+static BenchTimer *timers;
+static size_t timer_count = 10000;
+static int live_seconds = 3;
+
+static uint64_t simulated_ns;
+static uint64_t early_or_late;
+static uint64_t total_fires;
+
+static uint64_t *lateness;
+static size_t lateness_count;
+static size_t lateness_capacity;
+
+static uint64_t Random(uint64_t low, uint64_t high)
+{
+    return low + ((uint64_t)rand() * RAND_MAX + (uint64_t)rand()) % (high - low + 1);
+}
+
+static void SimulatedHandler(TimerWheelTimer *timer, void *context)
+{
+    BenchTimer *bench = context;
+    bench->fires++;
+    total_fires++;
+
+    if (TimerWheel_DueNs(timer) != simulated_ns)
+    {
+        early_or_late++;
+    }
+}
+
+static void LiveHandler(TimerWheelTimer *timer, void *context)
+{
+    BenchTimer *bench = context;
+    bench->fires++;
+    total_fires++;
+
+    if (lateness_count < lateness_capacity)
+    {
+        lateness[lateness_count++] = TimerWheel_NowNs() - TimerWheel_DueNs(timer);
+    }
+}
+
+static int CompareU64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void RunSimulated(void)
+{
+    TimerWheel *wheel = TimerWheel_Create(NULL, TIMER_WHEEL_DEFAULT_TICK_US);
+    uint64_t tick_ns = TimerWheel_TickUs(wheel) * 1000ull;
+
+    simulated_ns = 0;
+
+    for (size_t i = 0; i < timer_count; i++)
+    {
+        TimerWheel_InitTimer(&timers[i].timer, SimulatedHandler, &timers[i]);
+    }
+
+    uint64_t start = TimerWheel_NowNs();
+    for (size_t i = 0; i < timer_count; i++)
+    {
+        TimerWheel_StartOneShot(wheel, &timers[i].timer, Random(1000, 60000000));
+    }
+    uint64_t insert_ns = TimerWheel_NowNs() - start;
+
+    start = TimerWheel_NowNs();
+    for (size_t i = 0; i < timer_count; i++)
+    {
+        TimerWheel_Cancel(&timers[(i * 7919) % timer_count].timer);
+    }
+    uint64_t cancel_ns = TimerWheel_NowNs() - start;
+
+    for (size_t i = 0; i < timer_count; i++)
+    {
+        TimerWheel_StartPeriodic(wheel, &timers[i].timer, Random(1000, 1000000));
+    }
+
+    const uint64_t simulated_seconds = 60;
+    start = TimerWheel_NowNs();
+    for (simulated_ns = tick_ns; simulated_ns <= simulated_seconds * 1000000000ull; simulated_ns += tick_ns)
+    {
+        TimerWheel_Advance(wheel, simulated_ns);
+    }
+    uint64_t advance_ns = TimerWheel_NowNs() - start;
+
+    printf("simulated: %zu timers, tick %u us\n", timer_count, TimerWheel_TickUs(wheel));
+    printf("  start one-shot   %8.1f ns/op\n", (double)insert_ns / (double)timer_count);
+    printf("  cancel           %8.1f ns/op\n", (double)cancel_ns / (double)timer_count);
+    printf("  %llu s of periodic timers: %llu expiries, %.1f ns/expiry including %llu idle ticks\n",
+           (unsigned long long)simulated_seconds, (unsigned long long)total_fires,
+           (double)advance_ns / (double)total_fires,
+           (unsigned long long)(simulated_seconds * 1000000000ull / tick_ns));
+    printf("  expiries off their due tick: %llu\n", (unsigned long long)early_or_late);
+
+    TimerWheel_Dispose(wheel);
+}
+
+static void RunLive(void)
+{
+    EventLoop *eventLoop = EventLoop_Create();
+    TimerWheel *wheel = TimerWheel_Create(eventLoop, TIMER_WHEEL_DEFAULT_TICK_US);
+
+    total_fires = 0;
+    lateness_capacity = 8 * 1024 * 1024;
+    lateness = malloc(lateness_capacity * sizeof(*lateness));
+
+    for (size_t i = 0; i < timer_count; i++)
+    {
+        TimerWheel_InitTimer(&timers[i].timer, LiveHandler, &timers[i]);
+        TimerWheel_StartPeriodic(wheel, &timers[i].timer, Random(10000, 1000000));
+    }
+
+    uint64_t end = TimerWheel_NowNs() + (uint64_t)live_seconds * 1000000000ull;
+    while (TimerWheel_NowNs() < end)
+    {
+        EventLoop_Run(eventLoop, 100, false);
+    }
+
+    uint32_t overruns = 0;
+    for (size_t i = 0; i < timer_count; i++)
+    {
+        overruns += timers[i].timer.overruns;
+        TimerWheel_Cancel(&timers[i].timer);
+    }
+
+    qsort(lateness, lateness_count, sizeof(*lateness), CompareU64);
+
+    printf("live: %zu periodic timers (10 ms to 1 s) for %d s on one timerfd\n", timer_count, live_seconds);
+    printf("  expiries %llu (%.0f/s), overruns %u\n", (unsigned long long)total_fires,
+           (double)total_fires / live_seconds, overruns);
+    if (lateness_count > 0)
+    {
+        printf("  lateness p50 %llu us, p99 %llu us, max %llu us\n",
+               (unsigned long long)lateness[lateness_count / 2] / 1000,
+               (unsigned long long)lateness[lateness_count * 99 / 100] / 1000,
+               (unsigned long long)lateness[lateness_count - 1] / 1000);
+    }
+
+    free(lateness);
+    TimerWheel_Dispose(wheel);
+    EventLoop_Close(eventLoop);
+}
+
+int main(int argc, char *argv[])
+{
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--timers") == 0)
+        {
+            timer_count = (size_t)strtoul(argv[i + 1], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--seconds") == 0)
+        {
+            live_seconds = atoi(argv[i + 1]);
+        }
+    }
+
+    srand(1);
+    timers = calloc(timer_count, sizeof(*timers));
+
+    RunSimulated();
+    RunLive();
+
+    free(timers);
+    return 0;
+}
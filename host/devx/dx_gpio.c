@@ -0,0 +1,61 @@
+#include <unistd.h>
+
+#include <dx_gpio.h>
+
+bool dx_gpioOpen(DX_GPIO_BINDING *peripheral)
+{
+    if (peripheral->direction == DX_OUTPUT)
+    {
+        peripheral->fd = GPIO_OpenAsOutput(peripheral->pin, GPIO_OutputMode_PushPull, peripheral->initialState);
+    }
+    else if (peripheral->direction == DX_INPUT)
+    {
+        peripheral->fd = GPIO_OpenAsInput(peripheral->pin);
+    }
+    else
+    {
+        peripheral->fd = -1;
+    }
+
+    return peripheral->fd != -1;
+}
+
+void dx_gpioClose(DX_GPIO_BINDING *peripheral)
+{
+    if (peripheral->fd >= 0)
+    {
+        close(peripheral->fd);
+    }
+    peripheral->fd = -1;
+}
+
+static void gpio_set(DX_GPIO_BINDING *peripheral, bool on)
+{
+    if (peripheral->fd >= 0)
+    {
+        GPIO_SetValue(peripheral->fd, on != peripheral->invertPin ? GPIO_Value_High : GPIO_Value_Low);
+    }
+}
+
+void dx_gpioOn(DX_GPIO_BINDING *peripheral)
+{
+    gpio_set(peripheral, true);
+}
+
+void dx_gpioOff(DX_GPIO_BINDING *peripheral)
+{
+    gpio_set(peripheral, false);
+}
+
+bool dx_gpioStateGet(DX_GPIO_BINDING *peripheral, GPIO_Value_Type *oldState)
+{
+    GPIO_Value_Type newState;
+
+    if (peripheral->fd < 0 || GPIO_GetValue(peripheral->fd, &newState) == -1 || newState == *oldState)
+    {
+        return false;
+    }
+
+    *oldState = newState;
+    return true;
+}
@@ -0,0 +1,44 @@
+/* Host stand-in for the DevX termination helpers. SIGINT is handled as well as SIGTERM so
+   the server can be stopped from a terminal. */
+
+#include <signal.h>
+#include <string.h>
+
+#include <dx_terminate.h>
+
+static volatile sig_atomic_t terminationRequired = false;
+static volatile sig_atomic_t exitCode = DX_ExitCode_Success;
+
+static void TerminationHandler(int signalNumber)
+{
+    exitCode = DX_ExitCode_TermHandler_SigTerm;
+    terminationRequired = true;
+}
+
+void dx_registerTerminationHandler(void)
+{
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = TerminationHandler;
+    sigaction(SIGTERM, &action, NULL);
+    sigaction(SIGINT, &action, NULL);
+
+    // A client that vanishes mid-write must not kill the server.
+    signal(SIGPIPE, SIG_IGN);
+}
+
+void dx_terminate(int code)
+{
+    exitCode = code;
+    terminationRequired = true;
+}
+
+bool dx_isTerminationRequired(void)
+{
+    return terminationRequired;
+}
+
+int dx_getTerminationExitCode(void)
+{
+    return exitCode;
+}
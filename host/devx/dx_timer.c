@@ -0,0 +1,98 @@
+/* Host stand-in for the DevX timer bindings, with the event loop the server runs on. */
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include <applibs/log.h>
+#include <dx_terminate.h>
+#include <dx_timer.h>
+
+static EventLoop *eventLoop;
+
+EventLoop *dx_timerGetEventLoop(void)
+{
+    if (eventLoop == NULL)
+    {
+        eventLoop = EventLoop_Create();
+    }
+    return eventLoop;
+}
+
+bool dx_timerStart(DX_TIMER_BINDING *timer)
+{
+    if (timer->eventLoopTimer != NULL)
+    {
+        return true;
+    }
+
+    if (timer->period.tv_sec != 0 || timer->period.tv_nsec != 0)
+    {
+        timer->eventLoopTimer = CreateEventLoopPeriodicTimer(dx_timerGetEventLoop(), timer->handler, &timer->period);
+    }
+    else
+    {
+        timer->eventLoopTimer = CreateEventLoopDisarmedTimer(dx_timerGetEventLoop(), timer->handler);
+    }
+
+    if (timer->eventLoopTimer == NULL)
+    {
+        Log_Debug("ERROR: Could not start timer %s: %d\n", timer->name, errno);
+        return false;
+    }
+    return true;
+}
+
+void dx_timerSetStart(DX_TIMER_BINDING *timerSet[], size_t timerCount)
+{
+    for (size_t i = 0; i < timerCount; i++)
+    {
+        if (!dx_timerStart(timerSet[i]))
+        {
+            break;
+        }
+    }
+}
+
+void dx_timerStop(DX_TIMER_BINDING *timer)
+{
+    if (timer->eventLoopTimer != NULL)
+    {
+        DisposeEventLoopTimer(timer->eventLoopTimer);
+        timer->eventLoopTimer = NULL;
+    }
+}
+
+void dx_timerSetStop(DX_TIMER_BINDING *timerSet[], size_t timerCount)
+{
+    for (size_t i = 0; i < timerCount; i++)
+    {
+        dx_timerStop(timerSet[i]);
+    }
+}
+
+bool dx_timerOneShotSet(DX_TIMER_BINDING *timer, const struct timespec *delay)
+{
+    return timer->eventLoopTimer != NULL && SetEventLoopTimerOneShot(timer->eventLoopTimer, delay) == 0;
+}
+
+void dx_timerEventLoopStop(void)
+{
+    EventLoop_Close(eventLoop);
+    eventLoop = NULL;
+}
+
+int dx_eventLoopRun(void)
+{
+    EventLoop *el = dx_timerGetEventLoop();
+
+    while (!dx_isTerminationRequired())
+    {
+        // A termination signal interrupts the wait, which is reported as a failure.
+        if (EventLoop_Run(el, -1, true) == EventLoop_Run_Failed && errno != EINTR)
+        {
+            dx_terminate(DX_ExitCode_Main_EventLoopFail);
+        }
+    }
+
+    return dx_getTerminationExitCode();
+}
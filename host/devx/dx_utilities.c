@@ -0,0 +1,6 @@
+#include <dx_utilities.h>
+
+bool dx_isNetworkConnected(const char *networkInterface)
+{
+    return true;
+}
@@ -0,0 +1,13 @@
+/* Host stand-in for the Azure Sphere applibs ADC API. */
+
+#pragma once
+
+#include <stdint.h>
+
+typedef uint32_t ADC_ControllerId;
+typedef uint32_t ADC_ChannelId;
+
+int ADC_Open(ADC_ControllerId id);
+int ADC_GetSampleBitCount(int fd, ADC_ChannelId channel);
+int ADC_SetReferenceVoltage(int fd, ADC_ChannelId channel, float referenceVoltage);
+int ADC_Poll(int fd, ADC_ChannelId channel, uint32_t *outSampleValue);
@@ -0,0 +1,8 @@
+/* Host stand-in for the Azure Sphere applibs log API. */
+
+#pragma once
+
+#include <stdarg.h>
+
+int Log_Debug(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+int Log_DebugVarArgs(const char *fmt, va_list args);
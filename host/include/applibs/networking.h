@@ -0,0 +1,16 @@
+/* Host stand-in for the Azure Sphere applibs networking API. The host's own network
+   configuration is used, so applying an IP configuration does nothing. */
+
+#pragma once
+
+#include <stdint.h>
+
+typedef struct
+{
+    uint64_t reserved[5];
+} Networking_IpConfig;
+
+void Networking_IpConfig_Init(Networking_IpConfig *ipConfig);
+void Networking_IpConfig_EnableDynamicIp(Networking_IpConfig *ipConfig);
+int Networking_IpConfig_Apply(const char *networkInterfaceName, const Networking_IpConfig *ipConfig);
+void Networking_IpConfig_Destroy(Networking_IpConfig *ipConfig);
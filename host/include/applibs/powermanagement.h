@@ -0,0 +1,15 @@
+/* Host stand-in for the Azure Sphere applibs power management API. */
+
+#pragma once
+
+#include <stdint.h>
+
+typedef uint32_t PowerManagement_System_PowerProfile;
+enum
+{
+    PowerManagement_PowerSaver = 0,
+    PowerManagement_Balanced = 1,
+    PowerManagement_HighPerformance = 2
+};
+
+int PowerManagement_SetSystemPowerProfile(PowerManagement_System_PowerProfile desiredProfile);
@@ -0,0 +1,27 @@
+/* Host stand-in for the Azure Sphere applibs PWM API. Applied states are checked but drive nothing. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef uint32_t PWM_ControllerId;
+typedef uint32_t PWM_ChannelId;
+
+typedef uint32_t PWM_Polarity;
+enum
+{
+    PWM_Polarity_Normal = 0,
+    PWM_Polarity_Inversed = 1
+};
+
+typedef struct
+{
+    unsigned int period_nsec;
+    unsigned int dutyCycle_nsec;
+    PWM_Polarity polarity;
+    bool enabled;
+} PwmState;
+
+int PWM_Open(PWM_ControllerId pwm);
+int PWM_Apply(int pwmFd, PWM_ChannelId pwmChannel, const PwmState *newState);
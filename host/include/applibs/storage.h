@@ -0,0 +1,7 @@
+/* Host stand-in for the Azure Sphere applibs storage API. The mutable storage file is an
+   ordinary file, REMOTEX_HOST_STORAGE or mutable_storage.bin in the working directory. */
+
+#pragma once
+
+int Storage_OpenMutableFile(void);
+int Storage_DeleteMutableFile(void);
@@ -0,0 +1,30 @@
+/* Host stand-in for the DevX GPIO bindings. */
+
+#pragma once
+
+#include <stdbool.h>
+
+#include <applibs/gpio.h>
+
+typedef enum
+{
+    DX_DIRECTION_UNKNOWN,
+    DX_INPUT,
+    DX_OUTPUT
+} DX_GPIO_DIRECTION;
+
+typedef struct
+{
+    int fd;
+    GPIO_Id pin;
+    GPIO_Value_Type initialState;
+    bool invertPin;
+    DX_GPIO_DIRECTION direction;
+    const char *name;
+} DX_GPIO_BINDING;
+
+bool dx_gpioOpen(DX_GPIO_BINDING *peripheral);
+void dx_gpioClose(DX_GPIO_BINDING *peripheral);
+void dx_gpioOn(DX_GPIO_BINDING *peripheral);
+void dx_gpioOff(DX_GPIO_BINDING *peripheral);
+bool dx_gpioStateGet(DX_GPIO_BINDING *peripheral, GPIO_Value_Type *oldState);
@@ -0,0 +1,21 @@
+/* Host stand-in for the DevX termination helpers. */
+
+#pragma once
+
+#include <stdbool.h>
+
+// Applications define their own exit codes alongside these.
+typedef int ExitCode;
+
+typedef enum
+{
+    DX_ExitCode_Success = 0,
+    DX_ExitCode_TermHandler_SigTerm = 1,
+    DX_ExitCode_Main_EventLoopFail = 2,
+    DX_ExitCode_ConsumeEventLoopTimeEvent = 3
+} DX_ExitCode;
+
+void dx_registerTerminationHandler(void);
+void dx_terminate(int exitCode);
+bool dx_isTerminationRequired(void);
+int dx_getTerminationExitCode(void);
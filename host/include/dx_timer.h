@@ -0,0 +1,33 @@
+/* Host stand-in for the DevX timer bindings, built on eventloop_timer_utilities. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#include <applibs/eventloop.h>
+
+#include "eventloop_timer_utilities.h"
+
+typedef struct
+{
+    void (*handler)(EventLoopTimer *eventLoopTimer);
+    struct timespec period; // Zero for a timer that is started later as a one shot
+    EventLoopTimer *eventLoopTimer;
+    const char *name;
+} DX_TIMER_BINDING;
+
+EventLoop *dx_timerGetEventLoop(void);
+bool dx_timerStart(DX_TIMER_BINDING *timer);
+void dx_timerSetStart(DX_TIMER_BINDING *timerSet[], size_t timerCount);
+void dx_timerStop(DX_TIMER_BINDING *timer);
+void dx_timerSetStop(DX_TIMER_BINDING *timerSet[], size_t timerCount);
+bool dx_timerOneShotSet(DX_TIMER_BINDING *timer, const struct timespec *delay);
+void dx_timerEventLoopStop(void);
+
+/// <summary>
+/// Run the event loop until <see cref="dx_terminate" /> is called or a termination signal
+/// arrives. Returns the exit code.
+/// </summary>
+int dx_eventLoopRun(void);
@@ -0,0 +1,10 @@
+/* Host stand-in for the DevX utilities. */
+
+#pragma once
+
+#include <stdbool.h>
+
+/// <summary>
+/// The host manages its own network, so this always reports connected.
+/// </summary>
+bool dx_isNetworkConnected(const char *networkInterface);
@@ -0,0 +1,5 @@
+/* Host hardware definition. GPIO, I2C, SPI, PWM, ADC and UART ids are plain numbers on the host. */
+
+#pragma once
+
+#define STATUS_LED 8
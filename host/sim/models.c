@@ -0,0 +1,118 @@
+/* Register models for simulated I2C and SPI devices. */
+
+#include <math.h>
+#include <string.h>
+
+#include "simulator.h"
+
+static const SimDeviceModel registers_model = {.name = "registers"};
+
+// BME280 registers, from the Bosch datasheet
+#define BME280_CALIB_T_P 0x88
+#define BME280_CHIP_ID 0xD0
+#define BME280_RESET 0xE0
+#define BME280_CALIB_H 0xE1
+#define BME280_STATUS 0xF3
+#define BME280_CTRL_MEAS 0xF4
+#define BME280_DATA 0xF7
+
+#define BME280_CHIP_ID_VALUE 0x60
+#define BME280_RESET_VALUE 0xB6
+#define BME280_STATUS_MEASURING 0x08
+#define BME280_MODE_MASK 0x03
+#define BME280_MODE_FORCED 0x01
+#define BME280_CONVERSION_NS 10000000 // All three measurements at 1x oversampling
+
+// Compensation words from the datasheet's worked example, with raw readings that compensate to
+// about 25 C and 1006 hPa.
+static const uint8_t bme280_calibration_t_p[] = {0x70, 0x6B, 0x43, 0x67, 0x18, 0xFC, 0x7D, 0x8E, 0x43, 0xD6, 0xD0, 0x0B,
+                                                 0x27, 0x0B, 0x8C, 0x00, 0xF9, 0xFF, 0x8C, 0x3C, 0xF8, 0xC6, 0x70, 0x17};
+static const uint8_t bme280_calibration_h1 = 0x4B;
+static const uint8_t bme280_calibration_h[] = {0x6A, 0x01, 0x00, 0x13, 0x2A, 0x03, 0x1E};
+
+#define BME280_RAW_TEMPERATURE 519888
+#define BME280_RAW_PRESSURE 415148
+#define BME280_RAW_HUMIDITY 30000
+#define BME280_DRIFT_PERIOD_S 60.0
+
+static void bme280_reset(SimDevice *device)
+{
+    memset(device->registers, 0, sizeof(device->registers));
+    memcpy(&device->registers[BME280_CALIB_T_P], bme280_calibration_t_p, sizeof(bme280_calibration_t_p));
+    device->registers[BME280_CALIB_T_P + sizeof(bme280_calibration_t_p) + 1] = bme280_calibration_h1;
+    memcpy(&device->registers[BME280_CALIB_H], bme280_calibration_h, sizeof(bme280_calibration_h));
+    device->registers[BME280_CHIP_ID] = BME280_CHIP_ID_VALUE;
+    device->busy_until_ns = 0;
+}
+
+/// <summary>
+/// Latch a new set of readings. The temperature drifts slowly around the example reading so
+/// clients can see the values change.
+/// </summary>
+static void bme280_measure(SimDevice *device)
+{
+    double seconds = (double)Sim_NowNs() / 1e9;
+    uint32_t temperature = BME280_RAW_TEMPERATURE + (uint32_t)(2000 * (1 + sin(2 * M_PI * seconds / BME280_DRIFT_PERIOD_S)));
+    uint8_t *data = &device->registers[BME280_DATA];
+
+    data[0] = (uint8_t)(BME280_RAW_PRESSURE >> 12);
+    data[1] = (uint8_t)(BME280_RAW_PRESSURE >> 4);
+    data[2] = (uint8_t)(BME280_RAW_PRESSURE << 4);
+    data[3] = (uint8_t)(temperature >> 12);
+    data[4] = (uint8_t)(temperature >> 4);
+    data[5] = (uint8_t)(temperature << 4);
+    data[6] = (uint8_t)(BME280_RAW_HUMIDITY >> 8);
+    data[7] = (uint8_t)BME280_RAW_HUMIDITY;
+}
+
+static void bme280_read(SimDevice *device, uint8_t reg)
+{
+    uint8_t mode = device->registers[BME280_CTRL_MEAS] & BME280_MODE_MASK;
+
+    if (device->busy_until_ns != 0 && Sim_NowNs() >= device->busy_until_ns)
+    {
+        // A forced conversion has finished: latch it and return to sleep.
+        device->busy_until_ns = 0;
+        bme280_measure(device);
+        device->registers[BME280_CTRL_MEAS] &= (uint8_t)~BME280_MODE_MASK;
+    }
+    else if (mode == BME280_MODE_MASK)
+    {
+        // Normal mode converts continuously.
+        bme280_measure(device);
+    }
+
+    device->registers[BME280_STATUS] = device->busy_until_ns != 0 ? BME280_STATUS_MEASURING : 0;
+}
+
+static void bme280_write(SimDevice *device, uint8_t reg, uint8_t value)
+{
+    if (reg == BME280_RESET && value == BME280_RESET_VALUE)
+    {
+        bme280_reset(device);
+    }
+    else if (reg == BME280_CTRL_MEAS && (value & BME280_MODE_MASK) == BME280_MODE_FORCED)
+    {
+        device->busy_until_ns = Sim_NowNs() + BME280_CONVERSION_NS;
+    }
+}
+
+static const SimDeviceModel bme280_model = {.name = "bme280",
+                                            .reset = bme280_reset,
+                                            .read = bme280_read,
+                                            .write = bme280_write,
+                                            .spi_register_base = 0x80};
+
+const SimDeviceModel *Sim_FindModel(const char *name)
+{
+    static const SimDeviceModel *models[] = {&registers_model, &bme280_model};
+
+    for (size_t i = 0; i < sizeof(models) / sizeof(models[0]); i++)
+    {
+        if (strcmp(models[i]->name, name) == 0)
+        {
+            return models[i];
+        }
+    }
+    return NULL;
+}
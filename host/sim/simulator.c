@@ -0,0 +1,457 @@
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <applibs/log.h>
+
+#include "simulator.h"
+
+#define LINE_LENGTH 256
+
+// Used when REMOTEX_HOST_SIM is not set.
+static const char default_config[] = "i2c * 0x76 registers\n"
+                                     "spi * * registers\n"
+                                     "adc * * constant offset=2048\n"
+                                     "uart *\n";
+
+static SimDevice devices[SIM_MAX_DEVICES];
+static size_t device_count;
+static bool loaded;
+static uint64_t random_state = 1;
+
+uint64_t Sim_NowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+void Sim_Delay(uint64_t ns)
+{
+    uint64_t deadline = Sim_NowNs() + ns;
+
+    // Sleep through most of a long delay, then spin so short transfers still take their time.
+    if (ns > 1000000)
+    {
+        struct timespec sleep = {.tv_sec = (time_t)((ns - 100000) / 1000000000), .tv_nsec = (long)((ns - 100000) % 1000000000)};
+        nanosleep(&sleep, NULL);
+    }
+
+    while (Sim_NowNs() < deadline)
+    {
+    }
+}
+
+/// <summary>
+/// xorshift64*, seeded from the configuration so runs with faults are repeatable.
+/// </summary>
+static double random_unit(void)
+{
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return (double)((random_state * 0x2545F4914F6CDD1Dull) >> 11) / (double)(1ull << 53);
+}
+
+static bool chance(double rate)
+{
+    return rate > 0 && random_unit() < rate;
+}
+
+SimDevice *Sim_Find(SimBus bus, int interface, int sub)
+{
+    for (size_t i = 0; i < device_count; i++)
+    {
+        if (devices[i].bus == bus && devices[i].interface == interface && devices[i].sub == sub)
+        {
+            return &devices[i];
+        }
+    }
+    return NULL;
+}
+
+/// <summary>
+/// The device slot for a location, replacing a device configured there by an earlier line.
+/// </summary>
+static SimDevice *place_device(SimBus bus, int interface, int sub)
+{
+    SimDevice *device = Sim_Find(bus, interface, sub);
+
+    if (device == NULL)
+    {
+        if (device_count == SIM_MAX_DEVICES)
+        {
+            return NULL;
+        }
+        device = &devices[device_count++];
+    }
+
+    memset(device, 0, sizeof(*device));
+    device->bus = bus;
+    device->interface = interface;
+    device->sub = sub;
+    return device;
+}
+
+static bool parse_wave(const char *name, SimWave *wave)
+{
+    static const char *names[] = {"constant", "sine", "square", "triangle"};
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        if (strcmp(name, names[i]) == 0)
+        {
+            *wave = (SimWave)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool apply_setting(SimDevice *device, const char *key, const char *value)
+{
+    if (strcmp(key, "latency_us") == 0)
+    {
+        device->latency_us = (uint32_t)strtoul(value, NULL, 0);
+    }
+    else if (strcmp(key, "stretch_us") == 0)
+    {
+        device->stretch_us = (uint32_t)strtoul(value, NULL, 0);
+    }
+    else if (strcmp(key, "nack_rate") == 0)
+    {
+        device->nack_rate = strtod(value, NULL);
+    }
+    else if (strcmp(key, "error_rate") == 0)
+    {
+        device->error_rate = strtod(value, NULL);
+    }
+    else if (strcmp(key, "offset") == 0)
+    {
+        device->offset = strtod(value, NULL);
+    }
+    else if (strcmp(key, "amplitude") == 0)
+    {
+        device->amplitude = strtod(value, NULL);
+    }
+    else if (strcmp(key, "noise") == 0)
+    {
+        device->noise = strtod(value, NULL);
+    }
+    else if (strcmp(key, "period_ms") == 0)
+    {
+        device->period_ms = (uint32_t)strtoul(value, NULL, 0);
+    }
+    else if (strncmp(key, "reg.", 4) == 0 && device->model != NULL)
+    {
+        device->registers[(uint8_t)strtoul(key + 4, NULL, 0)] = (uint8_t)strtoul(value, NULL, 0);
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+/// <summary>
+/// Parse "*" or a number no larger than limit - 1 into first and last.
+/// </summary>
+static bool parse_range(const char *text, int limit, int *first, int *last)
+{
+    char *end;
+
+    if (strcmp(text, "*") == 0)
+    {
+        *first = 0;
+        *last = limit - 1;
+        return true;
+    }
+
+    long value = strtol(text, &end, 0);
+    if (*end != '\0' || value < 0 || value >= limit)
+    {
+        return false;
+    }
+
+    *first = *last = (int)value;
+    return true;
+}
+
+/// <summary>
+/// Configure the devices named by one line, applying its settings to each. Returns false if
+/// the line is malformed.
+/// </summary>
+static bool parse_line(char *line)
+{
+    char *words[16];
+    size_t count = 0;
+    int interface_limit, sub_limit = 1, first_interface, last_interface, first_sub = 0, last_sub = 0;
+    size_t settings;
+    const SimDeviceModel *model = NULL;
+    SimWave wave = SimWave_Constant;
+    SimBus bus;
+
+    for (char *word = strtok(line, " \t\r\n"); word != NULL && count < sizeof(words) / sizeof(words[0]);
+         word = strtok(NULL, " \t\r\n"))
+    {
+        words[count++] = word;
+    }
+
+    if (count == 0 || words[0][0] == '#')
+    {
+        return true;
+    }
+
+    if (strcmp(words[0], "seed") == 0 && count == 2)
+    {
+        random_state = strtoull(words[1], NULL, 0) | 1;
+        return true;
+    }
+
+    if (strcmp(words[0], "i2c") == 0 && count >= 4)
+    {
+        bus = SimBus_I2c;
+        interface_limit = SIM_I2C_INTERFACES;
+        sub_limit = SIM_I2C_ADDRESSES;
+        model = Sim_FindModel(words[3]);
+        settings = 4;
+    }
+    else if (strcmp(words[0], "spi") == 0 && count >= 4)
+    {
+        bus = SimBus_Spi;
+        interface_limit = SIM_SPI_INTERFACES;
+        sub_limit = SIM_SPI_CHIP_SELECTS;
+        model = Sim_FindModel(words[3]);
+        settings = 4;
+    }
+    else if (strcmp(words[0], "adc") == 0 && count >= 4 && parse_wave(words[3], &wave))
+    {
+        bus = SimBus_Adc;
+        interface_limit = SIM_ADC_CONTROLLERS;
+        sub_limit = SIM_ADC_CHANNELS;
+        settings = 4;
+    }
+    else if (strcmp(words[0], "uart") == 0 && count >= 2)
+    {
+        bus = SimBus_Uart;
+        interface_limit = SIM_UARTS;
+        settings = 2;
+    }
+    else
+    {
+        return false;
+    }
+
+    if ((bus == SimBus_I2c || bus == SimBus_Spi) && model == NULL)
+    {
+        return false;
+    }
+
+    if (!parse_range(words[1], interface_limit, &first_interface, &last_interface) ||
+        (settings == 4 && !parse_range(words[2], sub_limit, &first_sub, &last_sub)))
+    {
+        return false;
+    }
+
+    for (int interface = first_interface; interface <= last_interface; interface++)
+    {
+        for (int sub = first_sub; sub <= last_sub; sub++)
+        {
+            SimDevice *device = place_device(bus, interface, sub);
+            if (device == NULL)
+            {
+                return false;
+            }
+
+            device->model = model;
+            device->wave = wave;
+            if (model != NULL && model->reset != NULL)
+            {
+                model->reset(device);
+            }
+
+            for (size_t i = settings; i < count; i++)
+            {
+                char *value = strchr(words[i], '=');
+                if (value == NULL)
+                {
+                    return false;
+                }
+
+                *value++ = '\0';
+                if (!apply_setting(device, words[i], value))
+                {
+                    return false;
+                }
+                value[-1] = '=';
+            }
+        }
+    }
+    return true;
+}
+
+static void load_text(const char *text, const char *source)
+{
+    char line[LINE_LENGTH];
+    int line_number = 0;
+
+    while (*text != '\0')
+    {
+        size_t length = strcspn(text, "\n");
+        size_t copied = length < sizeof(line) - 1 ? length : sizeof(line) - 1;
+
+        memcpy(line, text, copied);
+        line[copied] = '\0';
+        text += length + (text[length] == '\n');
+        line_number++;
+
+        if (!parse_line(line))
+        {
+            Log_Debug("WARNING: simulator: %s:%d not understood\n", source, line_number);
+        }
+    }
+}
+
+void Sim_Load(void)
+{
+    const char *path = getenv("REMOTEX_HOST_SIM");
+
+    if (loaded)
+    {
+        return;
+    }
+    loaded = true;
+
+    if (path == NULL)
+    {
+        load_text(default_config, "default");
+        return;
+    }
+
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        Log_Debug("ERROR: simulator: cannot open %s (%s), using the default devices\n", path, strerror(errno));
+        load_text(default_config, "default");
+        return;
+    }
+
+    char line[LINE_LENGTH];
+    int line_number = 0;
+
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        line_number++;
+        if (!parse_line(line))
+        {
+            Log_Debug("WARNING: simulator: %s:%d not understood\n", path, line_number);
+        }
+    }
+    fclose(file);
+
+    Log_Debug("INFO: simulator: %zu devices from %s\n", device_count, path);
+}
+
+int Sim_I2cTransfer(SimDevice *device, uint32_t speed_hz, uint32_t timeout_ms, size_t segments, size_t bytes)
+{
+    // Nine clocks per byte including the acknowledge, plus a start and stop per segment.
+    uint64_t bit_ns = 1000000000ull / (speed_hz ? speed_hz : 100000);
+    uint64_t address_ns = 11 * bit_ns;
+
+    if (device == NULL || chance(device->nack_rate))
+    {
+        Sim_Delay(address_ns);
+        errno = ENXIO;
+        return -1;
+    }
+
+    uint64_t wire_ns = segments * address_ns + bytes * 9 * bit_ns;
+    uint64_t stretch_ns = (uint64_t)device->stretch_us * 1000 * bytes;
+
+    if (timeout_ms != 0 && stretch_ns > (uint64_t)timeout_ms * 1000000)
+    {
+        Sim_Delay((uint64_t)timeout_ms * 1000000);
+        errno = ETIMEDOUT;
+        return -1;
+    }
+
+    Sim_Delay((uint64_t)device->latency_us * 1000 + wire_ns + stretch_ns);
+
+    if (chance(device->error_rate))
+    {
+        errno = EIO;
+        return -1;
+    }
+    return 0;
+}
+
+int Sim_SpiTransfer(SimDevice *device, uint32_t speed_hz, size_t bytes)
+{
+    uint64_t wire_ns = bytes * 8 * 1000000000ull / (speed_hz ? speed_hz : 1000000);
+
+    Sim_Delay((device != NULL ? (uint64_t)device->latency_us * 1000 : 0) + wire_ns);
+
+    if (device != NULL && chance(device->error_rate))
+    {
+        errno = EIO;
+        return -1;
+    }
+    return 0;
+}
+
+uint8_t Sim_ReadRegister(SimDevice *device, uint8_t reg)
+{
+    if (device->model->read != NULL)
+    {
+        device->model->read(device, reg);
+    }
+    return device->registers[reg];
+}
+
+void Sim_WriteRegister(SimDevice *device, uint8_t reg, uint8_t value)
+{
+    device->registers[reg] = value;
+    if (device->model->write != NULL)
+    {
+        device->model->write(device, reg, value);
+    }
+}
+
+uint32_t Sim_AdcSample(SimDevice *device, uint32_t max_value)
+{
+    double phase = device->period_ms ? (double)(Sim_NowNs() / 1000000 % device->period_ms) / device->period_ms : 0;
+    double value = device->offset;
+
+    Sim_Delay((uint64_t)device->latency_us * 1000);
+
+    switch (device->wave)
+    {
+    case SimWave_Sine:
+        value += device->amplitude * sin(2 * M_PI * phase);
+        break;
+    case SimWave_Square:
+        value += phase < 0.5 ? device->amplitude : -device->amplitude;
+        break;
+    case SimWave_Triangle:
+        value += device->amplitude * (phase < 0.5 ? 4 * phase - 1 : 3 - 4 * phase);
+        break;
+    default:
+        break;
+    }
+
+    value += device->noise * (2 * random_unit() - 1);
+
+    if (value <= 0)
+    {
+        return 0;
+    }
+    return value >= max_value ? max_value : (uint32_t)lround(value);
+}
+
+uint64_t Sim_UartCharacterNs(uint32_t baud_rate, unsigned bits_per_character)
+{
+    return (uint64_t)bits_per_character * 1000000000ull / (baud_rate ? baud_rate : 115200);
+}
@@ -0,0 +1,127 @@
+/* Peripheral simulator behind the host applibs stand-ins. Devices, their timing and injected
+   faults are read from the file named by REMOTEX_HOST_SIM; see example.conf for the format.
+   Without a file every I2C interface has a register map at 0x76, every SPI chip select is a
+   register map and every ADC channel reads mid-scale. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SIM_MAX_DEVICES 256
+
+// Sizes of the simulated hardware
+#define SIM_I2C_INTERFACES 8
+#define SIM_I2C_ADDRESSES 128
+#define SIM_SPI_INTERFACES 8
+#define SIM_SPI_CHIP_SELECTS 4
+#define SIM_ADC_CONTROLLERS 2
+#define SIM_ADC_CHANNELS 8
+#define SIM_UARTS 4
+
+typedef enum
+{
+    SimBus_I2c,
+    SimBus_Spi,
+    SimBus_Adc,
+    SimBus_Uart
+} SimBus;
+
+typedef struct SimDevice SimDevice;
+
+typedef struct
+{
+    const char *name;
+    void (*reset)(SimDevice *device);
+    // Called before a register is returned to the bus, to refresh live values.
+    void (*read)(SimDevice *device, uint8_t reg);
+    // Called after a register has been written from the bus.
+    void (*write)(SimDevice *device, uint8_t reg, uint8_t value);
+    // Added to the 7 bit SPI register address, for parts that map their registers high.
+    uint8_t spi_register_base;
+} SimDeviceModel;
+
+typedef enum
+{
+    SimWave_Constant,
+    SimWave_Sine,
+    SimWave_Square,
+    SimWave_Triangle
+} SimWave;
+
+struct SimDevice
+{
+    SimBus bus;
+    int interface; // I2C or SPI interface, ADC controller or UART id
+    int sub;       // I2C address, SPI chip select or ADC channel
+
+    // Timing and faults
+    uint32_t latency_us; // Added to every transaction
+    uint32_t stretch_us; // I2C clock stretching, per byte
+    double nack_rate;    // I2C transactions not acknowledged
+    double error_rate;   // Transactions failing with EIO
+
+    // Register devices
+    const SimDeviceModel *model;
+    uint8_t pointer;
+    uint8_t registers[256];
+    uint64_t busy_until_ns; // Model specific, for example a conversion in progress
+
+    // ADC channels, in sample counts
+    SimWave wave;
+    double offset;
+    double amplitude;
+    double noise;
+    uint32_t period_ms;
+};
+
+/// <summary>
+/// The register model called name, or NULL. Models are "registers", a plain register map,
+/// and "bme280", a Bosch BME280 environmental sensor.
+/// </summary>
+const SimDeviceModel *Sim_FindModel(const char *name);
+
+/// <summary>
+/// Load the configuration, once. Called by each stand-in's open function.
+/// </summary>
+void Sim_Load(void);
+
+/// <summary>
+/// The device at interface and sub on bus, or NULL if none is configured there.
+/// </summary>
+SimDevice *Sim_Find(SimBus bus, int interface, int sub);
+
+uint64_t Sim_NowNs(void);
+
+/// <summary>
+/// Hold the caller for ns, as a blocking bus transfer would.
+/// </summary>
+void Sim_Delay(uint64_t ns);
+
+/// <summary>
+/// Account for an I2C transaction of segments start conditions and bytes data bytes on a bus
+/// clocked at speed_hz. Returns 0, or -1 with errno set to ENXIO for a NACK, ETIMEDOUT if clock
+/// stretching outlasts timeout_ms or EIO for an injected error. A NULL device is absent and
+/// never acknowledges.
+/// </summary>
+int Sim_I2cTransfer(SimDevice *device, uint32_t speed_hz, uint32_t timeout_ms, size_t segments, size_t bytes);
+
+/// <summary>
+/// Account for bytes clocked at speed_hz to device, which may be NULL for an empty chip select.
+/// Returns 0, or -1 with errno set to EIO for an injected error.
+/// </summary>
+int Sim_SpiTransfer(SimDevice *device, uint32_t speed_hz, size_t bytes);
+
+uint8_t Sim_ReadRegister(SimDevice *device, uint8_t reg);
+void Sim_WriteRegister(SimDevice *device, uint8_t reg, uint8_t value);
+
+/// <summary>
+/// The next sample of an ADC channel, clamped to max_value.
+/// </summary>
+uint32_t Sim_AdcSample(SimDevice *device, uint32_t max_value);
+
+/// <summary>
+/// Time on the wire for one UART character with the given framing, in ns.
+/// </summary>
+uint64_t Sim_UartCharacterNs(uint32_t baud_rate, unsigned bits_per_character);
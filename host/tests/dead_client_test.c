@@ -0,0 +1,369 @@
+/* Dead client recovery against an in-process server.
+
+       dead_client_test reset         A client resets the connection while responses are
+                                      queued for it. The server must drop it and accept the
+                                      next client, not stop.
+       dead_client_test unresponsive  A client's link goes down, so keepalive probes go
+                                      unanswered. A new client is refused until the probes
+                                      start failing, then must take the old one's place before
+                                      keepalive gives up on it. Needs root to create a network
+                                      namespace and exits 77 (skipped) without it.
+
+   Exits 0 on success and 1 on failure. */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <applibs/eventloop.h>
+
+#include "echo_tcp_server.h"
+#include "timer_wheel.h"
+
+#define SKIPPED 77
+
+// Peer side of the veth pair lives in its own namespace, so taking its link down silences
+// the client without touching loopback.
+#define NETNS "remotex_dead_client"
+#define SERVER_ADDRESS "10.213.0.1"
+#define CLIENT_ADDRESS "10.213.0.2"
+
+static EventLoop *event_loop;
+static EchoServer_ServerState *server;
+static struct sockaddr_in server_address;
+static bool server_stopped;
+static bool netns_created;
+
+static uint64_t monotonic_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+static void Fail(const char *message)
+{
+    fprintf(stderr, "FAIL: %s\n", message);
+    exit(1);
+}
+
+static void ServerStopped(EchoServer_StopReason reason)
+{
+    server_stopped = true;
+}
+
+static void InitHeader(CTX_HEADER *header, SOCKET_CMD cmd, size_t length, size_t responseLength)
+{
+    memset(header, 0, sizeof(*header));
+    header->block_length = (uint16_t)length;
+    header->response_length = (uint16_t)responseLength;
+    header->cmd = cmd;
+    header->respond = true;
+    header->contract_version = REMOTEX_CONTRACT_VERSION;
+}
+
+/// <summary>
+/// Run the event loop until done(context) returns true or timeoutMs passes.
+/// </summary>
+static bool PumpUntil(bool (*done)(void *context), void *context, int timeoutMs)
+{
+    uint64_t deadline = monotonic_ns() + (uint64_t)timeoutMs * 1000000;
+
+    while (!done(context))
+    {
+        if (server_stopped || monotonic_ns() > deadline)
+        {
+            return false;
+        }
+        EventLoop_Run(event_loop, 10, true);
+    }
+    return true;
+}
+
+static bool ClientAccepted(void *context)
+{
+    return server->clientFd >= 0 && server->clientFd != *(int *)context;
+}
+
+static bool ClientGone(void *context)
+{
+    return server->clientFd < 0;
+}
+
+static void StartServer(in_addr_t address)
+{
+    socklen_t length = sizeof(server_address);
+
+    event_loop = EventLoop_Create();
+    TimerWheel_SetDefault(TimerWheel_Create(event_loop, TIMER_WHEEL_DEFAULT_TICK_US));
+
+    server = EchoServer_Start(event_loop, address, 0, 1, ServerStopped);
+    if (server == NULL || getsockname(server->listenFd, (struct sockaddr *)&server_address, &length) == -1)
+    {
+        Fail("could not start the server");
+    }
+}
+
+/// <summary>
+/// Connect to the server at address on the server's port and wait until it owns the connection.
+/// </summary>
+static int Connect(const char *address)
+{
+    struct sockaddr_in target = server_address;
+    int previous = server->clientFd;
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+
+    inet_pton(AF_INET, address, &target.sin_addr);
+    if (fd == -1 || (connect(fd, (struct sockaddr *)&target, sizeof(target)) == -1 && errno != EINPROGRESS))
+    {
+        Fail("could not connect");
+    }
+
+    if (!PumpUntil(ClientAccepted, &previous, 2000))
+    {
+        Fail("the server did not accept the client");
+    }
+    return fd;
+}
+
+typedef struct
+{
+    int fd;
+    uint8_t *data;
+    size_t length;
+    size_t received;
+} Receive;
+
+static bool Received(void *context)
+{
+    Receive *receive = context;
+    ssize_t n = recv(receive->fd, receive->data + receive->received, receive->length - receive->received, MSG_DONTWAIT);
+
+    if (n > 0)
+    {
+        receive->received += (size_t)n;
+    }
+    return receive->received == receive->length;
+}
+
+/// <summary>
+/// Ping over fd and check the answer.
+/// </summary>
+static void Ping(int fd)
+{
+    RemoteX_Session_t request;
+    RemoteX_Session_t response;
+    Receive receive = {.fd = fd, .data = (uint8_t *)&response, .length = sizeof(response)};
+
+    InitHeader(&request.header, RemoteX_Session_c, sizeof(request), sizeof(request));
+    request.op = SessionOp_Ping;
+
+    if (send(fd, &request, sizeof(request), MSG_NOSIGNAL) != sizeof(request) || !PumpUntil(Received, &receive, 2000) ||
+        response.header.returns != 0 || response.serverNs == 0)
+    {
+        Fail("ping was not answered");
+    }
+}
+
+static int TestReset(void)
+{
+    GPIO_GetValue_t request;
+    int small = 4096;
+
+    StartServer(htonl(INADDR_LOOPBACK));
+
+    int client = Connect("127.0.0.1");
+    setsockopt(client, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+    setsockopt(server->clientFd, SOL_SOCKET, SO_SNDBUF, &small, sizeof(small));
+
+    // Ask for 4 KB responses and never read them, until the server waits for room to send.
+    InitHeader(&request.header, GPIO_GetValue_c, sizeof(request), 4096);
+    request.gpioFd = -1;
+
+    for (int i = 0; i < 1000 && !server->outputArmed; i++)
+    {
+        send(client, &request, sizeof(request), MSG_NOSIGNAL);
+        EventLoop_Run(event_loop, 10, true);
+    }
+    if (!server->outputArmed)
+    {
+        Fail("the server never blocked on send");
+    }
+
+    // Close with a reset rather than a FIN.
+    struct linger reset = {.l_onoff = 1, .l_linger = 0};
+    setsockopt(client, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+    close(client);
+
+    if (!PumpUntil(ClientGone, NULL, 2000))
+    {
+        Fail(server_stopped ? "the server stopped on a send error" : "the reset client was not dropped");
+    }
+
+    Ping(Connect("127.0.0.1"));
+    printf("reset: client dropped on a send error, next client served\n");
+    return 0;
+}
+
+static void RemoveNetns(void)
+{
+    if (netns_created)
+    {
+        system("ip netns delete " NETNS " 2>/dev/null; ip link delete rxdead0 2>/dev/null");
+    }
+}
+
+static bool Run(const char *command)
+{
+    return system(command) == 0;
+}
+
+/// <summary>
+/// Create a socket inside the namespace. The socket stays there after the thread returns.
+/// </summary>
+static void EnterNetns(int *saved)
+{
+    int target = open("/run/netns/" NETNS, O_RDONLY | O_CLOEXEC);
+
+    *saved = open("/proc/self/ns/net", O_RDONLY | O_CLOEXEC);
+    if (target == -1 || *saved == -1 || setns(target, CLONE_NEWNET) == -1)
+    {
+        Fail("could not enter the network namespace");
+    }
+    close(target);
+}
+
+static void LeaveNetns(int saved)
+{
+    if (setns(saved, CLONE_NEWNET) == -1)
+    {
+        Fail("could not leave the network namespace");
+    }
+    close(saved);
+}
+
+typedef struct
+{
+    uint8_t probes;
+} Probes;
+
+static bool KeepaliveUnanswered(void *context)
+{
+    struct tcp_info info;
+    socklen_t length = sizeof(info);
+
+    return server->clientFd >= 0 && getsockopt(server->clientFd, IPPROTO_TCP, TCP_INFO, &info, &length) == 0 &&
+           info.tcpi_probes >= ((Probes *)context)->probes;
+}
+
+static bool NewClientRefused(void *context)
+{
+    return server_stats.refusedClients > *(uint32_t *)context;
+}
+
+static int TestUnresponsive(void)
+{
+    int saved;
+
+    if (geteuid() != 0 || !Run("ip netns add " NETNS " 2>/dev/null"))
+    {
+        printf("unresponsive: skipped, needs root and ip netns\n");
+        return SKIPPED;
+    }
+    netns_created = true;
+    atexit(RemoveNetns);
+
+    if (!Run("ip link add rxdead0 type veth peer name rxdead1 netns " NETNS " && "
+             "ip addr add " SERVER_ADDRESS "/30 dev rxdead0 && ip link set rxdead0 up && "
+             "ip netns exec " NETNS " ip addr add " CLIENT_ADDRESS "/30 dev rxdead1 && "
+             "ip netns exec " NETNS " ip link set rxdead1 up && "
+             "ip netns exec " NETNS " ip link set lo up"))
+    {
+        Fail("could not set up the veth pair");
+    }
+
+    StartServer(htonl(INADDR_ANY));
+
+    EnterNetns(&saved);
+    int stale = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    LeaveNetns(saved);
+
+    struct sockaddr_in target = server_address;
+    int previous = server->clientFd;
+    inet_pton(AF_INET, SERVER_ADDRESS, &target.sin_addr);
+    fcntl(stale, F_SETFL, O_NONBLOCK);
+    if (connect(stale, (struct sockaddr *)&target, sizeof(target)) == -1 && errno != EINPROGRESS)
+    {
+        Fail("could not connect from the namespace");
+    }
+    if (!PumpUntil(ClientAccepted, &previous, 2000))
+    {
+        Fail("the server did not accept the namespace client");
+    }
+    Ping(stale);
+
+    // The client vanishes without closing: its packets, ACKs included, stop arriving.
+    if (!Run("ip netns exec " NETNS " ip link set rxdead1 down"))
+    {
+        Fail("could not take the link down");
+    }
+
+    uint64_t down_ns = monotonic_ns();
+
+    // Until keepalive probes go unanswered the client may only be slow, so newcomers wait.
+    uint32_t refused = server_stats.refusedClients;
+    int early = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    struct sockaddr_in loopback = server_address;
+    inet_pton(AF_INET, "127.0.0.1", &loopback.sin_addr);
+    connect(early, (struct sockaddr *)&loopback, sizeof(loopback));
+    if (!PumpUntil(NewClientRefused, &refused, 2000))
+    {
+        Fail("a client was replaced before keepalive gave up on it");
+    }
+    close(early);
+
+    Probes probes = {.probes = 2};
+    int keepalive_ms = (CLIENT_SESSION_KEEPALIVE_IDLE_S + CLIENT_SESSION_KEEPALIVE_INTERVAL_S * 2 + 2) * 1000;
+    if (!PumpUntil(KeepaliveUnanswered, &probes, keepalive_ms))
+    {
+        Fail("keepalive probes were never sent to the silent client");
+    }
+
+    // No takeover policy is configured, so only the failing keepalive lets this client in.
+    uint32_t takeovers = server_stats.takeovers;
+    int fresh = Connect("127.0.0.1");
+    if (server_stats.takeovers != takeovers + 1)
+    {
+        Fail("the new client was not let in by a takeover");
+    }
+    Ping(fresh);
+
+    printf("unresponsive: stale client replaced %.1f s after its link went down\n",
+           (double)(monotonic_ns() - down_ns) / 1e9);
+    close(stale);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc == 2 && strcmp(argv[1], "reset") == 0)
+    {
+        return TestReset();
+    }
+    if (argc == 2 && strcmp(argv[1], "unresponsive") == 0)
+    {
+        return TestUnresponsive();
+    }
+
+    fprintf(stderr, "usage: %s reset|unresponsive\n", argv[0]);
+    return 2;
+}
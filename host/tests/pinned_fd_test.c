@@ -0,0 +1,200 @@
+/* Closing a descriptor that work running on the device still uses.
+
+       pinned_fd_test rule         A rule drives a GPIO. Closing the GPIO must fail with EBUSY,
+                                   so a later open cannot reuse the number the rule still
+                                   writes to.
+       pinned_fd_test acquisition  The same for an ADC polled by an acquisition plan.
+
+   Commands are dispatched in-process, without a client connection. Exits 0 on success and 1
+   on failure. */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <applibs/eventloop.h>
+
+#include "echo_tcp_server.h"
+#include "timer_wheel.h"
+
+static void Fail(const char *message)
+{
+    fprintf(stderr, "FAIL: %s\n", message);
+    exit(1);
+}
+
+static void InitHeader(CTX_HEADER *header, SOCKET_CMD cmd, size_t length)
+{
+    memset(header, 0, sizeof(*header));
+    header->block_length = (uint16_t)length;
+    header->response_length = (uint16_t)length;
+    header->cmd = cmd;
+    header->respond = true;
+    header->contract_version = REMOTEX_CONTRACT_VERSION;
+}
+
+static void Setup(void)
+{
+    EventLoop *event_loop = EventLoop_Create();
+    TimerWheel_SetDefault(TimerWheel_Create(event_loop, TIMER_WHEEL_DEFAULT_TICK_US));
+    ledger_initialize();
+}
+
+static int OpenOutput(int gpioId)
+{
+    GPIO_OpenAsOutput_t open;
+
+    InitHeader(&open.header, GPIO_OpenAsOutput_c, sizeof(open));
+    open.gpioId = gpioId;
+    open.outputMode = GPIO_OutputMode_PushPull;
+    open.initialValue = GPIO_Value_Low;
+    dispatch_command((uint8_t *)&open, sizeof(open));
+
+    if (open.header.returns < 0)
+    {
+        Fail("could not open a GPIO");
+    }
+    return open.header.returns;
+}
+
+/// <summary>
+/// Close fd through the command path and return the command's result, with errno set to the
+/// error it reported.
+/// </summary>
+static int Close(int fd)
+{
+    RemoteX_Close_t close;
+
+    InitHeader(&close.header, RemoteX_Close_c, sizeof(close));
+    close.fd = fd;
+    dispatch_command((uint8_t *)&close, sizeof(close));
+
+    errno = close.header.err_no;
+    return close.header.returns;
+}
+
+/// <summary>
+/// A pinned fd must survive a close request, and an open after it must get a new number.
+/// </summary>
+static void CheckPinned(int fd, int freeGpioId)
+{
+    if (Close(fd) != -1 || errno != EBUSY)
+    {
+        Fail("a pinned fd was closed");
+    }
+
+    int other = OpenOutput(freeGpioId);
+    if (other == fd)
+    {
+        Fail("an open reused the number of a pinned fd");
+    }
+    if (!ledger_contains(fd) || !ledger_pinned(fd))
+    {
+        Fail("the refused close dropped the fd from the ledger");
+    }
+    Close(other);
+}
+
+static int TestRule(void)
+{
+    RemoteX_Rules_t rules;
+
+    Setup();
+    int source = OpenOutput(1);
+    int action = OpenOutput(2);
+
+    InitHeader(&rules.header, RemoteX_Rules_c, sizeof(rules));
+    rules.op = RuleOp_Add;
+    rules.rule.condition = RuleCondition_GpioHigh;
+    rules.rule.sourceFd = source;
+    rules.rule.samples = 1;
+    rules.rule.action = RuleAction_SetGpio;
+    rules.rule.actionFd = action;
+    rules.rule.enabled = true;
+    dispatch_command((uint8_t *)&rules, sizeof(rules));
+    if (rules.header.returns <= 0)
+    {
+        Fail("could not add the rule");
+    }
+    uint32_t id = (uint32_t)rules.header.returns;
+
+    CheckPinned(source, 3);
+    CheckPinned(action, 3);
+
+    InitHeader(&rules.header, RemoteX_Rules_c, sizeof(rules));
+    rules.op = RuleOp_Remove;
+    rules.id = id;
+    dispatch_command((uint8_t *)&rules, sizeof(rules));
+
+    if (Close(action) != 0 || Close(source) != 0 || ledger_contains(action) || ledger_contains(source))
+    {
+        Fail("fds were not released with the rule");
+    }
+
+    printf("rule: close refused while the rule was armed, allowed after it was removed\n");
+    return 0;
+}
+
+static int TestAcquisition(void)
+{
+    static RemoteX_Acquisition_t acquisition;
+    ADC_Open_t open;
+    ADC_Poll_t poll;
+    AcquisitionEntry_t entry = {.periodUs = 100000};
+
+    Setup();
+    InitHeader(&open.header, ADC_Open_c, sizeof(open));
+    open.id = 0;
+    dispatch_command((uint8_t *)&open, sizeof(open));
+    int adc = open.header.returns;
+    if (adc < 0)
+    {
+        Fail("could not open the ADC");
+    }
+
+    InitHeader(&poll.header, ADC_Poll_c, sizeof(poll));
+    poll.fd = adc;
+    poll.channel = 0;
+
+    InitHeader(&acquisition.header, RemoteX_Acquisition_c, sizeof(acquisition));
+    acquisition.op = AcquisitionOp_Install;
+    acquisition.entryCount = 1;
+    acquisition.length = sizeof(entry) + sizeof(poll);
+    memcpy(acquisition.data_block.data, &entry, sizeof(entry));
+    memcpy(acquisition.data_block.data + sizeof(entry), &poll, sizeof(poll));
+    dispatch_command((uint8_t *)&acquisition, sizeof(acquisition));
+    if (acquisition.header.returns != 0)
+    {
+        Fail("could not install the plan");
+    }
+
+    CheckPinned(adc, 3);
+
+    InitHeader(&acquisition.header, RemoteX_Acquisition_c, sizeof(acquisition));
+    acquisition.op = AcquisitionOp_Stop;
+    dispatch_command((uint8_t *)&acquisition, sizeof(acquisition));
+
+    if (Close(adc) != 0 || ledger_contains(adc))
+    {
+        Fail("the ADC was not released with the plan");
+    }
+
+    printf("acquisition: close refused while the plan ran, allowed after it stopped\n");
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc == 2 && strcmp(argv[1], "rule") == 0)
+    {
+        return TestRule();
+    }
+    if (argc == 2 && strcmp(argv[1], "acquisition") == 0)
+    {
+        return TestAcquisition();
+    }
+
+    fprintf(stderr, "usage: %s rule|acquisition\n", argv[0]);
+    return 2;
+}
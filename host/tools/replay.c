@@ -0,0 +1,505 @@
+/* Replays a capture recorded with REMOTEX_CAPTURE against a server and compares the results and
+   timing with the original session.
+
+   Requests are sent in their captured order, either at their original pace or as fast as the
+   server answers. Each response's returns, and err_no when the command failed, must match the
+   captured response. Payload differences are counted but not failed, because sensors and
+   timestamps differ from run to run. Descriptors returned by open commands are mapped to the
+   replayed server's values and substituted in later requests whose first field is a descriptor.
+
+   Captured times are the server's, from request received to response sent. Replayed times are
+   round trips seen by this tool, so they also include the network and the kernel.
+
+       replay capture.rxcap [--speed original|max|<factor>] [--host 127.0.0.1] [--port 8888]
+
+   Exits with 1 if any response did not match. */
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "capture.h"
+#include "contract.h"
+
+#define MAX_MAPPED_FDS 128
+#define MAX_CMDS 256
+
+typedef struct
+{
+    const CaptureRecord *record;
+    const uint8_t *frame;
+} Entry;
+
+typedef struct
+{
+    uint64_t requests;
+    uint64_t responses;
+    uint64_t mismatches;
+    uint64_t captured_ns;
+    uint64_t replayed_ns;
+} CommandStats;
+
+static const char *server_host = "127.0.0.1";
+static int server_port = 8888;
+static double speed; // 0 replays as fast as possible
+
+static int fd_map_from[MAX_MAPPED_FDS], fd_map_to[MAX_MAPPED_FDS];
+static size_t fd_map_count;
+
+static CommandStats command_stats[MAX_CMDS];
+static uint64_t *captured_latencies, *replayed_latencies;
+static size_t latency_count;
+static uint64_t payload_differences, pushes_received, pushes_captured;
+
+static uint64_t NowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+static void SleepUntil(uint64_t ns)
+{
+    uint64_t now = NowNs();
+    if (ns > now)
+    {
+        struct timespec delay = {.tv_sec = (time_t)((ns - now) / 1000000000), .tv_nsec = (long)((ns - now) % 1000000000)};
+        nanosleep(&delay, NULL);
+    }
+}
+
+static bool SendAll(int fd, const uint8_t *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t sent = send(fd, data, length, 0);
+        if (sent <= 0)
+        {
+            return false;
+        }
+        data += sent;
+        length -= (size_t)sent;
+    }
+    return true;
+}
+
+static bool ReceiveAll(int fd, uint8_t *data, size_t length)
+{
+    return length == 0 || recv(fd, data, length, MSG_WAITALL) == (ssize_t)length;
+}
+
+/// <summary>
+/// Read one frame from the server: a header, then the rest of header.response_length.
+/// </summary>
+static bool ReceiveFrame(int fd, uint8_t *frame, size_t size)
+{
+    CTX_HEADER *header = (CTX_HEADER *)frame;
+
+    if (!ReceiveAll(fd, frame, sizeof(*header)) || header->response_length < sizeof(*header) || header->response_length > size)
+    {
+        return false;
+    }
+    return ReceiveAll(fd, frame + sizeof(*header), header->response_length - sizeof(*header));
+}
+
+/// <summary>
+/// Connect, retrying while the server is still releasing the previous session.
+/// </summary>
+static int Connect(void)
+{
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons((uint16_t)server_port)};
+    inet_pton(AF_INET, server_host, &address.sin_addr);
+
+    for (int attempt = 0; attempt < 100; attempt++)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd != -1 && connect(fd, (struct sockaddr *)&address, sizeof(address)) == 0)
+        {
+            int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            return fd;
+        }
+        if (fd != -1)
+        {
+            close(fd);
+        }
+        usleep(50000);
+    }
+    return -1;
+}
+
+static bool IsOpenCommand(SOCKET_CMD cmd)
+{
+    switch (cmd)
+    {
+    case GPIO_OpenAsOutput_c:
+    case GPIO_OpenAsInput_c:
+    case I2CMaster_Open_c:
+    case SPIMaster_Open_c:
+    case PWM_Open_c:
+    case ADC_Open_c:
+    case Storage_OpenMutableFile_c:
+    case UART_Open_c:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void MapFd(int from, int to)
+{
+    for (size_t i = 0; i < fd_map_count; i++)
+    {
+        if (fd_map_from[i] == from)
+        {
+            fd_map_to[i] = to;
+            return;
+        }
+    }
+    if (fd_map_count < MAX_MAPPED_FDS)
+    {
+        fd_map_from[fd_map_count] = from;
+        fd_map_to[fd_map_count++] = to;
+    }
+}
+
+/// <summary>
+/// Substitute the replayed descriptor for a captured one in a request's first field. Returns
+/// true if the field was changed.
+/// </summary>
+static bool RewriteFd(uint8_t *frame, size_t length)
+{
+    int32_t fd;
+
+    if (IsOpenCommand(((CTX_HEADER *)frame)->cmd) || length < sizeof(CTX_HEADER) + sizeof(fd))
+    {
+        return false;
+    }
+
+    memcpy(&fd, frame + sizeof(CTX_HEADER), sizeof(fd));
+    for (size_t i = 0; i < fd_map_count; i++)
+    {
+        if (fd_map_from[i] == fd && fd_map_to[i] != fd)
+        {
+            memcpy(frame + sizeof(CTX_HEADER), &fd_map_to[i], sizeof(fd));
+            return true;
+        }
+    }
+    return false;
+}
+
+/// <summary>
+/// True if a replayed result matches the captured one. Open commands only need to agree on
+/// success, descriptor numbers differ between servers, and err_no only means something on failure.
+/// </summary>
+static bool SameResult(const CTX_HEADER *expected, const CTX_HEADER *actual)
+{
+    if (IsOpenCommand(expected->cmd) && expected->returns >= 0)
+    {
+        return actual->returns >= 0;
+    }
+    return expected->returns == actual->returns && (expected->returns != -1 || expected->err_no == actual->err_no);
+}
+
+/// <summary>
+/// The captured response to the request at index, skipping push frames, or NULL.
+/// </summary>
+static const Entry *FindCapturedResponse(const Entry *entries, size_t count, size_t index)
+{
+    for (size_t i = index + 1; i < count && entries[i].record->event != Capture_Received; i++)
+    {
+        if (entries[i].record->event == Capture_Sent && entries[i].record->length >= sizeof(CTX_HEADER) &&
+            ((const CTX_HEADER *)entries[i].frame)->respond)
+        {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+/// <summary>
+/// Send one captured request and compare the server's response with the captured one.
+/// Returns false if the connection failed.
+/// </summary>
+static bool ReplayRequest(int fd, const Entry *entries, size_t count, size_t index)
+{
+    static uint8_t request[sizeof(RemoteX_Push_t) + 1024], response[sizeof(RemoteX_Push_t) + 1024];
+    const Entry *entry = &entries[index];
+    const CTX_HEADER *captured_header = (const CTX_HEADER *)entry->frame;
+    CommandStats *stats = &command_stats[captured_header->cmd];
+
+    if (entry->record->length < sizeof(CTX_HEADER) || entry->record->length > sizeof(request))
+    {
+        return true;
+    }
+
+    memcpy(request, entry->frame, entry->record->length);
+    bool rewritten = RewriteFd(request, entry->record->length);
+
+    uint64_t sent_at = NowNs();
+    if (!SendAll(fd, request, entry->record->length))
+    {
+        return false;
+    }
+
+    stats->requests++;
+    if (!captured_header->respond)
+    {
+        return true;
+    }
+
+    // Push frames may arrive ahead of the response.
+    CTX_HEADER *header = (CTX_HEADER *)response;
+    do
+    {
+        if (!ReceiveFrame(fd, response, sizeof(response)))
+        {
+            return false;
+        }
+        pushes_received += !header->respond;
+    } while (!header->respond);
+
+    uint64_t replayed_ns = NowNs() - sent_at;
+    const Entry *captured = FindCapturedResponse(entries, count, index);
+    if (captured == NULL)
+    {
+        return true;
+    }
+
+    const CTX_HEADER *expected = (const CTX_HEADER *)captured->frame;
+    uint64_t captured_ns = captured->record->timeNs - entry->record->timeNs;
+
+    // Responses echo the request, so put the captured descriptor back before comparing payloads.
+    if (rewritten && header->response_length >= sizeof(CTX_HEADER) + sizeof(int32_t))
+    {
+        memcpy(response + sizeof(CTX_HEADER), entry->frame + sizeof(CTX_HEADER), sizeof(int32_t));
+    }
+
+    if (!SameResult(expected, header))
+    {
+        stats->mismatches++;
+        fprintf(stderr, "request %zu, cmd %d: returns %d errno %d, captured returns %d errno %d\n", index,
+                captured_header->cmd, header->returns, header->err_no, expected->returns, expected->err_no);
+    }
+    else if (captured->record->length != header->response_length ||
+             memcmp(captured->frame + sizeof(CTX_HEADER), response + sizeof(CTX_HEADER),
+                    captured->record->length - sizeof(CTX_HEADER)) != 0)
+    {
+        payload_differences++;
+    }
+
+    if (IsOpenCommand(captured_header->cmd) && expected->returns >= 0 && header->returns >= 0)
+    {
+        MapFd(expected->returns, header->returns);
+    }
+
+    stats->responses++;
+    stats->captured_ns += captured_ns;
+    stats->replayed_ns += replayed_ns;
+    captured_latencies[latency_count] = captured_ns;
+    replayed_latencies[latency_count++] = replayed_ns;
+    return true;
+}
+
+static int CompareU64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void PrintLatencies(const char *label, uint64_t *latencies)
+{
+    if (latency_count == 0)
+    {
+        return;
+    }
+
+    qsort(latencies, latency_count, sizeof(*latencies), CompareU64);
+    printf("  %-22s %10.1f %10.1f %10.1f\n", label, latencies[latency_count / 2] / 1000.0,
+           latencies[latency_count * 99 / 100] / 1000.0, latencies[latency_count - 1] / 1000.0);
+}
+
+/// <summary>
+/// Split the capture into records. Returns the number of records, or -1 if the file is not a
+/// capture this tool understands.
+/// </summary>
+static ssize_t ParseCapture(const uint8_t *data, size_t size, Entry **entries)
+{
+    const CaptureFileHeader *header = (const CaptureFileHeader *)data;
+    size_t count = 0, capacity = 0, offset = sizeof(*header);
+
+    if (size < sizeof(*header) || memcmp(header->magic, CAPTURE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->formatVersion != CAPTURE_FORMAT_VERSION)
+    {
+        return -1;
+    }
+
+    if (header->contractVersion != REMOTEX_CONTRACT_VERSION)
+    {
+        fprintf(stderr, "warning: captured with contract version %d, this tool uses %d\n", header->contractVersion,
+                REMOTEX_CONTRACT_VERSION);
+    }
+
+    *entries = NULL;
+    while (offset + sizeof(CaptureRecord) <= size)
+    {
+        const CaptureRecord *record = (const CaptureRecord *)(data + offset);
+        if (offset + sizeof(*record) + record->length > size)
+        {
+            break; // Truncated by a server that did not shut down cleanly
+        }
+
+        if (count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 1024;
+            *entries = realloc(*entries, capacity * sizeof(**entries));
+        }
+        (*entries)[count++] = (Entry){.record = record, .frame = data + offset + sizeof(*record)};
+        offset += sizeof(*record) + record->length;
+    }
+    return (ssize_t)count;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s capture [--speed original|max|<factor>] [--host address] [--port port]\n", argv[0]);
+        return 2;
+    }
+
+    for (int i = 2; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--host") == 0)
+        {
+            server_host = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--port") == 0)
+        {
+            server_port = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--speed") == 0)
+        {
+            speed = strcmp(argv[i + 1], "original") == 0 ? 1.0 : strcmp(argv[i + 1], "max") == 0 ? 0 : atof(argv[i + 1]);
+        }
+    }
+
+    FILE *file = fopen(argv[1], "rb");
+    if (file == NULL)
+    {
+        perror(argv[1]);
+        return 2;
+    }
+
+    fseek(file, 0, SEEK_END);
+    size_t size = (size_t)ftell(file);
+    uint8_t *data = malloc(size > 0 ? size : 1);
+    rewind(file);
+    size = fread(data, 1, size, file);
+    fclose(file);
+
+    Entry *entries;
+    ssize_t count = ParseCapture(data, size, &entries);
+    if (count < 0)
+    {
+        fprintf(stderr, "%s: not a RemoteX capture\n", argv[1]);
+        return 2;
+    }
+
+    captured_latencies = malloc(((size_t)count + 1) * sizeof(uint64_t));
+    replayed_latencies = malloc(((size_t)count + 1) * sizeof(uint64_t));
+
+    int fd = -1;
+    bool failed = false;
+    uint64_t start = NowNs(), captured_span = 0;
+
+    for (size_t i = 0; i < (size_t)count && !failed; i++)
+    {
+        const CaptureRecord *record = entries[i].record;
+        captured_span = record->timeNs;
+
+        switch (record->event)
+        {
+        case Capture_Connected:
+        case Capture_Disconnected:
+            if (fd != -1)
+            {
+                close(fd);
+                fd = -1;
+                // Give the server time to notice, it serves one client at a time.
+                usleep(50000);
+            }
+            break;
+
+        case Capture_Received:
+            if (speed > 0)
+            {
+                SleepUntil(start + (uint64_t)((double)record->timeNs / speed));
+            }
+            if (fd == -1 && (fd = Connect()) == -1)
+            {
+                fprintf(stderr, "could not connect to %s:%d\n", server_host, server_port);
+                failed = true;
+                break;
+            }
+            if (!ReplayRequest(fd, entries, (size_t)count, i))
+            {
+                fprintf(stderr, "request %zu: connection closed by the server\n", i);
+                failed = true;
+            }
+            break;
+
+        case Capture_Sent:
+            pushes_captured += record->length >= sizeof(CTX_HEADER) && !((const CTX_HEADER *)entries[i].frame)->respond;
+            break;
+        }
+    }
+
+    if (fd != -1)
+    {
+        close(fd);
+    }
+
+    uint64_t requests = 0, mismatches = 0;
+    for (size_t cmd = 0; cmd < MAX_CMDS; cmd++)
+    {
+        requests += command_stats[cmd].requests;
+        mismatches += command_stats[cmd].mismatches;
+    }
+
+    printf("requests %llu, responses compared %zu, mismatched %llu, payload differences %llu\n",
+           (unsigned long long)requests, latency_count, (unsigned long long)mismatches,
+           (unsigned long long)payload_differences);
+    printf("push frames: captured %llu, received %llu\n", (unsigned long long)pushes_captured,
+           (unsigned long long)pushes_received);
+    printf("duration: captured %.3f s, replayed %.3f s\n", captured_span / 1e9, (NowNs() - start) / 1e9);
+
+    printf("\n%-5s %9s %12s %14s %10s\n", "cmd", "requests", "server us", "round trip us", "mismatch");
+    for (size_t cmd = 0; cmd < MAX_CMDS; cmd++)
+    {
+        const CommandStats *stats = &command_stats[cmd];
+        if (stats->requests > 0)
+        {
+            double responses = stats->responses > 0 ? (double)stats->responses : 1;
+            printf("%-5zu %9llu %12.1f %14.1f %10llu\n", cmd, (unsigned long long)stats->requests,
+                   stats->captured_ns / 1000.0 / responses, stats->replayed_ns / 1000.0 / responses,
+                   (unsigned long long)stats->mismatches);
+        }
+    }
+
+    printf("\nresponse time us             p50        p99        max\n");
+    PrintLatencies("captured (server)", captured_latencies);
+    PrintLatencies("replayed (round trip)", replayed_latencies);
+
+    free(captured_latencies);
+    free(replayed_latencies);
+    free(entries);
+    free(data);
+    return failed || mismatches > 0 ? 1 : 0;
+}
@@ -0,0 +1,562 @@
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "kv_store.h"
+
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;
+    uint32_t generation;
+    uint32_t crc;
+} KvHalfHeader;
+
+// Each record's CRC covers the half's generation, so records left over from an older
+// use of a half are not mistaken for current ones after the end of the log.
+typedef struct __attribute__((packed))
+{
+    uint8_t keyLength;
+    uint8_t flags;
+    uint16_t valueLength;
+    uint32_t crc;
+} KvRecordHeader;
+
+_Static_assert(sizeof(KvRecordHeader) == KV_RECORD_OVERHEAD, "KV_RECORD_OVERHEAD is out of date");
+
+#define KV_RECORD_DELETED 0x01
+
+typedef struct
+{
+    uint32_t hash;
+    uint16_t offset; // Of the key's newest record in image
+} KvIndexEntry;
+
+static int storage_fd = -1;
+static int active_half = -1; // -1 until the file holds a store
+static uint32_t generation;
+static size_t tail;
+static size_t dead_bytes;
+static uint32_t compactions;
+static TimerWheelTimer compact_timer;
+
+// Mirror of the active half, so reads never touch flash.
+static uint8_t image[KV_HALF_BYTES];
+static KvIndexEntry index_entries[KV_MAX_KEYS];
+static size_t key_count;
+
+static uint32_t crc32(uint32_t crc, const void *data, size_t length)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+
+    crc = ~crc;
+    while (length--)
+    {
+        crc ^= *bytes++;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t hash_key(const char *key, size_t length)
+{
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        hash = (hash ^ (uint8_t)key[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static KvRecordHeader *record_at(size_t offset)
+{
+    return (KvRecordHeader *)(image + offset);
+}
+
+static size_t record_size(const KvRecordHeader *record)
+{
+    return sizeof(KvRecordHeader) + record->keyLength + record->valueLength;
+}
+
+static uint32_t record_crc(const KvRecordHeader *record, uint32_t record_generation)
+{
+    KvRecordHeader copy = *record;
+    copy.crc = 0;
+
+    uint32_t crc = crc32(0, &record_generation, sizeof(record_generation));
+    crc = crc32(crc, &copy, sizeof(copy));
+    return crc32(crc, record + 1, (size_t)record->keyLength + record->valueLength);
+}
+
+static int find_key(const char *key, size_t length)
+{
+    uint32_t hash = hash_key(key, length);
+
+    for (size_t i = 0; i < key_count; i++)
+    {
+        const KvRecordHeader *record = record_at(index_entries[i].offset);
+
+        if (index_entries[i].hash == hash && record->keyLength == length && memcmp(record + 1, key, length) == 0)
+        {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+/// <summary>
+/// Point the index at the record at offset, which replaces or deletes any earlier record
+/// for the same key.
+/// </summary>
+static void index_record(size_t offset)
+{
+    const KvRecordHeader *record = record_at(offset);
+    const char *key = (const char *)(record + 1);
+    int position = find_key(key, record->keyLength);
+
+    if (position >= 0)
+    {
+        dead_bytes += record_size(record_at(index_entries[position].offset));
+    }
+
+    if (record->flags & KV_RECORD_DELETED)
+    {
+        dead_bytes += record_size(record);
+        if (position >= 0)
+        {
+            index_entries[position] = index_entries[--key_count];
+        }
+    }
+    else if (position >= 0)
+    {
+        index_entries[position].offset = (uint16_t)offset;
+    }
+    else if (key_count < KV_MAX_KEYS)
+    {
+        index_entries[key_count].hash = hash_key(key, record->keyLength);
+        index_entries[key_count++].offset = (uint16_t)offset;
+    }
+    else
+    {
+        dead_bytes += record_size(record);
+    }
+}
+
+/// <summary>
+/// Replay the active half's log into the index. The log ends at the first record that is
+/// blank, malformed or fails its CRC, which also discards a record torn by a power cut.
+/// </summary>
+static void rebuild_index(void)
+{
+    key_count = 0;
+    dead_bytes = 0;
+    tail = sizeof(KvHalfHeader);
+
+    while (tail + sizeof(KvRecordHeader) <= KV_HALF_BYTES)
+    {
+        const KvRecordHeader *record = record_at(tail);
+
+        if (record->keyLength == 0 || record->keyLength > KV_MAX_KEY_LENGTH ||
+            record->valueLength > KV_MAX_VALUE_LENGTH || tail + record_size(record) > KV_HALF_BYTES ||
+            record->crc != record_crc(record, generation))
+        {
+            break;
+        }
+
+        index_record(tail);
+        tail += record_size(record);
+    }
+
+    memset(image + tail, 0, KV_HALF_BYTES - tail);
+}
+
+static off_t half_offset(int half)
+{
+    return (off_t)KV_REGION_OFFSET + (off_t)half * KV_HALF_BYTES;
+}
+
+static bool read_half_header(int half, KvHalfHeader *header)
+{
+    return pread(storage_fd, header, sizeof(*header), half_offset(half)) == sizeof(*header) &&
+           header->magic == KV_MAGIC &&
+           header->crc == crc32(0, header, offsetof(KvHalfHeader, crc));
+}
+
+static int write_half_header(int half, uint32_t half_generation)
+{
+    KvHalfHeader header = {.magic = KV_MAGIC, .generation = half_generation};
+    header.crc = crc32(0, &header, offsetof(KvHalfHeader, crc));
+
+    if (pwrite(storage_fd, &header, sizeof(header), half_offset(half)) != sizeof(header) ||
+        fsync(storage_fd) == -1)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+static void load(void)
+{
+    KvHalfHeader headers[2];
+    bool valid[2] = {read_half_header(0, &headers[0]), read_half_header(1, &headers[1])};
+
+    active_half = -1;
+    key_count = 0;
+    memset(image, 0, sizeof(image));
+
+    if (!valid[0] && !valid[1])
+    {
+        return;
+    }
+
+    active_half = valid[0] && (!valid[1] || headers[0].generation > headers[1].generation) ? 0 : 1;
+    generation = headers[active_half].generation;
+
+    if (pread(storage_fd, image, sizeof(image), half_offset(active_half)) == -1)
+    {
+        active_half = -1;
+        return;
+    }
+
+    rebuild_index();
+}
+
+void Kv_Initialize(void)
+{
+    if ((storage_fd = Storage_OpenMutableFile()) == -1)
+    {
+        Log_Debug("Key value store unavailable, mutable storage did not open (%d)\n", errno);
+        return;
+    }
+
+    load();
+}
+
+/// <summary>
+/// True if both halves read as zeros, or lie past the end of the file.
+/// </summary>
+static bool region_blank(void)
+{
+    for (int half = 0; half < 2; half++)
+    {
+        ssize_t length = pread(storage_fd, image, sizeof(image), half_offset(half));
+
+        if (length == -1)
+        {
+            return false;
+        }
+
+        for (ssize_t i = 0; i < length; i++)
+        {
+            if (image[i] != 0)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/// <summary>
+/// Claim the region for a new store. Data a client stored in it is never overwritten.
+/// </summary>
+static int format(void)
+{
+    if (storage_fd == -1)
+    {
+        errno = ENODEV;
+        return -1;
+    }
+
+    if (!region_blank())
+    {
+        memset(image, 0, sizeof(image));
+        errno = ENOTEMPTY;
+        return -1;
+    }
+
+    memset(image, 0, sizeof(image));
+    generation = 1;
+    key_count = 0;
+    dead_bytes = 0;
+    tail = sizeof(KvHalfHeader);
+
+    if (write_half_header(0, generation) == -1)
+    {
+        return -1;
+    }
+
+    active_half = 0;
+    return 0;
+}
+
+static bool is_live(size_t offset, int *position)
+{
+    for (size_t i = 0; i < key_count; i++)
+    {
+        if (index_entries[i].offset == offset)
+        {
+            *position = (int)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/// <summary>
+/// Slide the live records down over the dead ones and write them to the other half under
+/// the next generation. Its header is written last, so until then the current half is the
+/// one found at startup.
+/// </summary>
+static int compact(void)
+{
+    size_t offset = sizeof(KvHalfHeader);
+    size_t write_at = sizeof(KvHalfHeader);
+    uint32_t next_generation = generation + 1;
+    int next_half = 1 - active_half;
+    int position;
+
+    TimerWheel_Cancel(&compact_timer);
+
+    while (offset < tail)
+    {
+        KvRecordHeader *record = record_at(offset);
+        size_t size = record_size(record);
+
+        if (is_live(offset, &position))
+        {
+            memmove(image + write_at, record, size);
+            index_entries[position].offset = (uint16_t)write_at;
+            record_at(write_at)->crc = record_crc(record_at(write_at), next_generation);
+            write_at += size;
+        }
+        offset += size;
+    }
+
+    memset(image + write_at, 0, KV_HALF_BYTES - write_at);
+
+    if (pwrite(storage_fd, image + sizeof(KvHalfHeader), write_at - sizeof(KvHalfHeader),
+               half_offset(next_half) + (off_t)sizeof(KvHalfHeader)) == -1 ||
+        fsync(storage_fd) == -1 || write_half_header(next_half, next_generation) == -1)
+    {
+        // The mirror no longer matches the active half; start again from flash.
+        int error = errno;
+        load();
+        errno = error;
+        return -1;
+    }
+
+    active_half = next_half;
+    generation = next_generation;
+    tail = write_at;
+    dead_bytes = 0;
+    compactions++;
+    return 0;
+}
+
+static void HandleCompactDue(TimerWheelTimer *timer, void *context)
+{
+    if (dead_bytes >= KV_COMPACT_DEAD_BYTES)
+    {
+        compact();
+    }
+}
+
+/// <summary>
+/// Compaction waits until writes have been quiet for a while, so a burst of updates is
+/// not interrupted by a rewrite of the whole half.
+/// </summary>
+static void schedule_compaction(void)
+{
+    if (dead_bytes >= KV_COMPACT_DEAD_BYTES && TimerWheel_Default() != NULL)
+    {
+        TimerWheel_Cancel(&compact_timer);
+        TimerWheel_InitTimer(&compact_timer, HandleCompactDue, NULL);
+        TimerWheel_StartOneShot(TimerWheel_Default(), &compact_timer, KV_COMPACT_DELAY_US);
+    }
+}
+
+/// <summary>
+/// Append a record to the log, compacting first if the active half is full.
+/// </summary>
+static int append(const char *key, size_t key_length, const void *value, size_t value_length, uint8_t flags)
+{
+    size_t size = sizeof(KvRecordHeader) + key_length + value_length;
+
+    if (active_half == -1 && format() == -1)
+    {
+        return -1;
+    }
+
+    if (tail + size > KV_HALF_BYTES && (compact() == -1 || tail + size > KV_HALF_BYTES))
+    {
+        errno = errno == 0 ? ENOSPC : errno;
+        return -1;
+    }
+
+    KvRecordHeader *record = record_at(tail);
+    record->keyLength = (uint8_t)key_length;
+    record->flags = flags;
+    record->valueLength = (uint16_t)value_length;
+    memcpy(record + 1, key, key_length);
+    memcpy((uint8_t *)(record + 1) + key_length, value, value_length);
+    record->crc = record_crc(record, generation);
+
+    if (pwrite(storage_fd, record, size, half_offset(active_half) + (off_t)tail) != (ssize_t)size ||
+        fsync(storage_fd) == -1)
+    {
+        memset(record, 0, size);
+        return -1;
+    }
+
+    index_record(tail);
+    tail += size;
+    schedule_compaction();
+    return 0;
+}
+
+int Kv_Get(const char *key, void *value, size_t size)
+{
+    int position = find_key(key, strnlen(key, KV_MAX_KEY_LENGTH));
+
+    if (position < 0)
+    {
+        errno = ENOENT;
+        return -1;
+    }
+
+    const KvRecordHeader *record = record_at(index_entries[position].offset);
+
+    if (record->valueLength > size)
+    {
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    memcpy(value, (const uint8_t *)(record + 1) + record->keyLength, record->valueLength);
+    return record->valueLength;
+}
+
+int Kv_Put(const char *key, const void *value, size_t length)
+{
+    size_t key_length = strnlen(key, KV_MAX_KEY_LENGTH);
+    int position = find_key(key, key_length);
+
+    if (key_length == 0 || length > KV_MAX_VALUE_LENGTH)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (position < 0 && key_count == KV_MAX_KEYS)
+    {
+        errno = ENOSPC;
+        return -1;
+    }
+
+    // Rewriting an unchanged value would only wear the flash.
+    if (position >= 0)
+    {
+        const KvRecordHeader *record = record_at(index_entries[position].offset);
+
+        if (record->valueLength == length && memcmp((const uint8_t *)(record + 1) + key_length, value, length) == 0)
+        {
+            return 0;
+        }
+    }
+
+    errno = 0;
+    return append(key, key_length, value, length, 0);
+}
+
+int Kv_Delete(const char *key)
+{
+    size_t key_length = strnlen(key, KV_MAX_KEY_LENGTH);
+
+    if (find_key(key, key_length) < 0)
+    {
+        errno = ENOENT;
+        return -1;
+    }
+
+    errno = 0;
+    return append(key, key_length, NULL, 0, KV_RECORD_DELETED);
+}
+
+static int list_keys(RemoteX_Kv_t *data)
+{
+    size_t length = 0;
+    int count = 0;
+    size_t i = data->cursor;
+
+    for (; i < key_count; i++)
+    {
+        const KvRecordHeader *record = record_at(index_entries[i].offset);
+
+        if (length + record->keyLength + 1 > sizeof(data->data_block.data))
+        {
+            break;
+        }
+
+        memcpy(data->data_block.data + length, record + 1, record->keyLength);
+        length += record->keyLength;
+        data->data_block.data[length++] = '\0';
+        count++;
+    }
+
+    data->cursor = i < key_count ? (uint16_t)i : 0;
+    data->length = (uint16_t)length;
+    return count;
+}
+
+DEFINE_CMD(RemoteX_Kv, data, nread)
+{
+    switch (data->op)
+    {
+    case KvOp_Get:
+        data->header.returns = Kv_Get(data->key, data->data_block.data, sizeof(data->data_block.data));
+        data->length = data->header.returns == -1 ? 0 : (uint16_t)data->header.returns;
+        break;
+
+    case KvOp_Put:
+        if (VARIABLE_BLOCK_SIZE(RemoteX_Kv, data->length) > nread)
+        {
+            data->header.returns = -1;
+            errno = EINVAL;
+        }
+        else
+        {
+            data->header.returns = Kv_Put(data->key, data->data_block.data, data->length);
+        }
+        break;
+
+    case KvOp_Delete:
+        data->header.returns = Kv_Delete(data->key);
+        break;
+
+    case KvOp_List:
+        data->header.returns = list_keys(data);
+        break;
+
+    case KvOp_Stats:
+        data->header.returns = 0;
+        break;
+
+    default:
+        data->header.returns = -1;
+        errno = EINVAL;
+        break;
+    }
+
+    data->stats.formatted = active_half != -1;
+    data->stats.keys = (uint32_t)key_count;
+    data->stats.usedBytes = active_half != -1 ? (uint32_t)tail : 0;
+    data->stats.liveBytes = active_half != -1 ? (uint32_t)(tail - dead_bytes - sizeof(KvHalfHeader)) : 0;
+    data->stats.capacityBytes = KV_HALF_BYTES - sizeof(KvHalfHeader);
+    data->stats.generation = generation;
+    data->stats.compactions = compactions;
+}
+END_CMD
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "peripherals.h"
+#include "timer_wheel.h"
+
+// The store keeps to a region at the end of the app's mutable storage, as sized in
+// app_manifest.json, so it never touches data the Storage_ commands keep below
+// KV_REGION_OFFSET. The region is split into two halves. Records are appended to the
+// active half; compaction copies the live records into the other half under a higher
+// generation, so a power cut during compaction leaves the previous half intact.
+#define KV_STORAGE_SIZE (64 * 1024)
+#define KV_REGION_BYTES (40 * 1024)
+#define KV_REGION_OFFSET (KV_STORAGE_SIZE - KV_REGION_BYTES)
+#define KV_HALF_BYTES (KV_REGION_BYTES / 2)
+#define KV_MAGIC 0x564B5852 // "RXKV"
+
+// Bytes each record stores besides its key and value.
+#define KV_RECORD_OVERHEAD 8
+
+#define KV_MAX_KEYS 128
+#define KV_MAX_VALUE_LENGTH 2048
+
+// Compact in the background once this much of the active half holds overwritten or
+// deleted records, after writes have been quiet for KV_COMPACT_DELAY_US.
+#define KV_COMPACT_DEAD_BYTES (KV_HALF_BYTES / 4)
+#define KV_COMPACT_DELAY_US 500000
+
+/// <summary>
+///     <para>Open the mutable storage file and build the in-RAM index. Called once at startup.</para>
+///     <para>A region that does not hold a store is left untouched until the first put, which
+///     formats it. A region holding anything but zeros is not formatted, and puts fail with
+///     ENOTEMPTY until the client clears it or deletes the file.</para>
+/// </summary>
+void Kv_Initialize(void);
+
+/// <summary>
+/// Copy the value of key into value. Returns the value's length, or -1 with errno set to
+/// ENOENT if there is no such key or ENOBUFS if size is too small.
+/// </summary>
+int Kv_Get(const char *key, void *value, size_t size);
+
+/// <summary>
+/// Store value under key, replacing any previous value. Returns 0, or -1 with errno set.
+/// </summary>
+int Kv_Put(const char *key, const void *value, size_t length);
+
+int Kv_Delete(const char *key);
+
+DECLARE_CMD(RemoteX_Kv);
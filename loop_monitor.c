@@ -0,0 +1,265 @@
+#include <applibs/log.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include "eventloop_timer_utilities.h"
+#include "flow_control.h"
+#include "loop_monitor.h"
+#include "timer_wheel.h"
+
+// Log scale histogram in microseconds: four buckets per power of two, so a percentile read
+// back as a bucket's upper bound is within 25% of the true value.
+#define HISTOGRAM_BUCKETS 128
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t max;
+    uint32_t buckets[HISTOGRAM_BUCKETS];
+} Histogram;
+
+static Histogram lag_histogram;
+static Histogram callback_histogram;
+
+static bool enabled = true;
+static uint32_t lag_threshold_us = LOOP_MONITOR_DEFAULT_LAG_US;
+static uint32_t callback_threshold_us = LOOP_MONITOR_DEFAULT_CALLBACK_US;
+static uint32_t push_interval_ms = LOOP_MONITOR_DEFAULT_PUSH_INTERVAL_MS;
+
+// The window that decides whether the next one sheds load.
+static uint64_t window_start_ns;
+static uint32_t window_timers;
+static uint32_t window_late_timers;
+static uint32_t window_slow_callbacks;
+
+static bool shedding;
+static uint32_t overloaded_windows;
+static uint32_t shed_requests;
+
+static uint64_t monotonic_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+static uint32_t to_us(uint64_t ns)
+{
+    uint64_t us = ns / 1000;
+    return us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+}
+
+static int bucket_of(uint32_t us)
+{
+    if (us < 4)
+    {
+        return (int)us;
+    }
+
+    int log = 31 - __builtin_clz(us);
+    return (log - 1) * 4 + (int)((us >> (log - 2)) & 3);
+}
+
+static uint32_t bucket_upper_us(int bucket)
+{
+    if (bucket < 4)
+    {
+        return (uint32_t)bucket;
+    }
+
+    int log = bucket / 4 + 1;
+    return (uint32_t)((((uint64_t)4 + bucket % 4 + 1) << (log - 2)) - 1);
+}
+
+static void histogram_add(Histogram *histogram, uint32_t us)
+{
+    histogram->count++;
+    histogram->buckets[bucket_of(us)]++;
+    if (us > histogram->max)
+    {
+        histogram->max = us;
+    }
+}
+
+static uint32_t histogram_percentile(const Histogram *histogram, uint32_t percent)
+{
+    uint64_t rank = ((uint64_t)histogram->count * percent + 99) / 100;
+    uint64_t seen = 0;
+
+    if (histogram->count == 0)
+    {
+        return 0;
+    }
+
+    for (int bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++)
+    {
+        seen += histogram->buckets[bucket];
+        if (seen >= rank)
+        {
+            uint32_t upper = bucket_upper_us(bucket);
+            return upper < histogram->max ? upper : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+static void set_shedding(bool value)
+{
+    if (value == shedding)
+    {
+        return;
+    }
+
+    shedding = value;
+    FlowControl_SetPushInterval(shedding ? push_interval_ms : 0);
+    Log_Debug("INFO: Event loop %s, %s shedding load.\n", shedding ? "overloaded" : "recovered",
+              shedding ? "started" : "stopped");
+}
+
+/// <summary>
+/// Close the window once it has lasted LOOP_MONITOR_WINDOW_MS. The window is overloaded if more
+/// than 1% of its timers ran later than the lag threshold, so its 99th percentile lag is over
+/// it, or if any callback ran longer than the callback threshold. A single long callback
+/// stalls everything else, so that one is not left to a percentile.
+/// </summary>
+static void roll_window(uint64_t now)
+{
+    if (now - window_start_ns < (uint64_t)LOOP_MONITOR_WINDOW_MS * 1000000)
+    {
+        return;
+    }
+
+    bool overloaded = (uint64_t)window_late_timers * 100 > window_timers || window_slow_callbacks > 0;
+
+    if (overloaded)
+    {
+        overloaded_windows++;
+    }
+    set_shedding(enabled && overloaded);
+
+    window_start_ns = now;
+    window_timers = 0;
+    window_late_timers = 0;
+    window_slow_callbacks = 0;
+}
+
+static void record_callback(uint32_t runUs)
+{
+    histogram_add(&callback_histogram, runUs);
+    if (runUs > callback_threshold_us)
+    {
+        window_slow_callbacks++;
+    }
+}
+
+void LoopMonitor_Timer(uint64_t lateNs, uint64_t runNs)
+{
+    uint32_t lateUs = to_us(lateNs);
+
+    histogram_add(&lag_histogram, lateUs);
+    window_timers++;
+    if (lateUs > lag_threshold_us)
+    {
+        window_late_timers++;
+    }
+
+    record_callback(to_us(runNs));
+    roll_window(monotonic_ns());
+}
+
+void LoopMonitor_Callback(uint64_t runNs)
+{
+    record_callback(to_us(runNs));
+    roll_window(monotonic_ns());
+}
+
+void LoopMonitor_Initialize(void)
+{
+    window_start_ns = monotonic_ns();
+    SetEventLoopTimerObserver(LoopMonitor_Timer);
+    TimerWheel_SetObserver(LoopMonitor_Timer);
+}
+
+bool LoopMonitor_Shedding(void)
+{
+    roll_window(monotonic_ns());
+    return shedding;
+}
+
+void LoopMonitor_Rejected(void)
+{
+    shed_requests++;
+}
+
+void LoopMonitor_Reset(void)
+{
+    memset(&lag_histogram, 0, sizeof(lag_histogram));
+    memset(&callback_histogram, 0, sizeof(callback_histogram));
+    overloaded_windows = 0;
+    shed_requests = 0;
+}
+
+void LoopMonitor_GetStats(LoopStats_t *stats)
+{
+    stats->timerRuns = lag_histogram.count;
+    stats->lagP50Us = histogram_percentile(&lag_histogram, 50);
+    stats->lagP90Us = histogram_percentile(&lag_histogram, 90);
+    stats->lagP99Us = histogram_percentile(&lag_histogram, 99);
+    stats->lagMaxUs = lag_histogram.max;
+    stats->callbacks = callback_histogram.count;
+    stats->callbackP50Us = histogram_percentile(&callback_histogram, 50);
+    stats->callbackP90Us = histogram_percentile(&callback_histogram, 90);
+    stats->callbackP99Us = histogram_percentile(&callback_histogram, 99);
+    stats->callbackMaxUs = callback_histogram.max;
+    stats->shedding = shedding;
+    stats->overloadedWindows = overloaded_windows;
+    stats->shedRequests = shed_requests;
+}
+
+DEFINE_CMD(RemoteX_LoadShed, data, nread)
+{
+    data->header.returns = 0;
+
+    switch (data->op)
+    {
+    case LoadShed_Get:
+        break;
+
+    case LoadShed_Set:
+        enabled = data->enabled;
+        if (data->lagThresholdUs != 0)
+        {
+            lag_threshold_us = data->lagThresholdUs;
+        }
+        if (data->callbackThresholdUs != 0)
+        {
+            callback_threshold_us = data->callbackThresholdUs;
+        }
+        if (data->pushIntervalMs != 0)
+        {
+            push_interval_ms = data->pushIntervalMs;
+            if (shedding)
+            {
+                FlowControl_SetPushInterval(push_interval_ms);
+            }
+        }
+        if (!enabled)
+        {
+            set_shedding(false);
+        }
+        break;
+
+    default:
+        data->header.returns = -1;
+        errno = EINVAL;
+        break;
+    }
+
+    data->enabled = enabled;
+    data->lagThresholdUs = lag_threshold_us;
+    data->callbackThresholdUs = callback_threshold_us;
+    data->pushIntervalMs = (uint16_t)push_interval_ms;
+    data->shedding = shedding;
+}
+END_CMD
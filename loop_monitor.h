@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "peripherals.h"
+
+// Event loop health. Timer lateness and callback run times feed percentile histograms reported
+// by RemoteX_GetStats. A window of LOOP_MONITOR_WINDOW_MS that goes over a threshold sheds load
+// for the next window: see RemoteX_LoadShed_t.
+#define LOOP_MONITOR_WINDOW_MS 250
+#define LOOP_MONITOR_DEFAULT_LAG_US 20000
+#define LOOP_MONITOR_DEFAULT_CALLBACK_US 100000
+#define LOOP_MONITOR_DEFAULT_PUSH_INTERVAL_MS 50
+
+/// <summary>
+/// Observe the event loop timer utilities and the timer wheels. Called when the server starts.
+/// </summary>
+void LoopMonitor_Initialize(void);
+
+/// <summary>
+/// Record a timer handler that started lateNs after it was due and took runNs.
+/// </summary>
+void LoopMonitor_Timer(uint64_t lateNs, uint64_t runNs);
+
+/// <summary>
+/// Record a socket event callback that took runNs.
+/// </summary>
+void LoopMonitor_Callback(uint64_t runNs);
+
+/// <summary>
+/// Returns true while load is being shed. Also closes the current window once it has run its course.
+/// </summary>
+bool LoopMonitor_Shedding(void);
+
+/// <summary>
+/// Count a request refused with EBUSY because load is being shed.
+/// </summary>
+void LoopMonitor_Rejected(void);
+
+/// <summary>
+/// Clear the percentiles and counters reported in the stats. Thresholds and the shedding state are kept.
+/// </summary>
+void LoopMonitor_Reset(void);
+
+void LoopMonitor_GetStats(LoopStats_t *stats);
+
+DECLARE_CMD(RemoteX_LoadShed);
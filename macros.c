@@ -0,0 +1,347 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "kv_store.h"
+#include "macros.h"
+
+// Macros outlive the client connection, so they are kept apart from the ledger. Frame
+// boundaries are found once when a macro is defined and not parsed again on invocation.
+typedef struct
+{
+    bool in_use;
+    char name[MACRO_NAME_LENGTH];
+    uint16_t length;
+    uint16_t frame_count;
+    uint16_t frame_offsets[MACRO_MAX_FRAMES + 1];
+    uint8_t frames[MACRO_MAX_BYTES];
+} Macro;
+
+// Saved under the key "macro/<id>", followed by the frames.
+typedef struct __attribute__((packed))
+{
+    char name[MACRO_NAME_LENGTH];
+    uint16_t length;
+} MacroRecord;
+
+_Static_assert(MACRO_MAX * (KV_RECORD_OVERHEAD + KV_MAX_KEY_LENGTH + sizeof(MacroRecord) + MACRO_MAX_BYTES) <= KV_HALF_BYTES,
+               "Saved macros do not fit in the key value store");
+
+static Macro macros[MACRO_MAX];
+
+// Frames are copied here to run because handlers write their response past the end of
+// the request, up to response_length.
+static uint8_t scratch[1024 * 5];
+static uint8_t patches[sizeof(DATA_BLOCK)];
+
+/// <summary>
+/// Check the frames and record where each starts. Macros cannot define or invoke macros.
+/// </summary>
+static bool index_frames(Macro *macro, const uint8_t *frames, size_t length)
+{
+    size_t offset = 0;
+
+    macro->frame_count = 0;
+
+    while (offset < length)
+    {
+        const CTX_HEADER *header = (const CTX_HEADER *)(frames + offset);
+
+        if (macro->frame_count == MACRO_MAX_FRAMES ||
+            length - offset < sizeof(CTX_HEADER) ||
+            header->block_length < sizeof(CTX_HEADER) ||
+            header->block_length > length - offset ||
+            header->response_length > sizeof(scratch) ||
+            header->cmd == RemoteX_Macro_c || header->cmd == RemoteX_MacroInvoke_c)
+        {
+            return false;
+        }
+
+        macro->frame_offsets[macro->frame_count++] = (uint16_t)offset;
+        offset += header->block_length;
+    }
+
+    macro->frame_offsets[macro->frame_count] = (uint16_t)length;
+    return length > 0;
+}
+
+static int define_macro(const char *name, const uint8_t *frames, size_t length, int id)
+{
+    Macro *macro = NULL;
+    Macro candidate;
+
+    if (length == 0 || length > MACRO_MAX_BYTES || !index_frames(&candidate, frames, length))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Replace the macro of the same name, else take the requested or first free id.
+    for (size_t i = 0; i < MACRO_MAX && id == 0; i++)
+    {
+        if (macros[i].in_use && strncmp(macros[i].name, name, MACRO_NAME_LENGTH) == 0)
+        {
+            id = (int)i + 1;
+        }
+    }
+    for (size_t i = 0; i < MACRO_MAX && id == 0; i++)
+    {
+        if (!macros[i].in_use)
+        {
+            id = (int)i + 1;
+        }
+    }
+
+    if (id < 1 || id > MACRO_MAX)
+    {
+        errno = ENOSPC;
+        return -1;
+    }
+
+    macro = &macros[id - 1];
+    *macro = candidate;
+    memcpy(macro->frames, frames, length);
+    strncpy(macro->name, name, MACRO_NAME_LENGTH);
+    macro->length = (uint16_t)length;
+    macro->in_use = true;
+
+    return id;
+}
+
+static Macro *find_macro(uint8_t id)
+{
+    if (id < 1 || id > MACRO_MAX || !macros[id - 1].in_use)
+    {
+        errno = ENOENT;
+        return NULL;
+    }
+    return &macros[id - 1];
+}
+
+static void macro_key(char *key, size_t size, size_t id)
+{
+    snprintf(key, size, "macro/%zu", id);
+}
+
+/// <summary>
+/// Store every macro in the key value store and remove the keys of deleted ones. Unchanged
+/// macros are not rewritten.
+/// </summary>
+static int save_macros(void)
+{
+    static uint8_t value[sizeof(MacroRecord) + MACRO_MAX_BYTES];
+    char key[KV_MAX_KEY_LENGTH];
+
+    for (size_t i = 0; i < MACRO_MAX; i++)
+    {
+        macro_key(key, sizeof(key), i + 1);
+
+        if (!macros[i].in_use)
+        {
+            if (Kv_Delete(key) == -1 && errno != ENOENT)
+            {
+                return -1;
+            }
+            continue;
+        }
+
+        MacroRecord *record = (MacroRecord *)value;
+        memcpy(record->name, macros[i].name, MACRO_NAME_LENGTH);
+        record->length = macros[i].length;
+        memcpy(record + 1, macros[i].frames, macros[i].length);
+
+        if (Kv_Put(key, value, sizeof(MacroRecord) + macros[i].length) == -1)
+        {
+            return -1;
+        }
+    }
+
+    errno = 0;
+    return 0;
+}
+
+void Macros_Load(void)
+{
+    static uint8_t value[sizeof(MacroRecord) + MACRO_MAX_BYTES];
+    char key[KV_MAX_KEY_LENGTH];
+
+    for (size_t i = 0; i < MACRO_MAX; i++)
+    {
+        macro_key(key, sizeof(key), i + 1);
+
+        int length = Kv_Get(key, value, sizeof(value));
+        const MacroRecord *record = (const MacroRecord *)value;
+
+        if (length >= (int)sizeof(MacroRecord) && record->length == length - (int)sizeof(MacroRecord))
+        {
+            define_macro(record->name, (const uint8_t *)(record + 1), record->length, (int)i + 1);
+        }
+    }
+}
+
+DEFINE_CMD(RemoteX_Macro, data, nread)
+{
+    Macro *macro = NULL;
+
+    data->header.returns = -1;
+
+    switch (data->op)
+    {
+    case MacroOp_Define:
+        if (VARIABLE_BLOCK_SIZE(RemoteX_Macro, data->length) > nread)
+        {
+            errno = EINVAL;
+            break;
+        }
+        data->header.returns = define_macro(data->name, data->data_block.data, data->length, 0);
+        if (data->header.returns != -1)
+        {
+            data->id = (uint8_t)data->header.returns;
+            data->frameCount = macros[data->id - 1].frame_count;
+        }
+        break;
+
+    case MacroOp_Delete:
+        if ((macro = find_macro(data->id)) != NULL)
+        {
+            macro->in_use = false;
+            data->header.returns = 0;
+        }
+        break;
+
+    case MacroOp_Status:
+        if ((macro = find_macro(data->id)) != NULL)
+        {
+            memcpy(data->name, macro->name, MACRO_NAME_LENGTH);
+            data->length = macro->length;
+            data->frameCount = macro->frame_count;
+            data->header.returns = 0;
+        }
+        break;
+
+    case MacroOp_Save:
+        data->header.returns = save_macros();
+        break;
+
+    default:
+        errno = EINVAL;
+        break;
+    }
+}
+END_CMD
+
+/// <summary>
+/// Check every patch before any frame runs, so an invocation either runs in full or not
+/// at all.
+/// </summary>
+static bool validate_patches(const Macro *macro, const uint8_t *patch_data, size_t length, uint8_t count)
+{
+    size_t offset = 0;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        const MacroPatch_t *patch = (const MacroPatch_t *)(patch_data + offset);
+
+        if (length - offset < sizeof(MacroPatch_t) || length - offset - sizeof(MacroPatch_t) < patch->length)
+        {
+            return false;
+        }
+
+        uint16_t frame = 0;
+        while (frame < macro->frame_count && macro->frame_offsets[frame + 1] <= patch->offset)
+        {
+            frame++;
+        }
+
+        if (frame == macro->frame_count ||
+            patch->offset < macro->frame_offsets[frame] + sizeof(CTX_HEADER) ||
+            patch->offset + patch->length > macro->frame_offsets[frame + 1])
+        {
+            return false;
+        }
+
+        offset += sizeof(MacroPatch_t) + patch->length;
+    }
+
+    return true;
+}
+
+static void apply_patches(uint16_t frame_start, uint16_t frame_end, uint8_t count)
+{
+    size_t offset = 0;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        const MacroPatch_t *patch = (const MacroPatch_t *)(patches + offset);
+
+        if (patch->offset >= frame_start && patch->offset < frame_end)
+        {
+            memcpy(scratch + (patch->offset - frame_start), patch + 1, patch->length);
+        }
+
+        offset += sizeof(MacroPatch_t) + patch->length;
+    }
+}
+
+static int invoke_macro(RemoteX_MacroInvoke_t *data, size_t patch_length)
+{
+    Macro *macro = find_macro(data->id);
+    size_t response_space = 0;
+
+    if (macro == NULL)
+    {
+        return -1;
+    }
+
+    // The responses are written over the patches, so keep a copy to apply from.
+    memcpy(patches, data->data_block.data, patch_length);
+    if (!validate_patches(macro, patches, patch_length, data->patchCount))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (data->header.response_length > VARIABLE_BLOCK_SIZE(RemoteX_MacroInvoke, 0))
+    {
+        response_space = (size_t)(data->header.response_length - VARIABLE_BLOCK_SIZE(RemoteX_MacroInvoke, 0));
+        response_space = response_space < sizeof(DATA_BLOCK) ? response_space : sizeof(DATA_BLOCK);
+    }
+
+    for (uint16_t i = 0; i < macro->frame_count; i++)
+    {
+        uint16_t start = macro->frame_offsets[i];
+        uint16_t end = macro->frame_offsets[i + 1];
+        CTX_HEADER *header = (CTX_HEADER *)scratch;
+
+        memcpy(scratch, macro->frames + start, end - start);
+        apply_patches(start, end, data->patchCount);
+        dispatch_command(scratch, end - start);
+        data->framesExecuted++;
+
+        if (header->respond && data->responsesLength + header->response_length <= response_space)
+        {
+            memcpy(data->data_block.data + data->responsesLength, scratch, header->response_length);
+            data->responsesLength += header->response_length;
+        }
+    }
+
+    return 0;
+}
+
+DEFINE_CMD(RemoteX_MacroInvoke, data, nread)
+{
+    ssize_t patch_length = nread - VARIABLE_BLOCK_SIZE(RemoteX_MacroInvoke, 0);
+
+    data->framesExecuted = 0;
+    data->responsesLength = 0;
+
+    if (patch_length < 0 || (size_t)patch_length > sizeof(patches))
+    {
+        data->header.returns = -1;
+        errno = EINVAL;
+    }
+    else
+    {
+        data->header.returns = invoke_macro(data, (size_t)patch_length);
+    }
+}
+END_CMD
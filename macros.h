@@ -0,0 +1,16 @@
+#pragma once
+
+#include "peripherals.h"
+
+#define MACRO_MAX 16
+#define MACRO_MAX_BYTES 1024
+#define MACRO_MAX_FRAMES 64
+
+/// <summary>
+/// Restore macros saved with MacroOp_Save from the key value store. Called once at startup,
+/// after <see cref="Kv_Initialize" />.
+/// </summary>
+void Macros_Load(void);
+
+DECLARE_CMD(RemoteX_Macro);
+DECLARE_CMD(RemoteX_MacroInvoke);
@@ -82,6 +82,12 @@ static void CheckStatusTimerEventHandler(EventLoopTimer *timer)
             return;
         }
 
+        // Server features share one timer wheel rather than a timerfd each.
+        if (TimerWheel_Default() == NULL)
+        {
+            TimerWheel_SetDefault(TimerWheel_Create(dx_timerGetEventLoop(), TIMER_WHEEL_DEFAULT_TICK_US));
+        }
+
         // Start the TCP server.
         if ((serverState = EchoServer_Start(dx_timerGetEventLoop(), localServerIpAddress.s_addr, LocalTcpServerPort,
                                             serverBacklogSize, ServerStoppedHandler)) == NULL)
@@ -99,6 +105,16 @@ static ExitCode InitializeAndLaunchServers(void)
 {
     dx_gpioOpen(&gpio_status_led);
     dx_gpioOn(&gpio_status_led);
+    Kv_Initialize();
+    Macros_Load();
+
+    // Set REMOTEX_CAPTURE to a file name to record client traffic for host/tools/replay.
+    const char *capturePath = getenv("REMOTEX_CAPTURE");
+    if (capturePath != NULL && Capture_Start(capturePath) != 0)
+    {
+        Log_Debug("ERROR: Could not start capture to %s: %s (%d).\n", capturePath, strerror(errno), errno);
+    }
+
     dx_timerSetStart(timer_bindings, NELEMS(timer_bindings));
     return ExitCode_Success;
 }
@@ -109,6 +125,8 @@ static ExitCode InitializeAndLaunchServers(void)
 static void ShutDownServerAndCleanup(void)
 {
     dx_timerSetStop(timer_bindings, NELEMS(timer_bindings));
+    TimerWheel_Dispose(TimerWheel_Default());
+    Capture_Stop();
     dx_timerEventLoopStop();
 }
 
@@ -8,6 +8,7 @@
 #include "dx_utilities.h"
 #include "echo_tcp_server.h"
 #include "exitcode_privnetserv.h"
+#include "timer_wheel.h"
 #include <applibs/log.h>
 #include <applibs/networking.h>
 #include <applibs/powermanagement.h>
@@ -1,10 +1,20 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
 #include "peripherals.h"
+#include "storage_cache.h"
+
+int file_descriptor_ledger[LEDGE_SIZE];
+// How many users need each descriptor to outlive the client.
+static uint8_t ledger_pins[LEDGE_SIZE];
 
 void ledger_initialize(void)
 {
     for (size_t i = 0; i < LEDGE_SIZE; i++)
     {
         file_descriptor_ledger[i] = -1;
+        ledger_pins[i] = 0;
     }
 }
 
@@ -36,17 +46,79 @@ void ledger_remove_file_descriptor(int fd)
     {
         if (file_descriptor_ledger[i] == fd)
         {
-            file_descriptor_ledger[i] = -1;
+            // Something still uses a pinned descriptor, so it stays in the ledger with its pins.
+            if (ledger_pins[i] == 0)
+            {
+                file_descriptor_ledger[i] = -1;
+            }
+            break;
+        }
+    }
+}
+
+bool ledger_contains(int fd)
+{
+    if (fd == -1)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < LEDGE_SIZE; i++)
+    {
+        if (file_descriptor_ledger[i] == fd)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ledger_pin(int fd, bool pinned)
+{
+    if (fd == -1)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < LEDGE_SIZE; i++)
+    {
+        if (file_descriptor_ledger[i] == fd)
+        {
+            if (pinned)
+            {
+                ledger_pins[i]++;
+            }
+            else if (ledger_pins[i] > 0)
+            {
+                ledger_pins[i]--;
+            }
             break;
         }
     }
 }
 
+bool ledger_pinned(int fd)
+{
+    if (fd == -1)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < LEDGE_SIZE; i++)
+    {
+        if (file_descriptor_ledger[i] == fd)
+        {
+            return ledger_pins[i] > 0;
+        }
+    }
+    return false;
+}
+
 void ledger_close(void)
 {
     for (size_t i = 0; i < LEDGE_SIZE; i++)
     {
-        if (file_descriptor_ledger[i] != -1)
+        if (file_descriptor_ledger[i] != -1 && ledger_pins[i] == 0)
         {
             close(file_descriptor_ledger[i]);
             file_descriptor_ledger[i] = -1;
@@ -54,6 +126,13 @@ void ledger_close(void)
     }
 }
 
+static uint64_t monotonic_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
 DEFINE_CMD(GPIO_OpenAsOutput, data, nread)
 {
     data->header.returns = GPIO_OpenAsOutput(data->gpioId, data->outputMode, data->initialValue);
@@ -83,6 +162,222 @@ DEFINE_CMD(GPIO_GetValue, data, nread)
 }
 END_CMD
 
+/// <summary>
+/// True if count is in range and every fd is in the ledger, so a bulk command can either
+/// drive every pin or none of them.
+/// </summary>
+static bool valid_gpio_list(uint8_t count, const int32_t *gpioFds)
+{
+    if (count == 0 || count > GPIO_MAX_BULK_PINS)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!ledger_contains(gpioFds[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+DEFINE_CMD(GPIO_SetValues, data, nread)
+{
+    // gpioFds is packed, read it through an aligned copy.
+    int32_t fds[GPIO_MAX_BULK_PINS];
+
+    memcpy(fds, data->gpioFds, sizeof(fds));
+    data->failedMask = 0;
+    data->spanNs = 0;
+
+    if (!valid_gpio_list(data->count, fds))
+    {
+        data->header.returns = -1;
+        errno = EINVAL;
+    }
+    else
+    {
+        uint64_t started = monotonic_ns();
+        int last_errno = 0;
+
+        data->header.returns = 0;
+
+        for (size_t i = 0; i < data->count; i++)
+        {
+            if (GPIO_SetValue(fds[i], (data->values >> i) & 1 ? GPIO_Value_High : GPIO_Value_Low) == -1)
+            {
+                data->failedMask |= 1u << i;
+                last_errno = errno;
+            }
+            else
+            {
+                data->header.returns++;
+            }
+        }
+
+        data->spanNs = (uint32_t)(monotonic_ns() - started);
+        errno = last_errno;
+    }
+}
+END_CMD
+
+DEFINE_CMD(GPIO_GetValues, data, nread)
+{
+    // gpioFds is packed, read it through an aligned copy.
+    int32_t fds[GPIO_MAX_BULK_PINS];
+
+    memcpy(fds, data->gpioFds, sizeof(fds));
+    data->values = 0;
+    data->failedMask = 0;
+    data->spanNs = 0;
+
+    if (!valid_gpio_list(data->count, fds))
+    {
+        data->header.returns = -1;
+        errno = EINVAL;
+    }
+    else
+    {
+        uint64_t started = monotonic_ns();
+        int last_errno = 0;
+
+        data->header.returns = 0;
+
+        for (size_t i = 0; i < data->count; i++)
+        {
+            GPIO_Value_Type value;
+
+            if (GPIO_GetValue(fds[i], &value) == -1)
+            {
+                data->failedMask |= 1u << i;
+                last_errno = errno;
+            }
+            else
+            {
+                data->values |= (uint32_t)(value == GPIO_Value_High) << i;
+                data->header.returns++;
+            }
+        }
+
+        data->spanNs = (uint32_t)(monotonic_ns() - started);
+        errno = last_errno;
+    }
+}
+END_CMD
+
+typedef struct
+{
+    uint32_t count;
+    uint64_t min_ns;
+    uint64_t max_ns;
+    uint64_t total_ns;
+} PhaseAccumulator;
+
+static void phase_add(PhaseAccumulator *phase, uint64_t ns)
+{
+    phase->min_ns = phase->count == 0 || ns < phase->min_ns ? ns : phase->min_ns;
+    phase->max_ns = ns > phase->max_ns ? ns : phase->max_ns;
+    phase->total_ns += ns;
+    phase->count++;
+}
+
+static GPIO_PhaseStats_t phase_stats(const PhaseAccumulator *phase)
+{
+    GPIO_PhaseStats_t stats = {.count = phase->count,
+                               .minNs = (uint32_t)phase->min_ns,
+                               .maxNs = (uint32_t)phase->max_ns,
+                               .meanNs = phase->count ? (uint32_t)(phase->total_ns / phase->count) : 0};
+    return stats;
+}
+
+/// <summary>
+/// Poll the input as fast as GPIO_GetValue allows. An edge is placed midway between the
+/// sample before it and the sample that saw it; only phases bounded by two edges are timed.
+/// </summary>
+DEFINE_CMD(GPIO_Measure, data, nread)
+{
+    PhaseAccumulator high = {0}, low = {0};
+    GPIO_Value_Type previous, level;
+    uint64_t started, previous_sample, last_edge = 0, first_rise = 0, last_rise = 0;
+    uint32_t rises = 0;
+
+    data->samples = data->sampleRateHz = data->edges = data->frequencyMilliHz = 0;
+    data->dutyPermille = 0;
+    data->header.returns = -1;
+
+    if (!ledger_contains(data->gpioFd) || data->windowMs == 0 || data->windowMs > GPIO_MEASURE_MAX_WINDOW_MS)
+    {
+        errno = EINVAL;
+    }
+    else if (GPIO_GetValue(data->gpioFd, &previous) != -1)
+    {
+        uint64_t deadline;
+
+        started = previous_sample = monotonic_ns();
+        deadline = started + (uint64_t)data->windowMs * 1000000;
+        data->samples = 1;
+        data->header.returns = 0;
+
+        while (previous_sample < deadline)
+        {
+            if (GPIO_GetValue(data->gpioFd, &level) == -1)
+            {
+                data->header.returns = -1;
+                break;
+            }
+
+            uint64_t now = monotonic_ns();
+            data->samples++;
+
+            if (level != previous)
+            {
+                uint64_t edge = previous_sample + (now - previous_sample) / 2;
+
+                if (data->edges++ > 0)
+                {
+                    phase_add(previous == GPIO_Value_High ? &high : &low, edge - last_edge);
+                }
+
+                if (level == GPIO_Value_High)
+                {
+                    first_rise = rises++ == 0 ? edge : first_rise;
+                    last_rise = edge;
+                }
+
+                last_edge = edge;
+                previous = level;
+            }
+
+            previous_sample = now;
+        }
+
+        if (previous_sample > started)
+        {
+            data->sampleRateHz = (uint32_t)((uint64_t)data->samples * 1000000000 / (previous_sample - started));
+        }
+
+        if (rises >= 2)
+        {
+            data->frequencyMilliHz = (uint32_t)((uint64_t)(rises - 1) * 1000000000000 / (last_rise - first_rise));
+        }
+
+        if (high.total_ns + low.total_ns > 0)
+        {
+            data->dutyPermille = (uint16_t)(high.total_ns * 1000 / (high.total_ns + low.total_ns));
+        }
+        else
+        {
+            data->dutyPermille = previous == GPIO_Value_High ? 1000 : 0;
+        }
+    }
+
+    data->high = phase_stats(&high);
+    data->low = phase_stats(&low);
+}
+END_CMD
+
 DEFINE_CMD(I2CMaster_Open, data, nread)
 {
     data->header.returns = I2CMaster_Open(data->I2C_InterfaceId);
@@ -126,6 +421,115 @@ DEFINE_CMD(I2CMaster_SetDefaultTargetAddress, data, nread)
 }
 END_CMD
 
+DEFINE_CMD(I2CMaster_Scan, data, nread)
+{
+    // Static as the read request carries a full data block.
+    static I2CMaster_Read_t probe;
+    uint8_t first = data->firstAddress, last = data->lastAddress;
+
+    memset(data->present, 0, sizeof(data->present));
+    memset(data->probeErrno, 0, sizeof(data->probeErrno));
+    data->header.returns = -1;
+
+    if (first == 0 && last == 0)
+    {
+        first = 0x08;
+        last = 0x77;
+    }
+
+    if (!ledger_contains(data->fd) || first > last || last >= sizeof(data->probeErrno))
+    {
+        errno = EINVAL;
+    }
+    else if (data->timeoutInMs == 0 || I2CMaster_SetTimeout(data->fd, data->timeoutInMs) == 0)
+    {
+        data->header.returns = 0;
+
+        for (unsigned address = first; address <= last; address++)
+        {
+            probe.fd = data->fd;
+            probe.address = (uint8_t)address;
+            probe.maxLength = 1;
+            errno = 0;
+
+            I2CMaster_Read_cmd((uint8_t *)&probe, sizeof(probe));
+
+            if (probe.header.returns == -1)
+            {
+                data->probeErrno[address] = (uint8_t)probe.header.err_no;
+            }
+            else
+            {
+                data->present[address / 8] |= (uint8_t)(1 << (address % 8));
+                data->header.returns++;
+            }
+        }
+        errno = 0;
+    }
+}
+END_CMD
+
+DEFINE_CMD(I2CMaster_BurstRead, data, nread)
+{
+    // Results are written over the entries, so work from a copy.
+    I2C_BurstEntry_t entries[I2C_BURST_MAX_ENTRIES];
+    size_t response_length = 0;
+    uint8_t *out = data->data_block.data;
+
+    data->header.returns = -1;
+    data->spanNs = 0;
+
+    for (size_t i = 0; i < data->entryCount && i < I2C_BURST_MAX_ENTRIES; i++)
+    {
+        memcpy(&entries[i], out + i * sizeof(I2C_BurstEntry_t), sizeof(I2C_BurstEntry_t));
+        response_length += sizeof(I2C_BurstResult_t) + entries[i].length;
+    }
+
+    if (!ledger_contains(data->fd) || data->entryCount == 0 || data->entryCount > I2C_BURST_MAX_ENTRIES ||
+        VARIABLE_BLOCK_SIZE(I2CMaster_BurstRead, data->entryCount * sizeof(I2C_BurstEntry_t)) > nread ||
+        response_length > sizeof(data->data_block.data))
+    {
+        errno = EINVAL;
+    }
+    else
+    {
+        uint64_t started = monotonic_ns();
+
+        data->header.returns = 0;
+
+        for (size_t i = 0; i < data->entryCount; i++)
+        {
+            I2C_BurstResult_t *result = (I2C_BurstResult_t *)out;
+            uint8_t reg[2] = {(uint8_t)(entries[i].reg >> 8), (uint8_t)entries[i].reg};
+            const uint8_t *reg_start = reg + (entries[i].registerLength == 1);
+
+            errno = 0;
+            if (entries[i].registerLength == 0)
+            {
+                result->returns = (int32_t)I2CMaster_Read(data->fd, entries[i].address, out + sizeof(*result), entries[i].length);
+            }
+            else if (entries[i].registerLength <= 2)
+            {
+                result->returns = (int32_t)I2CMaster_WriteThenRead(data->fd, entries[i].address, reg_start, entries[i].registerLength,
+                                                                   out + sizeof(*result), entries[i].length);
+            }
+            else
+            {
+                result->returns = -1;
+                errno = EINVAL;
+            }
+
+            result->err_no = result->returns == -1 ? errno : 0;
+            data->header.returns += result->returns != -1;
+            out += sizeof(*result) + entries[i].length;
+        }
+
+        data->spanNs = (uint32_t)(monotonic_ns() - started);
+        errno = 0;
+    }
+}
+END_CMD
+
 DEFINE_CMD(PWM_Open, data, nread)
 {
     data->header.returns = PWM_Open(data->pwm);
@@ -216,56 +620,71 @@ DEFINE_CMD(SPIMaster_WriteThenRead, data, nread)
 }
 END_CMD
 
+/// <summary>
+///     <para>data_block holds transferCount SPI_TransferConfig, then the write data of each
+///     segment with the write flag, in segment order. The read data of each segment with the
+///     read flag comes back packed from the start of data_block, in segment order.</para>
+///     <para>Segments may mix directions, and a segment with both flags is full duplex where
+///     the controller supports it.</para>
+/// </summary>
 DEFINE_CMD(SPIMaster_TransferSequential, data, nread)
 {
-    bool read_transfer = false, write_transfer = false;
+    // Reads go to a separate buffer as the read data overlays the requests' write data.
+    static SPIMaster_Transfer transfers[SPI_MAX_TRANSFERS];
+    static uint8_t read_data[sizeof(DATA_BLOCK)];
 
-    SPIMaster_Transfer transfers[data->transferCount];
-    SPIMaster_InitTransfers(transfers, data->transferCount);
+    const SPI_TransferConfig *configs = (const SPI_TransferConfig *)data->data_block.data;
+    size_t available = nread > CORE_BLOCK_SIZE(SPIMaster_TransferSequential) ? (size_t)(nread - CORE_BLOCK_SIZE(SPIMaster_TransferSequential)) : 0;
+    size_t write_length = 0, read_length = 0;
+    bool valid = data->transferCount > 0 && data->transferCount <= SPI_MAX_TRANSFERS &&
+                 data->transferCount * sizeof(SPI_TransferConfig) <= available;
 
-    uint8_t *data_ptr = data->data_block.data;
-
-    for (size_t i = 0; i < data->transferCount; i++)
+    for (size_t i = 0; valid && i < data->transferCount; i++)
     {
-        SPI_TransferConfig *transfer_config = (SPI_TransferConfig *)data_ptr;
-
-        transfers[i].flags = transfer_config->flags;
-        transfers[i].length = transfer_config->length;
-        transfers[i].readData = NULL;
-        transfers[i].writeData = NULL;
-
-        data_ptr += sizeof(SPI_TransferConfig);
+        uint8_t flags = configs[i].flags;
 
-        read_transfer = transfer_config->flags == SPI_TransferFlags_Read ? true : read_transfer;
-        write_transfer = transfer_config->flags == SPI_TransferFlags_Write ? true : write_transfer;
+        valid = configs[i].length > 0 && flags != 0 && (flags & ~(SPI_TransferFlags_Read | SPI_TransferFlags_Write)) == 0;
+        write_length += (flags & SPI_TransferFlags_Write) ? configs[i].length : 0;
+        read_length += (flags & SPI_TransferFlags_Read) ? configs[i].length : 0;
     }
 
-    if (read_transfer && write_transfer)
+    if (!valid || data->transferCount * sizeof(SPI_TransferConfig) + write_length > available || read_length > sizeof(read_data))
     {
-        Log_Debug("can't mix read and write transfers on a single SPI transaction\n");
+        data->header.returns = -1;
+        data->length = 0;
+        errno = EINVAL;
     }
-
-    if (read_transfer)
+    else
     {
-        data_ptr = data->data_block.data;
+        const uint8_t *write_ptr = data->data_block.data + data->transferCount * sizeof(SPI_TransferConfig);
+        uint8_t *read_ptr = read_data;
 
-        for (size_t i = 0; i < data->transferCount; i++)
-        {
-            transfers[i].readData = data_ptr;
-            data_ptr += transfers[i].length;
-        }
-    }
+        SPIMaster_InitTransfers(transfers, data->transferCount);
 
-    if (write_transfer)
-    {
         for (size_t i = 0; i < data->transferCount; i++)
         {
-            transfers[i].writeData = data_ptr;
-            data_ptr += transfers[i].length;
+            transfers[i].flags = configs[i].flags;
+            transfers[i].length = configs[i].length;
+            transfers[i].writeData = NULL;
+            transfers[i].readData = NULL;
+
+            if (configs[i].flags & SPI_TransferFlags_Write)
+            {
+                transfers[i].writeData = write_ptr;
+                write_ptr += configs[i].length;
+            }
+            if (configs[i].flags & SPI_TransferFlags_Read)
+            {
+                transfers[i].readData = read_ptr;
+                read_ptr += configs[i].length;
+            }
         }
-    }
 
-    data->header.returns = SPIMaster_TransferSequential(data->fd, transfers, data->transferCount);
+        data->header.returns = SPIMaster_TransferSequential(data->fd, transfers, data->transferCount);
+
+        memcpy(data->data_block.data, read_data, read_length);
+        data->length = (int32_t)read_length;
+    }
 }
 END_CMD
 
@@ -284,26 +703,57 @@ END_CMD
 
 DEFINE_CMD(RemoteX_Write, data, nread)
 {
-    data->header.returns = write(data->fd, data->data_block.data, (size_t)data->length);
+    if (StorageCache_IsCached(data->fd))
+    {
+        data->header.returns = (int)StorageCache_Write(data->fd, data->data_block.data, (size_t)data->length);
+    }
+    else
+    {
+        data->header.returns = write(data->fd, data->data_block.data, (size_t)data->length);
+    }
 }
 END_CMD
 
 DEFINE_CMD(RemoteX_Read, data, nread)
 {
-    data->header.returns = read(data->fd, data->data_block.data, (size_t)data->length);
+    if (StorageCache_IsCached(data->fd))
+    {
+        data->header.returns = (int)StorageCache_Read(data->fd, data->data_block.data, (size_t)data->length);
+    }
+    else
+    {
+        data->header.returns = read(data->fd, data->data_block.data, (size_t)data->length);
+    }
 }
 END_CMD
 
 DEFINE_CMD(RemoteX_Lseek, data, nread)
 {
-    data->header.returns = (int)lseek(data->fd, data->offset, data->whence);
+    if (StorageCache_IsCached(data->fd))
+    {
+        data->header.returns = (int)StorageCache_Lseek(data->fd, data->offset, data->whence);
+    }
+    else
+    {
+        data->header.returns = (int)lseek(data->fd, data->offset, data->whence);
+    }
 }
 END_CMD
 
 DEFINE_CMD(RemoteX_Close, data, nread)
 {
-    data->header.returns = close(data->fd);
-    ledger_remove_file_descriptor(data->fd);
+    // Closing would let the next open reuse the number while a rule or plan still uses it.
+    if (ledger_pinned(data->fd))
+    {
+        errno = EBUSY;
+        data->header.returns = -1;
+    }
+    else
+    {
+        StorageCache_Release(data->fd);
+        data->header.returns = close(data->fd);
+        ledger_remove_file_descriptor(data->fd);
+    }
 }
 END_CMD
 
@@ -34,16 +34,34 @@
 
 #define NELEMS(x) (sizeof(x) / sizeof((x)[0]))
 
+#define I2C_BURST_MAX_ENTRIES 32
+#define SPI_MAX_TRANSFERS 32
+
 #define LEDGE_SIZE 128
-int file_descriptor_ledger[LEDGE_SIZE];
+extern int file_descriptor_ledger[LEDGE_SIZE];
 
 void ledger_initialize(void);
 void ledger_close(void);
+void ledger_add_file_descriptor(int fd);
+void ledger_remove_file_descriptor(int fd);
+bool ledger_contains(int fd);
+
+// A pinned descriptor is left open by ledger_close, for work that outlives the client.
+// Pins are counted, so every ledger_pin(fd, true) needs a matching ledger_pin(fd, false).
+// RemoteX_Close refuses a pinned descriptor with EBUSY.
+void ledger_pin(int fd, bool pinned);
+bool ledger_pinned(int fd);
+
+// Run a command frame through the same validation and handler table as frames from the socket.
+bool dispatch_command(uint8_t *buf, ssize_t nread);
 
 DECLARE_CMD(GPIO_OpenAsOutput);
 DECLARE_CMD(GPIO_OpenAsInput);
 DECLARE_CMD(GPIO_SetValue);
 DECLARE_CMD(GPIO_GetValue);
+DECLARE_CMD(GPIO_SetValues);
+DECLARE_CMD(GPIO_GetValues);
+DECLARE_CMD(GPIO_Measure);
 
 DECLARE_CMD(I2CMaster_Open);
 DECLARE_CMD(I2CMaster_SetBusSpeed);
@@ -52,6 +70,8 @@ DECLARE_CMD(I2CMaster_Write);
 DECLARE_CMD(I2CMaster_WriteThenRead);
 DECLARE_CMD(I2CMaster_Read);
 DECLARE_CMD(I2CMaster_SetDefaultTargetAddress);
+DECLARE_CMD(I2CMaster_Scan);
+DECLARE_CMD(I2CMaster_BurstRead);
 
 DECLARE_CMD(SPIMaster_Open);
 DECLARE_CMD(SPIMaster_InitConfig);
@@ -0,0 +1,324 @@
+#include <math.h>
+#include <string.h>
+
+#include "flow_control.h"
+#include "pwm_profile.h"
+
+typedef struct
+{
+    TimerWheelTimer timer;
+    PWM_PROFILE_KIND kind;
+    uint32_t count;
+    uint32_t loops;
+    bool reverse_on_loop;
+    uint32_t index;
+    uint64_t next_due_ns;
+    uint64_t pass_ns;
+    PWM_ProfileStats_t stats;
+    PWM_ProfilePoint_t points[PWM_PROFILE_MAX_POINTS];
+} ProfileSlot;
+
+static ProfileSlot slots[PWM_PROFILE_MAX_CHANNELS];
+
+static ProfileSlot *find_slot(int32_t fd, uint32_t channel)
+{
+    for (size_t i = 0; i < PWM_PROFILE_MAX_CHANNELS; i++)
+    {
+        if (slots[i].stats.state != SequenceState_Idle && slots[i].stats.pwmFd == fd && slots[i].stats.pwmChannel == channel)
+        {
+            return &slots[i];
+        }
+    }
+    return NULL;
+}
+
+/// <summary>
+/// The slot already used by this channel, else a free one, else the one that finished first.
+/// </summary>
+static ProfileSlot *allocate_slot(int32_t fd, uint32_t channel)
+{
+    ProfileSlot *slot = find_slot(fd, channel);
+    ProfileSlot *oldest = NULL;
+
+    if (slot != NULL)
+    {
+        return slot->stats.state == SequenceState_Running ? NULL : slot;
+    }
+
+    for (size_t i = 0; i < PWM_PROFILE_MAX_CHANNELS; i++)
+    {
+        if (slots[i].stats.state == SequenceState_Idle)
+        {
+            return &slots[i];
+        }
+        if (slots[i].stats.state != SequenceState_Running && (oldest == NULL || slots[i].stats.startedNs < oldest->stats.startedNs))
+        {
+            oldest = &slots[i];
+        }
+    }
+    return oldest;
+}
+
+static uint32_t interpolate(uint32_t from, uint32_t to, double fraction)
+{
+    return (uint32_t)((double)from + ((double)to - (double)from) * fraction + 0.5);
+}
+
+/// <summary>
+/// The state applied at step index of the current loop. Ramps are computed rather than
+/// stored; the hold time, polarity and enable of a ramp come from its first point.
+/// </summary>
+static PWM_ProfilePoint_t step_at(const ProfileSlot *slot, uint32_t index)
+{
+    if (slot->kind == PwmProfile_Points)
+    {
+        return slot->points[index];
+    }
+
+    const PWM_ProfilePoint_t *from = &slot->points[0];
+    const PWM_ProfilePoint_t *to = &slot->points[1];
+    double t = (double)index / (double)(slot->count - 1);
+
+    if (slot->reverse_on_loop && (slot->stats.loopsCompleted & 1) != 0)
+    {
+        t = 1.0 - t;
+    }
+
+    if (slot->kind == PwmProfile_Exponential)
+    {
+        t = (exp(PWM_PROFILE_EXPONENTIAL_CURVE * t) - 1.0) / (exp(PWM_PROFILE_EXPONENTIAL_CURVE) - 1.0);
+    }
+
+    PWM_ProfilePoint_t step = *from;
+    step.period_nsec = interpolate(from->period_nsec, to->period_nsec, t);
+    step.dutyCycle_nsec = interpolate(from->dutyCycle_nsec, to->dutyCycle_nsec, t);
+    return step;
+}
+
+static bool is_final_step(const ProfileSlot *slot)
+{
+    return slot->index == slot->count - 1 && slot->loops != 0 && slot->stats.loopsCompleted == slot->loops - 1;
+}
+
+static void next_step(ProfileSlot *slot)
+{
+    if (++slot->index == slot->count)
+    {
+        slot->index = 0;
+        slot->stats.loopsCompleted++;
+    }
+}
+
+static void finish(ProfileSlot *slot, SEQUENCE_STATE state)
+{
+    TimerWheel_Cancel(&slot->timer);
+    slot->stats.state = state;
+    FlowControl_Push(PWM_Profile_c, (int32_t)state, &slot->stats, sizeof(slot->stats));
+}
+
+/// <summary>
+/// Skip whole passes that are already over, never past the start of the final pass. Every
+/// pass takes the same time, so the profile stays on schedule at the same step index.
+/// </summary>
+static void skip_passes(ProfileSlot *slot, uint64_t now)
+{
+    uint64_t passes = (now - slot->next_due_ns) / slot->pass_ns;
+
+    if (slot->loops != 0 && passes > slot->loops - 1 - slot->stats.loopsCompleted)
+    {
+        passes = slot->loops - 1 - slot->stats.loopsCompleted;
+    }
+
+    slot->next_due_ns += passes * slot->pass_ns;
+    slot->stats.loopsCompleted += (uint32_t)passes;
+    slot->stats.stepsMissed += (uint32_t)(passes * slot->count);
+}
+
+/// <summary>
+/// Apply the current step. Step times are absolute, so when the device falls behind the
+/// steps whose successors are already due are skipped and counted as missed, keeping the
+/// profile on schedule. The final step is always applied.
+/// </summary>
+static void HandleStepDue(TimerWheelTimer *timer, void *context)
+{
+    ProfileSlot *slot = (ProfileSlot *)context;
+    uint64_t now = TimerWheel_NowNs();
+    uint32_t skipped = 0;
+
+    if (now > slot->next_due_ns)
+    {
+        skip_passes(slot, now);
+    }
+
+    PWM_ProfilePoint_t step = step_at(slot, slot->index);
+
+    while (!is_final_step(slot) && skipped++ < PWM_PROFILE_MAX_CATCH_UP_STEPS &&
+           slot->next_due_ns + (uint64_t)step.holdUs * 1000 <= now)
+    {
+        slot->next_due_ns += (uint64_t)step.holdUs * 1000;
+        slot->stats.stepsMissed++;
+        next_step(slot);
+        step = step_at(slot, slot->index);
+    }
+
+    PwmState state = {
+        .period_nsec = step.period_nsec,
+        .dutyCycle_nsec = step.dutyCycle_nsec,
+        .polarity = step.polarity,
+        .enabled = step.enabled};
+
+    if (PWM_Apply(slot->stats.pwmFd, slot->stats.pwmChannel, &state) == -1)
+    {
+        slot->stats.applyErrors++;
+    }
+    slot->stats.stepsApplied++;
+
+    if (is_final_step(slot))
+    {
+        slot->stats.loopsCompleted++;
+        finish(slot, SequenceState_Completed);
+        return;
+    }
+
+    slot->next_due_ns += (uint64_t)step.holdUs * 1000;
+    next_step(slot);
+    TimerWheel_StartAt(TimerWheel_Default(), &slot->timer, slot->next_due_ns);
+}
+
+void PwmProfile_CancelAll(void)
+{
+    for (size_t i = 0; i < PWM_PROFILE_MAX_CHANNELS; i++)
+    {
+        TimerWheel_Cancel(&slots[i].timer);
+        memset(&slots[i].stats, 0, sizeof(slots[i].stats));
+    }
+}
+
+static bool validate_profile(const PWM_Profile_t *data, ssize_t nread)
+{
+    size_t point_count = data->kind == PwmProfile_Points ? data->pointCount : 2;
+    const PWM_ProfilePoint_t *points = (const PWM_ProfilePoint_t *)data->data_block.data;
+
+    if (VARIABLE_BLOCK_SIZE(PWM_Profile, point_count * sizeof(PWM_ProfilePoint_t)) > nread ||
+        !ledger_contains(data->pwmFd))
+    {
+        return false;
+    }
+
+    switch (data->kind)
+    {
+    case PwmProfile_Points:
+        if (data->pointCount == 0 || data->pointCount > PWM_PROFILE_MAX_POINTS)
+        {
+            return false;
+        }
+        // Every step must take some time, or catching up would never get ahead of the clock.
+        for (size_t i = 0; i < data->pointCount; i++)
+        {
+            if (points[i].holdUs == 0)
+            {
+                return false;
+            }
+        }
+        return true;
+
+    case PwmProfile_Linear:
+    case PwmProfile_Exponential:
+        return data->pointCount >= 2 && data->pointCount <= PWM_PROFILE_MAX_RAMP_STEPS && points[0].holdUs != 0;
+
+    default:
+        return false;
+    }
+}
+
+/// <summary>
+/// Time one pass through the profile takes. Ramps hold every step for the first point's hold.
+/// </summary>
+static uint64_t pass_duration_ns(const ProfileSlot *slot)
+{
+    uint64_t total_us = 0;
+
+    if (slot->kind != PwmProfile_Points)
+    {
+        return (uint64_t)slot->count * slot->points[0].holdUs * 1000;
+    }
+
+    for (size_t i = 0; i < slot->count; i++)
+    {
+        total_us += slot->points[i].holdUs;
+    }
+    return total_us * 1000;
+}
+
+DEFINE_CMD(PWM_Profile, data, nread)
+{
+    ProfileSlot *slot = NULL;
+
+    data->header.returns = -1;
+    memset(&data->stats, 0, sizeof(data->stats));
+
+    switch (data->action)
+    {
+    case Sequence_Start:
+        if (!validate_profile(data, nread))
+        {
+            errno = EINVAL;
+        }
+        else if ((slot = allocate_slot(data->pwmFd, data->pwmChannel)) == NULL)
+        {
+            errno = find_slot(data->pwmFd, data->pwmChannel) != NULL ? EBUSY : ENOSPC;
+        }
+        else
+        {
+            slot->kind = data->kind;
+            slot->count = data->pointCount;
+            slot->loops = data->loops;
+            slot->reverse_on_loop = data->reverseOnLoop;
+            slot->index = 0;
+            memcpy(slot->points, data->data_block.data,
+                   (data->kind == PwmProfile_Points ? data->pointCount : 2) * sizeof(PWM_ProfilePoint_t));
+            slot->pass_ns = pass_duration_ns(slot);
+
+            memset(&slot->stats, 0, sizeof(slot->stats));
+            slot->stats.pwmFd = data->pwmFd;
+            slot->stats.pwmChannel = data->pwmChannel;
+            slot->stats.state = SequenceState_Running;
+            slot->stats.startedNs = TimerWheel_NowNs();
+            slot->next_due_ns = slot->stats.startedNs;
+
+            TimerWheel_InitTimer(&slot->timer, HandleStepDue, slot);
+            if (TimerWheel_StartAt(TimerWheel_Default(), &slot->timer, slot->next_due_ns) == -1)
+            {
+                slot->stats.state = SequenceState_Failed;
+            }
+            else
+            {
+                data->header.returns = 0;
+            }
+        }
+        break;
+
+    case Sequence_Cancel:
+        if ((slot = find_slot(data->pwmFd, data->pwmChannel)) != NULL && slot->stats.state == SequenceState_Running)
+        {
+            finish(slot, SequenceState_Cancelled);
+        }
+        data->header.returns = 0;
+        break;
+
+    case Sequence_Status:
+        slot = find_slot(data->pwmFd, data->pwmChannel);
+        data->header.returns = 0;
+        break;
+
+    default:
+        errno = EINVAL;
+        break;
+    }
+
+    if (slot != NULL)
+    {
+        data->stats = slot->stats;
+    }
+}
+END_CMD
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "peripherals.h"
+#include "timer_wheel.h"
+
+// Profiles can run on this many PWM channels at once, each with up to
+// PWM_PROFILE_MAX_POINTS explicit points. Ramps are computed per step and store two points.
+#define PWM_PROFILE_MAX_CHANNELS 4
+#define PWM_PROFILE_MAX_POINTS 128
+#define PWM_PROFILE_MAX_RAMP_STEPS 4096
+
+// Most missed steps one timer callback walks through. A device further behind skips whole
+// passes at once, and anything left is caught up over the following callbacks.
+#define PWM_PROFILE_MAX_CATCH_UP_STEPS 256
+
+// Curvature of exponential ramps: the fraction of the ramp covered at step t of 1 is
+// (e^(k t) - 1) / (e^k - 1).
+#define PWM_PROFILE_EXPONENTIAL_CURVE 4.0
+
+/// <summary>
+/// Stop every running profile. Called when the client disconnects.
+/// </summary>
+void PwmProfile_CancelAll(void);
+
+DECLARE_CMD(PWM_Profile);
@@ -0,0 +1,373 @@
+#include <string.h>
+
+#include "flow_control.h"
+#include "rule_engine.h"
+
+typedef struct
+{
+    uint32_t id; // 0 when the slot is free
+    RemoteX_Rule_t rule;
+    RemoteX_RuleStats_t stats;
+    uint16_t consecutive;
+    bool latched;
+    bool have_previous;
+    uint32_t previous;
+} RuleSlot;
+
+static RuleSlot rules[RULES_MAX];
+static uint32_t next_id = 1;
+static size_t next_rule;
+static RemoteX_RuleEngineStats_t engine = {.periodUs = RULES_DEFAULT_PERIOD_US, .budgetUs = RULES_DEFAULT_BUDGET_US};
+static TimerWheelTimer timer;
+
+static RuleSlot *find_rule(uint32_t id)
+{
+    for (size_t i = 0; i < RULES_MAX; i++)
+    {
+        if (id != 0 && rules[i].id == id)
+        {
+            return &rules[i];
+        }
+    }
+    return NULL;
+}
+
+static void pin_handles(const RemoteX_Rule_t *rule, bool pinned)
+{
+    ledger_pin(rule->sourceFd, pinned);
+    if (rule->action != RuleAction_None)
+    {
+        ledger_pin(rule->actionFd, pinned);
+    }
+}
+
+/// <summary>
+/// Free the slot and release the rule's hold on its handles.
+/// </summary>
+static void release_rule(RuleSlot *slot)
+{
+    pin_handles(&slot->rule, false);
+    slot->id = 0;
+    engine.ruleCount--;
+}
+
+static bool is_gpio_condition(RULE_CONDITION condition)
+{
+    return condition != RuleCondition_AdcAbove && condition != RuleCondition_AdcBelow;
+}
+
+/// <summary>
+/// Read the source and report whether the condition holds. Edges are detected between
+/// evaluations, so a pulse shorter than the period can be missed.
+/// </summary>
+static bool sample(RuleSlot *slot, uint32_t *value)
+{
+    const RemoteX_Rule_t *rule = &slot->rule;
+    bool holds = false;
+    int result;
+
+    if (is_gpio_condition(rule->condition))
+    {
+        GPIO_Value_Type gpio_value = GPIO_Value_Low;
+        result = GPIO_GetValue(rule->sourceFd, &gpio_value);
+        *value = gpio_value;
+    }
+    else
+    {
+        result = ADC_Poll(rule->sourceFd, rule->sourceChannel, value);
+    }
+
+    if (result == -1)
+    {
+        slot->stats.sourceErrors++;
+        slot->have_previous = false;
+        return false;
+    }
+
+    switch (rule->condition)
+    {
+    case RuleCondition_AdcAbove:
+        holds = *value > rule->threshold;
+        break;
+    case RuleCondition_AdcBelow:
+        holds = *value < rule->threshold;
+        break;
+    case RuleCondition_GpioRising:
+        holds = slot->have_previous && slot->previous == GPIO_Value_Low && *value == GPIO_Value_High;
+        break;
+    case RuleCondition_GpioFalling:
+        holds = slot->have_previous && slot->previous == GPIO_Value_High && *value == GPIO_Value_Low;
+        break;
+    case RuleCondition_GpioHigh:
+        holds = *value == GPIO_Value_High;
+        break;
+    case RuleCondition_GpioLow:
+        holds = *value == GPIO_Value_Low;
+        break;
+    }
+
+    slot->previous = *value;
+    slot->have_previous = true;
+    return holds;
+}
+
+static int run_action(const RemoteX_Rule_t *rule)
+{
+    switch (rule->action)
+    {
+    case RuleAction_SetGpio:
+        return GPIO_SetValue(rule->actionFd, rule->gpioValue);
+
+    case RuleAction_ApplyPwm:
+    {
+        PwmState state = {
+            .period_nsec = rule->period_nsec,
+            .dutyCycle_nsec = rule->dutyCycle_nsec,
+            .polarity = rule->polarity,
+            .enabled = rule->enabled};
+        return PWM_Apply(rule->actionFd, rule->actionChannel, &state);
+    }
+
+    default:
+        return 0;
+    }
+}
+
+static void evaluate(RuleSlot *slot, uint64_t now)
+{
+    uint32_t value = 0;
+
+    slot->stats.evaluations++;
+
+    if (!sample(slot, &value))
+    {
+        slot->consecutive = 0;
+        slot->latched = false;
+        return;
+    }
+
+    slot->stats.matches++;
+    if (slot->consecutive < slot->rule.samples)
+    {
+        slot->consecutive++;
+    }
+
+    if (slot->latched || slot->consecutive < slot->rule.samples)
+    {
+        return;
+    }
+
+    RemoteX_RuleEvent_t event = {.id = slot->id, .firedNs = now, .value = value};
+
+    event.actionResult = run_action(&slot->rule);
+    if (event.actionResult == -1)
+    {
+        slot->stats.actionErrors++;
+    }
+
+    slot->latched = true;
+    slot->stats.fires++;
+    slot->stats.lastFiredNs = now;
+
+    if (slot->rule.pushEvent)
+    {
+        FlowControl_Push(RemoteX_Rules_c, (int32_t)slot->id, &event, sizeof(event));
+    }
+
+    if (slot->rule.oneShot)
+    {
+        release_rule(slot);
+    }
+}
+
+/// <summary>
+/// Evaluate rules round robin from where the last pass stopped, until every rule has been
+/// evaluated once or the budget is spent.
+/// </summary>
+static void HandleEvaluate(TimerWheelTimer *t, void *context)
+{
+    uint64_t pass_start = TimerWheel_NowNs();
+    uint64_t budget_ns = (uint64_t)engine.budgetUs * 1000;
+    uint64_t now = pass_start;
+
+    engine.passes++;
+
+    for (size_t visited = 0; visited < RULES_MAX; visited++)
+    {
+        RuleSlot *slot = &rules[next_rule];
+        next_rule = (next_rule + 1) % RULES_MAX;
+
+        if (slot->id == 0)
+        {
+            continue;
+        }
+
+        if (now - pass_start > budget_ns)
+        {
+            engine.passesOverBudget++;
+            next_rule = (size_t)(slot - rules);
+            break;
+        }
+
+        evaluate(slot, now);
+
+        uint64_t after = TimerWheel_NowNs();
+        uint32_t cost = (uint32_t)(after - now);
+
+        slot->stats.totalCostNs += cost;
+        if (cost > slot->stats.maxCostNs)
+        {
+            slot->stats.maxCostNs = cost;
+        }
+        now = after;
+    }
+
+    if (now - pass_start > engine.maxPassNs)
+    {
+        engine.maxPassNs = (uint32_t)(now - pass_start);
+    }
+
+    if (engine.ruleCount == 0)
+    {
+        TimerWheel_Cancel(&timer);
+    }
+}
+
+static int start_timer(void)
+{
+    TimerWheel_Cancel(&timer);
+    TimerWheel_InitTimer(&timer, HandleEvaluate, NULL);
+    return TimerWheel_StartPeriodic(TimerWheel_Default(), &timer, engine.periodUs);
+}
+
+void Rules_Clear(void)
+{
+    TimerWheel_Cancel(&timer);
+    for (size_t i = 0; i < RULES_MAX; i++)
+    {
+        if (rules[i].id != 0)
+        {
+            pin_handles(&rules[i].rule, false);
+        }
+    }
+    memset(rules, 0, sizeof(rules));
+    engine.ruleCount = 0;
+    next_rule = 0;
+}
+
+static bool validate_rule(const RemoteX_Rule_t *rule)
+{
+    if (rule->condition > RuleCondition_GpioLow || rule->action > RuleAction_ApplyPwm || rule->samples == 0)
+    {
+        return false;
+    }
+
+    // Only touch handles this client opened.
+    return ledger_contains(rule->sourceFd) && (rule->action == RuleAction_None || ledger_contains(rule->actionFd));
+}
+
+static int add_rule(const RemoteX_Rule_t *rule)
+{
+    RuleSlot *slot = NULL;
+
+    if (!validate_rule(rule))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (size_t i = 0; i < RULES_MAX && slot == NULL; i++)
+    {
+        if (rules[i].id == 0)
+        {
+            slot = &rules[i];
+        }
+    }
+
+    if (slot == NULL)
+    {
+        errno = ENOSPC;
+        return -1;
+    }
+
+    if (engine.ruleCount == 0 && start_timer() == -1)
+    {
+        return -1;
+    }
+
+    memset(slot, 0, sizeof(*slot));
+    slot->rule = *rule;
+    slot->id = next_id++;
+    engine.ruleCount++;
+    pin_handles(rule, true);
+
+    return (int)slot->id;
+}
+
+DEFINE_CMD(RemoteX_Rules, data, nread)
+{
+    RuleSlot *slot = NULL;
+
+    data->header.returns = 0;
+
+    switch (data->op)
+    {
+    case RuleOp_Add:
+        data->header.returns = add_rule(&data->rule);
+        break;
+
+    case RuleOp_Remove:
+        if ((slot = find_rule(data->id)) == NULL)
+        {
+            data->header.returns = -1;
+            errno = ENOENT;
+        }
+        else
+        {
+            data->stats = slot->stats;
+            release_rule(slot);
+            if (engine.ruleCount == 0)
+            {
+                TimerWheel_Cancel(&timer);
+            }
+        }
+        break;
+
+    case RuleOp_Clear:
+        Rules_Clear();
+        break;
+
+    case RuleOp_Status:
+        if (data->id != 0)
+        {
+            if ((slot = find_rule(data->id)) == NULL)
+            {
+                data->header.returns = -1;
+                errno = ENOENT;
+            }
+            else
+            {
+                data->rule = slot->rule;
+                data->stats = slot->stats;
+            }
+        }
+        break;
+
+    case RuleOp_Configure:
+        engine.periodUs = data->periodUs != 0 ? data->periodUs : engine.periodUs;
+        engine.budgetUs = data->budgetUs != 0 ? data->budgetUs : engine.budgetUs;
+        if (engine.ruleCount != 0)
+        {
+            data->header.returns = start_timer();
+        }
+        break;
+
+    default:
+        data->header.returns = -1;
+        errno = EINVAL;
+        break;
+    }
+
+    data->engine = engine;
+}
+END_CMD
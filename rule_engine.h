@@ -0,0 +1,20 @@
+#pragma once
+
+#include "peripherals.h"
+#include "timer_wheel.h"
+
+#define RULES_MAX 16
+
+// Rules are evaluated every RULES_DEFAULT_PERIOD_US. A pass that has spent more than
+// RULES_DEFAULT_BUDGET_US stops and the remaining rules are evaluated first next pass,
+// so a slow ADC cannot delay socket traffic by more than about one rule.
+#define RULES_DEFAULT_PERIOD_US 1000
+#define RULES_DEFAULT_BUDGET_US 300
+
+/// <summary>
+/// Remove every rule. Rules are not removed when the client disconnects: the handles they
+/// use are pinned in the ledger, so safety cutoffs keep running without a connection.
+/// </summary>
+void Rules_Clear(void);
+
+DECLARE_CMD(RemoteX_Rules);
@@ -0,0 +1,209 @@
+#include <string.h>
+
+#include "flow_control.h"
+#include "scheduler.h"
+
+typedef struct
+{
+    TimerWheelTimer timer;
+    uint32_t id;
+    EXECUTE_STATE state;
+    uint64_t executeAtNs;
+    uint64_t executedNs;
+    int32_t framesExecuted;
+    size_t length;
+    uint8_t frames[SCHEDULER_MAX_FRAME_BYTES];
+} ScheduledEntry;
+
+static ScheduledEntry entries[SCHEDULER_MAX_ENTRIES];
+static uint32_t next_id = 1;
+
+// Frames are copied here to run because handlers write their response past the end of
+// the request, up to response_length.
+static uint8_t scratch[1024 * 5];
+static uint8_t report[sizeof(DATA_BLOCK)];
+
+static bool validate_frames(const uint8_t *frames, size_t length)
+{
+    size_t offset = 0;
+
+    while (offset < length)
+    {
+        const CTX_HEADER *header = (const CTX_HEADER *)(frames + offset);
+
+        if (length - offset < sizeof(CTX_HEADER) ||
+            header->block_length < sizeof(CTX_HEADER) ||
+            header->block_length > length - offset ||
+            header->response_length > sizeof(scratch) ||
+            header->cmd == RemoteX_ExecuteAt_c)
+        {
+            return false;
+        }
+
+        offset += header->block_length;
+    }
+
+    return length > 0;
+}
+
+/// <summary>
+/// Pick a free entry, or reuse the oldest finished one so its status stays queryable
+/// for as long as possible.
+/// </summary>
+static ScheduledEntry *allocate_entry(void)
+{
+    ScheduledEntry *oldest = NULL;
+
+    for (size_t i = 0; i < SCHEDULER_MAX_ENTRIES; i++)
+    {
+        if (entries[i].state == ExecuteState_Unknown)
+        {
+            return &entries[i];
+        }
+
+        if (entries[i].state != ExecuteState_Pending && (oldest == NULL || entries[i].id < oldest->id))
+        {
+            oldest = &entries[i];
+        }
+    }
+
+    return oldest;
+}
+
+static ScheduledEntry *find_entry(uint32_t id)
+{
+    for (size_t i = 0; i < SCHEDULER_MAX_ENTRIES; i++)
+    {
+        if (entries[i].state != ExecuteState_Unknown && entries[i].id == id)
+        {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+static void run_entry(ScheduledEntry *entry)
+{
+    size_t report_length = sizeof(ExecuteAt_Report_t);
+    size_t offset = 0;
+
+    // The wheel fires up to SCHEDULER_SPIN_NS early; wait out the remainder on the clock.
+    entry->executedNs = TimerWheel_SpinUntil(entry->executeAtNs);
+    entry->framesExecuted = 0;
+
+    while (offset < entry->length)
+    {
+        CTX_HEADER *header = (CTX_HEADER *)(entry->frames + offset);
+        size_t block_length = header->block_length;
+
+        memcpy(scratch, header, block_length);
+        dispatch_command(scratch, (ssize_t)block_length);
+        entry->framesExecuted++;
+
+        header = (CTX_HEADER *)scratch;
+        if (header->respond && report_length + header->response_length <= sizeof(report))
+        {
+            memcpy(report + report_length, scratch, header->response_length);
+            report_length += header->response_length;
+        }
+
+        offset += block_length;
+    }
+
+    entry->state = ExecuteState_Done;
+
+    ExecuteAt_Report_t *summary = (ExecuteAt_Report_t *)report;
+    summary->id = entry->id;
+    summary->executeAtNs = entry->executeAtNs;
+    summary->executedNs = entry->executedNs;
+    summary->latenessNs = (int64_t)(entry->executedNs - entry->executeAtNs);
+    summary->framesExecuted = entry->framesExecuted;
+
+    // Clients that have not enabled flow control poll with RemoteX_ExecuteStatus instead.
+    FlowControl_Push(RemoteX_ExecuteAt_c, (int32_t)entry->id, report, report_length);
+}
+
+static void HandleEntryDue(TimerWheelTimer *timer, void *context)
+{
+    run_entry((ScheduledEntry *)context);
+}
+
+void Scheduler_CancelAll(void)
+{
+    for (size_t i = 0; i < SCHEDULER_MAX_ENTRIES; i++)
+    {
+        TimerWheel_Cancel(&entries[i].timer);
+        entries[i].state = ExecuteState_Unknown;
+    }
+}
+
+DEFINE_CMD(RemoteX_ExecuteAt, data, nread)
+{
+    size_t length = (size_t)data->length;
+    ScheduledEntry *entry = NULL;
+
+    data->receivedNs = TimerWheel_NowNs();
+    data->header.returns = -1;
+
+    if (data->length <= 0 || length > SCHEDULER_MAX_FRAME_BYTES ||
+        VARIABLE_BLOCK_SIZE(RemoteX_ExecuteAt, length) > nread ||
+        !validate_frames(data->data_block.data, length))
+    {
+        errno = EINVAL;
+    }
+    else if ((entry = allocate_entry()) == NULL)
+    {
+        errno = ENOSPC;
+    }
+    else
+    {
+        TimerWheel_InitTimer(&entry->timer, HandleEntryDue, entry);
+        memcpy(entry->frames, data->data_block.data, length);
+        entry->length = length;
+        entry->id = next_id++;
+        entry->executeAtNs = data->executeAtNs;
+        entry->executedNs = 0;
+        entry->framesExecuted = 0;
+
+        uint64_t arm_at = data->executeAtNs > SCHEDULER_SPIN_NS ? data->executeAtNs - SCHEDULER_SPIN_NS : 0;
+
+        if (TimerWheel_StartAt(TimerWheel_Default(), &entry->timer, arm_at) == -1)
+        {
+            entry->state = ExecuteState_Unknown;
+        }
+        else
+        {
+            entry->state = ExecuteState_Pending;
+            data->header.returns = (int32_t)entry->id;
+        }
+    }
+}
+END_CMD
+
+DEFINE_CMD(RemoteX_ExecuteStatus, data, nread)
+{
+    ScheduledEntry *entry = find_entry(data->id);
+
+    if (entry == NULL)
+    {
+        data->state = ExecuteState_Unknown;
+        data->header.returns = -1;
+        errno = ENOENT;
+    }
+    else
+    {
+        if (data->cancel && entry->state == ExecuteState_Pending)
+        {
+            TimerWheel_Cancel(&entry->timer);
+            entry->state = ExecuteState_Cancelled;
+        }
+
+        data->state = entry->state;
+        data->executeAtNs = entry->executeAtNs;
+        data->executedNs = entry->executedNs;
+        data->latenessNs = entry->state == ExecuteState_Done ? (int64_t)(entry->executedNs - entry->executeAtNs) : 0;
+        data->framesExecuted = entry->framesExecuted;
+        data->header.returns = 0;
+    }
+}
+END_CMD
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "peripherals.h"
+#include "timer_wheel.h"
+
+// Requests waiting to run. Each holds up to SCHEDULER_MAX_FRAME_BYTES of command frames.
+#define SCHEDULER_MAX_ENTRIES 8
+#define SCHEDULER_MAX_FRAME_BYTES 1024
+
+// The wheel is armed this far ahead of the due time and the last stretch is spun on the
+// clock, so a request starts within microseconds of executeAtNs rather than within a tick.
+#define SCHEDULER_SPIN_NS 200000
+
+/// <summary>
+/// Cancel every pending request. Called when the client disconnects, as its file
+/// descriptors are about to be closed.
+/// </summary>
+void Scheduler_CancelAll(void);
+
+DECLARE_CMD(RemoteX_ExecuteAt);
+DECLARE_CMD(RemoteX_ExecuteStatus);
@@ -0,0 +1,36 @@
+#include <string.h>
+#include <time.h>
+
+#include "loop_monitor.h"
+#include "server_stats.h"
+
+ServerStats_t server_stats;
+static uint64_t window_start_ns;
+
+static uint64_t monotonic_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+void ServerStats_Reset(void)
+{
+    memset(&server_stats, 0, sizeof(server_stats));
+    window_start_ns = monotonic_ns();
+    LoopMonitor_Reset();
+}
+
+DEFINE_CMD(RemoteX_GetStats, data, nread)
+{
+    server_stats.windowMs = (uint32_t)((monotonic_ns() - window_start_ns) / 1000000);
+    data->stats = server_stats;
+    LoopMonitor_GetStats(&data->stats.loop);
+    data->header.returns = 0;
+
+    if (data->reset)
+    {
+        ServerStats_Reset();
+    }
+}
+END_CMD
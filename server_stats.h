@@ -0,0 +1,13 @@
+#pragma once
+
+#include "peripherals.h"
+
+// Counters kept by the connection state machine, read by the client with RemoteX_GetStats.
+extern ServerStats_t server_stats;
+
+/// <summary>
+/// Zero the counters and start a new window.
+/// </summary>
+void ServerStats_Reset(void);
+
+DECLARE_CMD(RemoteX_GetStats);
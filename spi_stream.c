@@ -0,0 +1,171 @@
+#include <string.h>
+
+#include "spi_stream.h"
+
+typedef struct
+{
+    uint32_t seq;
+    size_t length;
+    uint8_t data[SPI_STREAM_CHUNK_BYTES];
+} StreamBuffer;
+
+static StreamBuffer buffers[SPI_STREAM_BUFFERS];
+static size_t head;   // Next buffer to clock out
+static size_t queued; // Buffers waiting to be clocked out
+static bool stream_open;
+static int32_t stream_fd = -1;
+static uint32_t expected_seq;
+static SPIMaster_StreamStats_t stats;
+static TimerWheelTimer timer;
+
+static void clock_out_next(void)
+{
+    static SPIMaster_Transfer transfer;
+    StreamBuffer *buffer = &buffers[head];
+
+    SPIMaster_InitTransfers(&transfer, 1);
+    transfer.flags = SPI_TransferFlags_Write;
+    transfer.writeData = buffer->data;
+    transfer.length = buffer->length;
+
+    uint64_t started = TimerWheel_NowNs();
+
+    if (SPIMaster_TransferSequential(stream_fd, &transfer, 1) == -1)
+    {
+        stats.transferErrors++;
+    }
+
+    stats.busNs += TimerWheel_NowNs() - started;
+    stats.completedSeq = buffer->seq;
+
+    head = (head + 1) % SPI_STREAM_BUFFERS;
+    queued--;
+}
+
+/// <summary>
+/// Clock out one chunk per pass through the event loop, so the response granting the next
+/// credit goes out before the bus is busy and the next chunk travels while it is.
+/// </summary>
+static void HandleFlush(TimerWheelTimer *t, void *context)
+{
+    if (queued > 0)
+    {
+        clock_out_next();
+    }
+
+    if (queued > 0)
+    {
+        TimerWheel_StartOneShot(TimerWheel_Default(), &timer, 0);
+    }
+}
+
+static void flush_all(void)
+{
+    TimerWheel_Cancel(&timer);
+
+    while (queued > 0)
+    {
+        clock_out_next();
+    }
+}
+
+void SpiStream_Cancel(void)
+{
+    TimerWheel_Cancel(&timer);
+    queued = 0;
+    stream_open = false;
+}
+
+static int queue_chunk(const SPIMaster_StreamWrite_t *data, ssize_t nread)
+{
+    if (!stream_open)
+    {
+        errno = ENOTCONN;
+        return -1;
+    }
+
+    if (data->seq != expected_seq || data->length == 0 || data->length > SPI_STREAM_CHUNK_BYTES ||
+        VARIABLE_BLOCK_SIZE(SPIMaster_StreamWrite, data->length) > nread)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // The client sent past its credits; wait for the bus rather than drop data.
+    if (queued == SPI_STREAM_BUFFERS)
+    {
+        stats.stalls++;
+        clock_out_next();
+    }
+
+    StreamBuffer *buffer = &buffers[(head + queued) % SPI_STREAM_BUFFERS];
+    memcpy(buffer->data, data->data_block.data, data->length);
+    buffer->length = data->length;
+    buffer->seq = data->seq;
+    queued++;
+    expected_seq++;
+
+    stats.chunks++;
+    stats.bytes += data->length;
+
+    if (!TimerWheel_IsActive(&timer))
+    {
+        return TimerWheel_StartOneShot(TimerWheel_Default(), &timer, 0);
+    }
+    return 0;
+}
+
+DEFINE_CMD(SPIMaster_StreamWrite, data, nread)
+{
+    data->header.returns = 0;
+
+    switch (data->op)
+    {
+    case SpiStream_Open:
+        if (!ledger_contains(data->fd))
+        {
+            data->header.returns = -1;
+            errno = EINVAL;
+            break;
+        }
+
+        if (stream_open)
+        {
+            flush_all();
+        }
+
+        TimerWheel_InitTimer(&timer, HandleFlush, NULL);
+        memset(&stats, 0, sizeof(stats));
+        head = 0;
+        queued = 0;
+        expected_seq = 1;
+        stream_fd = data->fd;
+        stream_open = true;
+        break;
+
+    case SpiStream_Chunk:
+        data->header.returns = queue_chunk(data, nread);
+        break;
+
+    case SpiStream_Close:
+        if (stream_open)
+        {
+            flush_all();
+            stream_open = false;
+        }
+        break;
+
+    case SpiStream_Status:
+        break;
+
+    default:
+        data->header.returns = -1;
+        errno = EINVAL;
+        break;
+    }
+
+    data->credits = stream_open ? (uint8_t)(SPI_STREAM_BUFFERS - queued) : 0;
+    data->seq = expected_seq;
+    data->stats = stats;
+}
+END_CMD
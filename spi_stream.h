@@ -0,0 +1,15 @@
+#pragma once
+
+#include "peripherals.h"
+#include "timer_wheel.h"
+
+// Two chunk buffers: one is clocked out while the next chunk is received into the other.
+#define SPI_STREAM_BUFFERS 2
+#define SPI_STREAM_CHUNK_BYTES sizeof(DATA_BLOCK)
+
+/// <summary>
+/// Drop queued chunks and end the stream. Called when the client disconnects.
+/// </summary>
+void SpiStream_Cancel(void);
+
+DECLARE_CMD(SPIMaster_StreamWrite);
@@ -0,0 +1,338 @@
+#include <string.h>
+#include <sys/stat.h>
+
+#include "storage_cache.h"
+
+typedef struct
+{
+    bool in_use;
+    int fd;
+    off_t position;
+    off_t last_read_end; // A read starting here is sequential and worth reading ahead
+    off_t page_offset;
+    size_t valid; // Bytes of page holding file contents
+    size_t dirty_start;
+    size_t dirty_end; // Equal to dirty_start when the page is clean
+    uint32_t flush_delay_ms;
+    TimerWheelTimer timer;
+    uint8_t page[STORAGE_CACHE_PAGE_BYTES];
+} CachedFile;
+
+static CachedFile files[STORAGE_CACHE_FILES];
+static StorageCacheStats_t stats;
+
+static CachedFile *find_file(int fd)
+{
+    for (size_t i = 0; i < STORAGE_CACHE_FILES; i++)
+    {
+        if (files[i].in_use && files[i].fd == fd)
+        {
+            return &files[i];
+        }
+    }
+    return NULL;
+}
+
+bool StorageCache_IsCached(int fd)
+{
+    return find_file(fd) != NULL;
+}
+
+static int flush(CachedFile *file)
+{
+    size_t length = file->dirty_end - file->dirty_start;
+
+    TimerWheel_Cancel(&file->timer);
+
+    if (length == 0)
+    {
+        return 0;
+    }
+
+    if (pwrite(file->fd, file->page + file->dirty_start, length, file->page_offset + (off_t)file->dirty_start) != (ssize_t)length)
+    {
+        return -1;
+    }
+
+    stats.flushes++;
+    stats.bytesFlushed += length;
+    file->dirty_start = file->dirty_end = 0;
+    return 0;
+}
+
+static void HandleFlushDue(TimerWheelTimer *timer, void *context)
+{
+    flush((CachedFile *)context);
+}
+
+/// <summary>
+/// Serve what the page holds. A miss on a sequential read refills the page from the
+/// current position; any other miss reads straight into the caller's buffer.
+/// </summary>
+ssize_t StorageCache_Read(int fd, void *buffer, size_t length)
+{
+    CachedFile *file = find_file(fd);
+    uint8_t *out = (uint8_t *)buffer;
+    size_t done = 0;
+    bool hit = true;
+
+    while (done < length)
+    {
+        off_t position = file->position;
+
+        if (position >= file->page_offset && position < file->page_offset + (off_t)file->valid)
+        {
+            size_t available = (size_t)(file->page_offset + (off_t)file->valid - position);
+            size_t count = length - done < available ? length - done : available;
+
+            memcpy(out + done, file->page + (position - file->page_offset), count);
+            done += count;
+            file->position += (off_t)count;
+            continue;
+        }
+
+        hit = false;
+
+        if (flush(file) == -1)
+        {
+            break;
+        }
+
+        ssize_t result;
+
+        if (position == file->last_read_end)
+        {
+            result = pread(fd, file->page, sizeof(file->page), position);
+            file->page_offset = position;
+            file->valid = result > 0 ? (size_t)result : 0;
+            stats.readAheads++;
+        }
+        else
+        {
+            result = pread(fd, out + done, length - done, position);
+            if (result > 0)
+            {
+                done += (size_t)result;
+                file->position += result;
+            }
+        }
+
+        if (result <= 0)
+        {
+            if (result == -1 && done == 0)
+            {
+                return -1;
+            }
+            break;
+        }
+    }
+
+    if (hit)
+    {
+        stats.readHits++;
+    }
+    else
+    {
+        stats.readMisses++;
+    }
+    file->last_read_end = file->position;
+    return (ssize_t)done;
+}
+
+/// <summary>
+/// Small writes that continue the data already in the page are gathered there and flushed
+/// as one. Writes of a page or more bypass the cache.
+/// </summary>
+ssize_t StorageCache_Write(int fd, const void *buffer, size_t length)
+{
+    CachedFile *file = find_file(fd);
+    off_t position = file->position;
+
+    if (length >= STORAGE_CACHE_PAGE_BYTES)
+    {
+        if (flush(file) == -1)
+        {
+            return -1;
+        }
+
+        ssize_t result = pwrite(fd, buffer, length, position);
+        if (result > 0)
+        {
+            file->valid = 0;
+            file->position += result;
+        }
+        return result;
+    }
+
+    bool fits = position >= file->page_offset && position <= file->page_offset + (off_t)file->valid &&
+                position + (off_t)length <= file->page_offset + STORAGE_CACHE_PAGE_BYTES;
+
+    if (!fits)
+    {
+        if (flush(file) == -1)
+        {
+            return -1;
+        }
+        file->page_offset = position;
+        file->valid = 0;
+    }
+
+    size_t offset = (size_t)(position - file->page_offset);
+    bool dirty = file->dirty_end > file->dirty_start;
+
+    memcpy(file->page + offset, buffer, length);
+
+    if (dirty)
+    {
+        stats.writesCoalesced++;
+        file->dirty_start = offset < file->dirty_start ? offset : file->dirty_start;
+        file->dirty_end = offset + length > file->dirty_end ? offset + length : file->dirty_end;
+    }
+    else
+    {
+        file->dirty_start = offset;
+        file->dirty_end = offset + length;
+    }
+
+    file->valid = offset + length > file->valid ? offset + length : file->valid;
+    file->position += (off_t)length;
+
+    if (!TimerWheel_IsActive(&file->timer) && TimerWheel_Default() != NULL)
+    {
+        TimerWheel_StartOneShot(TimerWheel_Default(), &file->timer, (uint64_t)file->flush_delay_ms * 1000);
+    }
+
+    return (ssize_t)length;
+}
+
+off_t StorageCache_Lseek(int fd, off_t offset, int whence)
+{
+    CachedFile *file = find_file(fd);
+    off_t position;
+
+    switch (whence)
+    {
+    case SEEK_SET:
+        position = offset;
+        break;
+    case SEEK_CUR:
+        position = file->position + offset;
+        break;
+    case SEEK_END:
+        // The file's size may depend on data still in the page.
+        if (flush(file) == -1 || (position = lseek(fd, offset, SEEK_END)) == -1)
+        {
+            return -1;
+        }
+        break;
+    default:
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (position < 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    file->position = position;
+    return position;
+}
+
+void StorageCache_Release(int fd)
+{
+    CachedFile *file = find_file(fd);
+
+    if (file != NULL)
+    {
+        flush(file);
+        lseek(fd, file->position, SEEK_SET);
+        file->in_use = false;
+    }
+}
+
+void StorageCache_ReleaseAll(void)
+{
+    for (size_t i = 0; i < STORAGE_CACHE_FILES; i++)
+    {
+        if (files[i].in_use)
+        {
+            StorageCache_Release(files[i].fd);
+        }
+    }
+}
+
+static int enable(int fd, uint32_t flush_delay_ms)
+{
+    CachedFile *file = find_file(fd);
+    struct stat status;
+
+    if (!ledger_contains(fd) || fstat(fd, &status) == -1 || !S_ISREG(status.st_mode))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (size_t i = 0; i < STORAGE_CACHE_FILES && file == NULL; i++)
+    {
+        if (!files[i].in_use)
+        {
+            file = &files[i];
+            memset(file, 0, sizeof(*file));
+            file->fd = fd;
+            file->position = file->last_read_end = lseek(fd, 0, SEEK_CUR);
+            TimerWheel_InitTimer(&file->timer, HandleFlushDue, file);
+            file->in_use = true;
+        }
+    }
+
+    if (file == NULL)
+    {
+        errno = ENOSPC;
+        return -1;
+    }
+
+    file->flush_delay_ms = flush_delay_ms != 0 ? flush_delay_ms : STORAGE_CACHE_DEFAULT_FLUSH_MS;
+    return 0;
+}
+
+DEFINE_CMD(RemoteX_StorageCache, data, nread)
+{
+    CachedFile *file = NULL;
+
+    data->header.returns = 0;
+
+    switch (data->op)
+    {
+    case StorageCache_Enable:
+        data->header.returns = enable(data->fd, data->flushDelayMs);
+        break;
+
+    case StorageCache_Disable:
+        StorageCache_Release(data->fd);
+        break;
+
+    case StorageCache_Sync:
+        if ((file = find_file(data->fd)) != NULL && flush(file) == -1)
+        {
+            data->header.returns = -1;
+        }
+        else
+        {
+            data->header.returns = fsync(data->fd);
+        }
+        break;
+
+    case StorageCache_Stats:
+        break;
+
+    default:
+        data->header.returns = -1;
+        errno = EINVAL;
+        break;
+    }
+
+    data->stats = stats;
+}
+END_CMD
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "peripherals.h"
+#include "timer_wheel.h"
+
+// One page per cached fd, shared by read-ahead and write coalescing.
+#define STORAGE_CACHE_FILES 2
+#define STORAGE_CACHE_PAGE_BYTES 4096
+#define STORAGE_CACHE_DEFAULT_FLUSH_MS 1000
+
+bool StorageCache_IsCached(int fd);
+
+/// <summary>
+/// read, write and lseek for a cached fd. The cache tracks the file position itself, so
+/// every access to a cached fd has to come through these.
+/// </summary>
+ssize_t StorageCache_Read(int fd, void *buffer, size_t length);
+ssize_t StorageCache_Write(int fd, const void *buffer, size_t length);
+off_t StorageCache_Lseek(int fd, off_t offset, int whence);
+
+/// <summary>
+/// Flush and stop caching fd before it is closed.
+/// </summary>
+void StorageCache_Release(int fd);
+
+/// <summary>
+/// Flush and release every cached fd. Called when the client disconnects, before the
+/// ledger closes the files.
+/// </summary>
+void StorageCache_ReleaseAll(void);
+
+DECLARE_CMD(RemoteX_StorageCache);
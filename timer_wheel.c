@@ -0,0 +1,516 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+#include <applibs/log.h>
+
+#include "timer_wheel.h"
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+#define LEVEL_SHIFT(level) ((level) * TIMER_WHEEL_SLOT_BITS)
+#define WHEEL_SPAN ((uint64_t)1 << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOT_BITS))
+#define NO_EVENT UINT64_MAX
+
+// Marks a timer that has been taken off its slot and is waiting to run in TimerWheel_Advance.
+#define LEVEL_EXPIRING 0xFF
+
+struct TimerWheel
+{
+    EventLoop *eventLoop;
+    EventRegistration *registration;
+    int fd;
+    uint64_t tick_ns;
+    // Last tick processed. Every running timer expires after this tick.
+    uint64_t now;
+    // Tick TimerWheel_Advance is catching up to. Periodic timers skip periods before it.
+    uint64_t target;
+    // Time of the last TimerWheel_Advance on a wheel without an event loop.
+    uint64_t manual_ns;
+    uint64_t armed;
+    size_t active;
+    bool advancing;
+    uint64_t occupied[TIMER_WHEEL_LEVELS];
+    TimerWheelTimer *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+};
+
+static TimerWheel *default_wheel;
+static TimerWheelObserver observer;
+
+static void TimerWheelCallback(EventLoop *el, int fd, EventLoop_IoEvents events, void *context);
+static void Rearm(TimerWheel *wheel);
+
+uint64_t TimerWheel_NowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+uint64_t TimerWheel_SpinUntil(uint64_t monotonicNs)
+{
+    uint64_t now;
+
+    while ((now = TimerWheel_NowNs()) < monotonicNs)
+    {
+    }
+
+    return now;
+}
+
+TimerWheel *TimerWheel_Create(EventLoop *eventLoop, uint32_t tickUs)
+{
+    TimerWheel *wheel = calloc(1, sizeof(TimerWheel));
+    if (wheel == NULL)
+    {
+        return NULL;
+    }
+
+    wheel->eventLoop = eventLoop;
+    wheel->fd = -1;
+    wheel->tick_ns = (uint64_t)(tickUs ? tickUs : TIMER_WHEEL_DEFAULT_TICK_US) * 1000;
+    wheel->armed = NO_EVENT;
+
+    if (eventLoop == NULL)
+    {
+        return wheel;
+    }
+
+    wheel->now = TimerWheel_NowNs() / wheel->tick_ns;
+
+    wheel->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (wheel->fd == -1)
+    {
+        Log_Debug("ERROR: Unable to create timer wheel: %s (%d).\n", strerror(errno), errno);
+        goto failed;
+    }
+
+    wheel->registration = EventLoop_RegisterIo(eventLoop, wheel->fd, EventLoop_Input, TimerWheelCallback, wheel);
+    if (wheel->registration == NULL)
+    {
+        Log_Debug("ERROR: Unable to register timer wheel: %s (%d).\n", strerror(errno), errno);
+        goto failed;
+    }
+
+    return wheel;
+
+failed:
+    TimerWheel_Dispose(wheel);
+    return NULL;
+}
+
+void TimerWheel_Dispose(TimerWheel *wheel)
+{
+    if (wheel == NULL)
+    {
+        return;
+    }
+
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++)
+        {
+            while (wheel->slots[level][slot] != NULL)
+            {
+                TimerWheel_Cancel(wheel->slots[level][slot]);
+            }
+        }
+    }
+
+    if (wheel->registration != NULL)
+    {
+        EventLoop_UnregisterIo(wheel->eventLoop, wheel->registration);
+    }
+
+    if (wheel->fd != -1)
+    {
+        close(wheel->fd);
+    }
+
+    if (default_wheel == wheel)
+    {
+        default_wheel = NULL;
+    }
+
+    free(wheel);
+}
+
+TimerWheel *TimerWheel_Default(void)
+{
+    return default_wheel;
+}
+
+void TimerWheel_SetDefault(TimerWheel *wheel)
+{
+    default_wheel = wheel;
+}
+
+void TimerWheel_InitTimer(TimerWheelTimer *timer, TimerWheelHandler handler, void *context)
+{
+    memset(timer, 0, sizeof(*timer));
+    timer->handler = handler;
+    timer->context = context;
+}
+
+static void Link(TimerWheelTimer **head, TimerWheelTimer *timer)
+{
+    timer->next = *head;
+    if (timer->next != NULL)
+    {
+        timer->next->pprev = &timer->next;
+    }
+    timer->pprev = head;
+    *head = timer;
+}
+
+static void Unlink(TimerWheelTimer *timer)
+{
+    *timer->pprev = timer->next;
+    if (timer->next != NULL)
+    {
+        timer->next->pprev = timer->pprev;
+    }
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+/// <summary>
+/// Place a timer on the level whose span covers its distance from the current tick.
+/// </summary>
+static void Place(TimerWheel *wheel, TimerWheelTimer *timer)
+{
+    uint64_t delta = timer->expires - wheel->now;
+    uint64_t position = timer->expires;
+    int level = 0;
+
+    if (delta >= WHEEL_SPAN)
+    {
+        position = wheel->now + WHEEL_SPAN - 1;
+        delta = WHEEL_SPAN - 1;
+    }
+
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= ((uint64_t)1 << LEVEL_SHIFT(level + 1)))
+    {
+        level++;
+    }
+
+    int slot = (int)((position >> LEVEL_SHIFT(level)) & SLOT_MASK);
+
+    timer->level = (uint8_t)level;
+    timer->slot = (uint8_t)slot;
+    Link(&wheel->slots[level][slot], timer);
+    wheel->occupied[level] |= (uint64_t)1 << slot;
+}
+
+/// <summary>
+/// Tick at which the wheel next has work: the earliest occupied level 0 slot, or the
+/// earliest boundary at which an occupied outer slot cascades inwards.
+/// </summary>
+static uint64_t NextEventTick(const TimerWheel *wheel)
+{
+    uint64_t next = NO_EVENT;
+
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        uint64_t occupied = wheel->occupied[level];
+        if (occupied == 0)
+        {
+            continue;
+        }
+
+        uint64_t block = (wheel->now >> LEVEL_SHIFT(level)) + 1;
+        unsigned start = (unsigned)(block & SLOT_MASK);
+        uint64_t rotated = start == 0 ? occupied : (occupied >> start) | (occupied << (TIMER_WHEEL_SLOTS - start));
+        uint64_t tick = (block + (uint64_t)__builtin_ctzll(rotated)) << LEVEL_SHIFT(level);
+
+        if (tick < next)
+        {
+            next = tick;
+        }
+    }
+
+    return next;
+}
+
+static int Start(TimerWheel *wheel, TimerWheelTimer *timer, uint64_t expires, uint64_t period)
+{
+    if (wheel == NULL || timer->handler == NULL)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    TimerWheel_Cancel(timer);
+
+    // An idle wheel is not being advanced, so bring it up to date before placing the timer.
+    if (wheel->active == 0 && !wheel->advancing && wheel->eventLoop != NULL)
+    {
+        wheel->now = TimerWheel_NowNs() / wheel->tick_ns;
+    }
+
+    timer->wheel = wheel;
+    timer->expires = expires > wheel->now ? expires : wheel->now + 1;
+    timer->period = period;
+    timer->overruns = 0;
+    wheel->active++;
+    Place(wheel, timer);
+
+    // Only touch the timerfd if this timer is now the earliest work.
+    if (!wheel->advancing && NextEventTick(wheel) < wheel->armed)
+    {
+        Rearm(wheel);
+    }
+
+    return 0;
+}
+
+static uint64_t CurrentNs(const TimerWheel *wheel)
+{
+    return wheel->eventLoop != NULL ? TimerWheel_NowNs() : wheel->manual_ns;
+}
+
+static uint64_t NsToTicksRoundedUp(const TimerWheel *wheel, uint64_t ns)
+{
+    return (ns + wheel->tick_ns - 1) / wheel->tick_ns;
+}
+
+int TimerWheel_StartOneShot(TimerWheel *wheel, TimerWheelTimer *timer, uint64_t delayUs)
+{
+    if (wheel == NULL)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    return Start(wheel, timer, NsToTicksRoundedUp(wheel, CurrentNs(wheel) + delayUs * 1000), 0);
+}
+
+int TimerWheel_StartPeriodic(TimerWheel *wheel, TimerWheelTimer *timer, uint64_t periodUs)
+{
+    if (wheel == NULL)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    uint64_t period = NsToTicksRoundedUp(wheel, periodUs * 1000);
+    period = period ? period : 1;
+    return Start(wheel, timer, NsToTicksRoundedUp(wheel, CurrentNs(wheel) + periodUs * 1000), period);
+}
+
+int TimerWheel_StartAt(TimerWheel *wheel, TimerWheelTimer *timer, uint64_t monotonicNs)
+{
+    if (wheel == NULL)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    return Start(wheel, timer, NsToTicksRoundedUp(wheel, monotonicNs), 0);
+}
+
+void TimerWheel_Cancel(TimerWheelTimer *timer)
+{
+    TimerWheel *wheel = timer->wheel;
+
+    if (wheel == NULL)
+    {
+        return;
+    }
+
+    TimerWheelTimer **head = timer->level == LEVEL_EXPIRING ? NULL : &wheel->slots[timer->level][timer->slot];
+
+    Unlink(timer);
+    if (head != NULL && *head == NULL)
+    {
+        wheel->occupied[timer->level] &= ~((uint64_t)1 << timer->slot);
+    }
+
+    timer->wheel = NULL;
+    wheel->active--;
+}
+
+bool TimerWheel_IsActive(const TimerWheelTimer *timer)
+{
+    return timer->wheel != NULL;
+}
+
+uint64_t TimerWheel_DueNs(const TimerWheelTimer *timer)
+{
+    return timer->due_ns;
+}
+
+uint32_t TimerWheel_TickUs(const TimerWheel *wheel)
+{
+    return (uint32_t)(wheel->tick_ns / 1000);
+}
+
+/// <summary>
+/// Move every timer in an outer slot to the level that now covers it.
+/// </summary>
+static void Cascade(TimerWheel *wheel, int level, int slot)
+{
+    TimerWheelTimer *timer = wheel->slots[level][slot];
+
+    wheel->slots[level][slot] = NULL;
+    wheel->occupied[level] &= ~((uint64_t)1 << slot);
+
+    while (timer != NULL)
+    {
+        TimerWheelTimer *next = timer->next;
+        timer->next = NULL;
+        timer->pprev = NULL;
+        Place(wheel, timer);
+        timer = next;
+    }
+}
+
+static void Expire(TimerWheel *wheel, uint64_t tick)
+{
+    int slot = (int)(tick & SLOT_MASK);
+    TimerWheelTimer *expiring = wheel->slots[0][slot];
+
+    if (expiring == NULL)
+    {
+        return;
+    }
+
+    // Detach the slot so handlers can cancel or restart any timer, including ones still
+    // waiting in this list.
+    wheel->slots[0][slot] = NULL;
+    wheel->occupied[0] &= ~((uint64_t)1 << slot);
+    expiring->pprev = &expiring;
+    for (TimerWheelTimer *timer = expiring; timer != NULL; timer = timer->next)
+    {
+        timer->level = LEVEL_EXPIRING;
+    }
+
+    while (expiring != NULL)
+    {
+        TimerWheelTimer *timer = expiring;
+        Unlink(timer);
+
+        timer->due_ns = timer->expires * wheel->tick_ns;
+
+        if (timer->period != 0)
+        {
+            timer->expires += timer->period;
+            if (timer->expires <= wheel->target)
+            {
+                uint64_t missed = (wheel->target - timer->expires) / timer->period + 1;
+                timer->overruns += (uint32_t)missed;
+                timer->expires += missed * timer->period;
+            }
+            Place(wheel, timer);
+        }
+        else
+        {
+            timer->wheel = NULL;
+            wheel->active--;
+        }
+
+        // Manually advanced wheels run on simulated time, so only event loop wheels are observed.
+        if (observer == NULL || wheel->fd == -1)
+        {
+            timer->handler(timer, timer->context);
+            continue;
+        }
+
+        uint64_t start_ns = TimerWheel_NowNs();
+        uint64_t late_ns = start_ns > timer->due_ns ? start_ns - timer->due_ns : 0;
+        TimerWheelObserver notify = observer;
+
+        timer->handler(timer, timer->context);
+        notify(late_ns, TimerWheel_NowNs() - start_ns);
+    }
+}
+
+void TimerWheel_SetObserver(TimerWheelObserver timerObserver)
+{
+    observer = timerObserver;
+}
+
+void TimerWheel_Advance(TimerWheel *wheel, uint64_t monotonicNs)
+{
+    uint64_t target = monotonicNs / wheel->tick_ns;
+
+    wheel->manual_ns = monotonicNs;
+    wheel->target = target;
+    wheel->advancing = true;
+
+    while (wheel->now < target)
+    {
+        uint64_t tick = NextEventTick(wheel);
+        if (tick > target)
+        {
+            wheel->now = target;
+            break;
+        }
+
+        wheel->now = tick;
+
+        for (int level = TIMER_WHEEL_LEVELS - 1; level > 0; level--)
+        {
+            if ((tick & (((uint64_t)1 << LEVEL_SHIFT(level)) - 1)) == 0)
+            {
+                Cascade(wheel, level, (int)((tick >> LEVEL_SHIFT(level)) & SLOT_MASK));
+            }
+        }
+
+        Expire(wheel, tick);
+    }
+
+    wheel->advancing = false;
+    Rearm(wheel);
+}
+
+/// <summary>
+/// Point the timerfd at the next tick with work, using an absolute expiry so the wheel
+/// does not drift. Cancelled timers are not disarmed; a spurious wakeup just advances.
+/// </summary>
+static void Rearm(TimerWheel *wheel)
+{
+    if (wheel->fd == -1)
+    {
+        return;
+    }
+
+    uint64_t next = wheel->active ? NextEventTick(wheel) : NO_EVENT;
+    if (next == wheel->armed)
+    {
+        return;
+    }
+
+    struct itimerspec value;
+    memset(&value, 0, sizeof(value));
+
+    if (next != NO_EVENT)
+    {
+        uint64_t ns = next * wheel->tick_ns;
+        value.it_value.tv_sec = (time_t)(ns / 1000000000ull);
+        value.it_value.tv_nsec = (long)(ns % 1000000000ull);
+    }
+
+    if (timerfd_settime(wheel->fd, TFD_TIMER_ABSTIME, &value, NULL) == -1)
+    {
+        Log_Debug("ERROR: Could not arm timer wheel: %s (%d).\n", strerror(errno), errno);
+        return;
+    }
+
+    wheel->armed = next;
+}
+
+// This satisfies the EventLoopIoCallback signature.
+static void TimerWheelCallback(EventLoop *el, int fd, EventLoop_IoEvents events, void *context)
+{
+    TimerWheel *wheel = context;
+    uint64_t expirations;
+
+    if (read(wheel->fd, &expirations, sizeof(expirations)) == -1 && errno != EAGAIN)
+    {
+        Log_Debug("ERROR: Could not read timer wheel: %s (%d).\n", strerror(errno), errno);
+    }
+
+    wheel->armed = NO_EVENT;
+    TimerWheel_Advance(wheel, TimerWheel_NowNs());
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <applibs/eventloop.h>
+
+// Default tick. Timers expire on tick boundaries, so a timer fires between 0 and one tick
+// after its due time plus event loop latency.
+#define TIMER_WHEEL_DEFAULT_TICK_US 100
+
+// Four levels of 64 slots cover 2^24 ticks (about 28 minutes at the default tick). Longer
+// timers are parked in the outermost level and re-inserted as it cascades.
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_SLOT_BITS)
+
+typedef struct TimerWheel TimerWheel;
+typedef struct TimerWheelTimer TimerWheelTimer;
+
+/// <summary>
+/// Invoked on the event loop when a timer expires. The handler may start or cancel
+/// any timer, including the one that fired.
+/// </summary>
+typedef void (*TimerWheelHandler)(TimerWheelTimer *timer, void *context);
+
+/// <summary>
+/// A timer owned by the caller, typically embedded in the state it serves, so starting
+/// and cancelling never allocate. Initialise with <see cref="TimerWheel_InitTimer" />.
+/// Members are private to the wheel.
+/// </summary>
+struct TimerWheelTimer
+{
+    TimerWheelTimer *next;
+    TimerWheelTimer **pprev;
+    TimerWheel *wheel;
+    uint64_t expires;
+    uint64_t period;
+    uint64_t due_ns;
+    uint32_t overruns;
+    uint8_t level;
+    uint8_t slot;
+    TimerWheelHandler handler;
+    void *context;
+};
+
+/// <summary>
+///     <para>Create a timer wheel driven by a single timerfd registered on the event loop.</para>
+///     <param name="eventLoop">Event loop on which handlers run. Pass NULL to drive the wheel
+///     manually with <see cref="TimerWheel_Advance" />, as the host benchmark does.</param>
+///     <param name="tickUs">Tick resolution in microseconds, 0 for the default.</param>
+///     <returns>The wheel, or NULL on failure with errno set.</returns>
+/// </summary>
+TimerWheel *TimerWheel_Create(EventLoop *eventLoop, uint32_t tickUs);
+
+/// <summary>
+/// Cancel every timer and release the wheel. It is safe to call this with NULL.
+/// </summary>
+void TimerWheel_Dispose(TimerWheel *wheel);
+
+/// <summary>
+/// The wheel shared by server features, set up by <see cref="TimerWheel_SetDefault" />.
+/// </summary>
+TimerWheel *TimerWheel_Default(void);
+void TimerWheel_SetDefault(TimerWheel *wheel);
+
+void TimerWheel_InitTimer(TimerWheelTimer *timer, TimerWheelHandler handler, void *context);
+
+/// <summary>
+/// Start, or restart, a timer that fires once after delayUs. O(1).
+/// Returns 0 on success, -1 with errno set on failure.
+/// </summary>
+int TimerWheel_StartOneShot(TimerWheel *wheel, TimerWheelTimer *timer, uint64_t delayUs);
+
+/// <summary>
+/// Start, or restart, a timer that first fires after periodUs and then every periodUs.
+/// Missed periods are counted in the timer's overruns rather than fired back to back. O(1).
+/// </summary>
+int TimerWheel_StartPeriodic(TimerWheel *wheel, TimerWheelTimer *timer, uint64_t periodUs);
+
+/// <summary>
+/// Start, or restart, a one shot timer that fires at an absolute CLOCK_MONOTONIC time.
+/// A time in the past fires on the next tick. O(1).
+/// </summary>
+int TimerWheel_StartAt(TimerWheel *wheel, TimerWheelTimer *timer, uint64_t monotonicNs);
+
+/// <summary>
+/// Stop a timer. Safe to call on a timer that is not running. O(1).
+/// </summary>
+void TimerWheel_Cancel(TimerWheelTimer *timer);
+
+bool TimerWheel_IsActive(const TimerWheelTimer *timer);
+
+/// <summary>
+/// CLOCK_MONOTONIC time at which the timer being handled was due. Valid inside the handler.
+/// </summary>
+uint64_t TimerWheel_DueNs(const TimerWheelTimer *timer);
+
+uint32_t TimerWheel_TickUs(const TimerWheel *wheel);
+
+/// <summary>
+/// Run every timer due at or before monotonicNs. Called from the timerfd callback; only
+/// call it directly on a wheel created without an event loop.
+/// </summary>
+void TimerWheel_Advance(TimerWheel *wheel, uint64_t monotonicNs);
+
+/// <summary>
+/// Called after each handler run from an event loop driven wheel with how long after its due
+/// time the handler started, including tick rounding, and how long it took.
+/// </summary>
+typedef void (*TimerWheelObserver)(uint64_t lateNs, uint64_t runNs);
+
+/// <summary>
+/// Set the observer shared by all wheels, or NULL to stop observing.
+/// </summary>
+void TimerWheel_SetObserver(TimerWheelObserver observer);
+
+/// <summary>
+/// Current CLOCK_MONOTONIC time in nanoseconds.
+/// </summary>
+uint64_t TimerWheel_NowNs(void);
+
+/// <summary>
+/// Busy wait until monotonicNs and return the time observed. Used to cover the last
+/// fraction of a tick when an action has to happen at an exact time.
+/// </summary>
+uint64_t TimerWheel_SpinUntil(uint64_t monotonicNs);